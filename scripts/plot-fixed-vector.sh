@@ -1,10 +1,40 @@
 #!/bin/bash
 
-# Try to show a nice plot comparing a naively locked implementation
-# with a mostly lock-free one.
+# Try to show a nice plot comparing the throughput of a naively locked
+# implementation with a mostly lock-free one, with and without an
+# elimination array.  Needs `make bench`.
+#
+# Set TEST_TYPES to compare other --test-types, and BENCHMARKS to pick
+# the benchmarks (push-only, push-pop, batched-push-pop and
+# push-pop-get) plotted for each of them.  E.g. to compare CAS and
+# fetch-and-add pushes:
+#
+#   TEST_TYPES="real real-fetch-add" BENCHMARKS="push-only" \
+#     MAX_THREADS=128 scripts/plot-fixed-vector.sh
+#
+# or to see how a sharded stack scales against a single vector:
+#
+#   TEST_TYPES="real sharded" BENCHMARKS="push-pop push-pop-get" \
+#     scripts/plot-fixed-vector.sh
+#
+# or to compare the slot layouts (see src/slot-layout.hpp):
+#
+#   TEST_TYPES="real real-padded real-scattered" scripts/plot-fixed-vector.sh
+#
+# PINNING picks how threads are placed on CPUs (none, compact, scatter
+# or physical-core); the placement ends up in the last CSV column.
+# EXTRA_ARGS is passed on to bench-fixed-vector (e.g. "--repetitions
+# 10").  The numbers plotted are also left in $OUTPUT_CSV.
 
-REAL_VECT_FILE=`mktemp`
-FAKE_VECT_FILE=`mktemp`
+ALL_BENCHMARKS="push-only push-pop batched-push-pop push-pop-get"
+
+if [ -z "$TEST_TYPES" ]; then
+    TEST_TYPES="fake real elimination"
+fi
+
+if [ -z "$BENCHMARKS" ]; then
+    BENCHMARKS="push-pop"
+fi
 
 if [ -z $MIN_THREADS ]; then
     MIN_THREADS="1"
@@ -14,33 +44,69 @@ if [ -z $MAX_THREADS ]; then
     MAX_THREADS="50"
 fi
 
+if [ -z $PINNING ]; then
+    PINNING="none"
+fi
+
 if [ -z $OUTPUT_PNG ]; then
     OUTPUT_PNG="graphs/`date +'%H-%M-%S-%F'`.png"
 fi
 
-for i in `seq $MIN_THREADS $MAX_THREADS`; do
-    echo -n "$i  " >> "$REAL_VECT_FILE"
-    echo -n "$i  " >> "$FAKE_VECT_FILE"
-    echo "Stressing with with $i threads ..."
-    ./build/test-fixed-vector --quiet $EXTRA_ARGS \
-	--thread-count-lower "$i" --thread-count-upper "$i" --test-type real \
-	>> "$REAL_VECT_FILE"
-    ./build/test-fixed-vector --quiet $EXTRA_ARGS \
-	--thread-count-lower "$i" --thread-count-upper "$i" --test-type fake \
-	>> "$FAKE_VECT_FILE"
+if [ -z $OUTPUT_CSV ]; then
+    OUTPUT_CSV="${OUTPUT_PNG%.png}.csv"
+fi
+
+mkdir -p graphs
+
+BENCH_ARGS=""
+for benchmark in $ALL_BENCHMARKS; do
+    case " $BENCHMARKS " in
+	*" $benchmark "*) ;;
+	*) BENCH_ARGS="$BENCH_ARGS --no-$benchmark" ;;
+    esac
+done
+
+rm -f "$OUTPUT_CSV"
+for type in $TEST_TYPES; do
+    echo "Benchmarking $type with $MIN_THREADS to $MAX_THREADS threads ..."
+    RESULTS=`mktemp`
+    ./build/bench-fixed-vector --format csv $BENCH_ARGS $EXTRA_ARGS \
+	--thread-count-lower "$MIN_THREADS" \
+	--thread-count-upper "$MAX_THREADS" \
+	--pinning "$PINNING" \
+	--test-type $type > "$RESULTS" || exit 1
+    # Keep a single header line.
+    if [ -e "$OUTPUT_CSV" ]; then
+	tail -n +2 "$RESULTS" >> "$OUTPUT_CSV"
+    else
+	cat "$RESULTS" > "$OUTPUT_CSV"
+    fi
+    rm -f "$RESULTS"
 done
 
 GNUPLOT_CMD_FILE=`mktemp`
-mkdir -p graphs
 
 echo "set terminal png size 1400,400" >> $GNUPLOT_CMD_FILE
 echo "set output '$OUTPUT_PNG'" >> $GNUPLOT_CMD_FILE
 echo "set xlabel 'Threads'" >> $GNUPLOT_CMD_FILE
 echo "set xtics 1" >> $GNUPLOT_CMD_FILE
-echo "set ylabel 'Time (milliseconds)'" >> $GNUPLOT_CMD_FILE
+echo "set ylabel 'Operations per second'" >> $GNUPLOT_CMD_FILE
+echo "set key outside" >> $GNUPLOT_CMD_FILE
 
-echo "plot '$FAKE_VECT_FILE' with line title \"Naive\", \
-           '$REAL_VECT_FILE' with line title \"Real\"" >> $GNUPLOT_CMD_FILE
+# One line per test type and benchmark: threads, mean and standard
+# deviation, with the deviation as error bars.
+PLOT_CMD="plot"
+for type in $TEST_TYPES; do
+    for benchmark in $BENCHMARKS; do
+	DATA_FILE=`mktemp`
+	awk -F, -v type=$type -v benchmark=$benchmark \
+	    '$1 == type && $2 == benchmark { print $3, $5, $6 }' \
+	    "$OUTPUT_CSV" > "$DATA_FILE"
+	PLOT_CMD="$PLOT_CMD '$DATA_FILE' with yerrorlines"
+	PLOT_CMD="$PLOT_CMD title \"$type $benchmark\","
+    done
+done
+echo "${PLOT_CMD%,}" >> $GNUPLOT_CMD_FILE
 
 gnuplot "$GNUPLOT_CMD_FILE"
-echo "Wrote to $OUTPUT_PNG"
+echo "Wrote to $OUTPUT_PNG and $OUTPUT_CSV"
@@ -4,15 +4,30 @@
 
 namespace eelish {
 
+// The __sync builtins are all full barriers, so the read-modify-write
+// operations below ignore the order they are asked for.  Loads and
+// stores do honor it.
+
+inline int gcc_memory_order(MemoryOrder order) {
+  switch (order) {
+    case kRelaxed: return __ATOMIC_RELAXED;
+    case kAcquire: return __ATOMIC_ACQUIRE;
+    case kRelease: return __ATOMIC_RELEASE;
+    case kAcqRel: return __ATOMIC_ACQ_REL;
+    case kSeqCst: return __ATOMIC_SEQ_CST;
+  }
+  return __ATOMIC_SEQ_CST;
+}
+
 template<typename T>
-bool Atomic<T>::boolean_cas(T old_value, T new_value) {
+bool Atomic<T>::boolean_cas(T old_value, T new_value, MemoryOrder) {
   Word old_word = reinterpret_cast<Word>(old_value);
   Word new_word = reinterpret_cast<Word>(new_value);
   return __sync_bool_compare_and_swap(&value_, old_word, new_word);
 }
 
 template<typename T>
-T Atomic<T>::value_cas(T old_value, T new_value) {
+T Atomic<T>::value_cas(T old_value, T new_value, MemoryOrder) {
   Word old_word = reinterpret_cast<Word>(old_value);
   Word new_word = reinterpret_cast<Word>(new_value);
   Word result = __sync_val_compare_and_swap(&value_, old_word, new_word);
@@ -20,25 +35,30 @@ T Atomic<T>::value_cas(T old_value, T new_value) {
 }
 
 template<typename T>
-T Atomic<T>::acquire_load() const {
-  return reinterpret_cast<T>(__atomic_load_n(&value_, __ATOMIC_ACQUIRE));
+T Atomic<T>::fetch_add(Word delta, MemoryOrder) {
+  return reinterpret_cast<T>(__sync_fetch_and_add(&value_, delta));
+}
+
+template<typename T>
+T Atomic<T>::load(MemoryOrder order) const {
+  return reinterpret_cast<T>(__atomic_load_n(&value_,
+                                             gcc_memory_order(order)));
 }
 
 template<typename T>
-void Atomic<T>::release_store(T value) {
+void Atomic<T>::store(T value, MemoryOrder order) {
   Word word_value = reinterpret_cast<Word>(value);
-  __atomic_store(&value_, &word_value, __ATOMIC_RELEASE);
+  __atomic_store(&value_, &word_value, gcc_memory_order(order));
 }
 
 template<typename T>
-T Atomic<T>::nobarrier_load() const {
-  return reinterpret_cast<T>(__atomic_load_n(&value_, __ATOMIC_RELAXED));
+T Atomic<T>::raw_load() const {
+  return reinterpret_cast<T>(value_);
 }
 
 template<typename T>
-void Atomic<T>::nobarrier_store(T value) {
-  Word word_value = reinterpret_cast<Word>(value);
-  __atomic_store(&value_, &word_value, __ATOMIC_RELAXED);
+void Atomic<T>::raw_store(T value) {
+  value_ = reinterpret_cast<Word>(value);
 }
 
 template<typename T>
@@ -50,6 +70,10 @@ void memory_fence() {
   __atomic_thread_fence(__ATOMIC_ACQ_REL);
 }
 
+void full_memory_fence() {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
 template<typename T>
 bool cas_success(volatile T **location, T *old_value, T *new_value) {
   return __sync_bool_compare_and_swap(location, old_value, new_value);
@@ -61,9 +85,3 @@ T *cas_previous_value(volatile T **location, T *old_value, T *new_value) {
 }
 
 }
-
-#if defined(__i386__) || defined(__x86_64__)
-#include "atomics-gcc-x86-inl.hpp"
-#else
-#error "eelish only understands x86 CPUs!"
-#endif
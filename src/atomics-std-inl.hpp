@@ -0,0 +1,93 @@
+#ifndef __EELISH_ATOMICS__HPP
+#error "atomics-std-inl.hpp can only be included from within atomics.hpp"
+#endif
+
+namespace eelish {
+
+inline std::memory_order std_memory_order(MemoryOrder order) {
+  switch (order) {
+    case kRelaxed: return std::memory_order_relaxed;
+    case kAcquire: return std::memory_order_acquire;
+    case kRelease: return std::memory_order_release;
+    case kAcqRel: return std::memory_order_acq_rel;
+    case kSeqCst: return std::memory_order_seq_cst;
+  }
+  return std::memory_order_seq_cst;
+}
+
+/// The order a failed CAS gets: a failed CAS stores nothing, so it
+/// can't have release semantics.
+inline std::memory_order std_failure_order(MemoryOrder order) {
+  switch (order) {
+    case kRelaxed:
+    case kRelease:
+      return std::memory_order_relaxed;
+    case kAcquire:
+    case kAcqRel:
+      return std::memory_order_acquire;
+    case kSeqCst:
+      return std::memory_order_seq_cst;
+  }
+  return std::memory_order_seq_cst;
+}
+
+template<typename T>
+bool Atomic<T>::boolean_cas(T old_value, T new_value, MemoryOrder order) {
+  Word old_word = reinterpret_cast<Word>(old_value);
+  return value_.compare_exchange_strong(old_word,
+                                        reinterpret_cast<Word>(new_value),
+                                        std_memory_order(order),
+                                        std_failure_order(order));
+}
+
+template<typename T>
+T Atomic<T>::value_cas(T old_value, T new_value, MemoryOrder order) {
+  // compare_exchange_strong leaves the current value in `old_word`
+  // whether it succeeds or not.
+  Word old_word = reinterpret_cast<Word>(old_value);
+  value_.compare_exchange_strong(old_word, reinterpret_cast<Word>(new_value),
+                                 std_memory_order(order),
+                                 std_failure_order(order));
+  return reinterpret_cast<T>(old_word);
+}
+
+template<typename T>
+T Atomic<T>::fetch_add(Word delta, MemoryOrder order) {
+  return reinterpret_cast<T>(value_.fetch_add(delta,
+                                              std_memory_order(order)));
+}
+
+template<typename T>
+T Atomic<T>::load(MemoryOrder order) const {
+  return reinterpret_cast<T>(value_.load(std_memory_order(order)));
+}
+
+template<typename T>
+void Atomic<T>::store(T value, MemoryOrder order) {
+  value_.store(reinterpret_cast<Word>(value), std_memory_order(order));
+}
+
+template<typename T>
+T Atomic<T>::raw_load() const {
+  return reinterpret_cast<T>(value_.load(std::memory_order_relaxed));
+}
+
+template<typename T>
+void Atomic<T>::raw_store(T value) {
+  value_.store(reinterpret_cast<Word>(value), std::memory_order_relaxed);
+}
+
+template<typename T>
+void Atomic<T>::flush() {
+  flush_cache(&value_, &value_ + 1);
+}
+
+void memory_fence() {
+  std::atomic_thread_fence(std::memory_order_acq_rel);
+}
+
+void full_memory_fence() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+}
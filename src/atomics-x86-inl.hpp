@@ -0,0 +1,67 @@
+#ifndef __EELISH_ATOMICS__HPP
+#error "atomics-x86-inl.hpp can only be included from within atomics.hpp"
+#endif
+
+namespace eelish {
+
+template<typename T>
+inline void flush_cache(volatile T *begin, volatile T *end) { }
+
+void cpu_relax() {
+  __asm__ __volatile__("pause" ::: "memory");
+}
+
+#if defined(__x86_64__)
+
+DoubleWord Atomic<DoubleWord>::value_cas(DoubleWord old_value,
+                                         DoubleWord new_value) {
+  // gcc only emits cmpxchg16b for __sync builtins with -mcx16, and
+  // every x86-64 CPU we care about has it; so we spell it out.
+  __asm__ __volatile__("lock cmpxchg16b %0"
+                       : "+m"(value_),
+                         "+a"(old_value.low), "+d"(old_value.high)
+                       : "b"(new_value.low), "c"(new_value.high)
+                       : "cc", "memory");
+  // cmpxchg16b leaves the current value in rdx:rax either way.
+  return old_value;
+}
+
+#else
+
+DoubleWord Atomic<DoubleWord>::value_cas(DoubleWord old_value,
+                                         DoubleWord new_value) {
+  typedef unsigned long long Wide;
+  Wide old_wide = static_cast<Wide>(old_value.low) |
+      (static_cast<Wide>(old_value.high) << 32);
+  Wide new_wide = static_cast<Wide>(new_value.low) |
+      (static_cast<Wide>(new_value.high) << 32);
+  Wide result = __sync_val_compare_and_swap(
+      reinterpret_cast<volatile Wide *>(&value_), old_wide, new_wide);
+  DoubleWord current = { static_cast<Word>(result),
+                         static_cast<Word>(result >> 32) };
+  return current;
+}
+
+#endif
+
+bool Atomic<DoubleWord>::boolean_cas(DoubleWord old_value,
+                                     DoubleWord new_value) {
+  return value_cas(old_value, new_value) == old_value;
+}
+
+DoubleWord Atomic<DoubleWord>::load() {
+  // A CAS that swaps a value for itself, whether or not it matches
+  // our guess, returns the current value atomically.
+  DoubleWord guess = { 0, 0 };
+  return value_cas(guess, guess);
+}
+
+Word Atomic<DoubleWord>::acquire_load_low() const {
+  return __atomic_load_n(&value_.low, __ATOMIC_ACQUIRE);
+}
+
+Word Atomic<DoubleWord>::acquire_load_high() const {
+  return __atomic_load_n(&value_.high, __ATOMIC_ACQUIRE);
+}
+
+}
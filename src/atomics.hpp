@@ -3,23 +3,52 @@
 
 #include <stdint.h>
 
+// There are two implementations of Atomic: one on gcc's __sync and
+// __atomic builtins (the default) and one on std::atomic, picked by
+// defining EELISH_STD_ATOMICS (`make ATOMICS=std`).
+#ifdef EELISH_STD_ATOMICS
+#include <atomic>
+#endif
+
 namespace eelish {
 
 typedef uintptr_t Word;
 
+/// The orderings an atomic operation can ask for.  They mean what the
+/// std::memory_order values of the same name do.  A backend is free
+/// to give an operation a stronger ordering than it asks for.
+enum MemoryOrder {
+  kRelaxed,
+  kAcquire,
+  kRelease,
+  kAcqRel,
+  kSeqCst
+};
+
 /// Provides atomic access to a word.
 template<typename T>
 class Atomic {
  public:
-  inline bool boolean_cas(T old_value, T new_value);
-  inline T value_cas(T old_value, T new_value);
+  /// A CAS orders memory as `order` says if it succeeds.  If it fails
+  /// it only has the acquire half (if any) of `order`.
+  inline bool boolean_cas(T old_value, T new_value,
+                          MemoryOrder order = kSeqCst);
+  inline T value_cas(T old_value, T new_value, MemoryOrder order = kSeqCst);
+
+  /// Atomically adds `delta` to the word and returns its old value.
+  inline T fetch_add(Word delta, MemoryOrder order = kSeqCst);
 
-  inline T acquire_load() const;
-  inline void release_store(T value);
+  inline T load(MemoryOrder order) const;
+  inline void store(T value, MemoryOrder order);
 
-  inline T nobarrier_load() const;
-  inline void nobarrier_store(T value);
+  inline T acquire_load() const { return load(kAcquire); }
+  inline void release_store(T value) { store(value, kRelease); }
 
+  inline T nobarrier_load() const { return load(kRelaxed); }
+  inline void nobarrier_store(T value) { store(value, kRelaxed); }
+
+  /// Plain, non-atomic accesses, for when no other thread can be
+  /// looking (e.g. while constructing the container).
   inline T raw_load() const;
   inline void raw_store(T value);
 
@@ -38,7 +67,11 @@ class Atomic {
   /// the word is already primed and cas_unprime will fail if the word
   /// isn't primed.  cas_prime also returns the unprimed value of the
   /// word via `out_previous_value`.
-  inline bool cas_prime(T *out_previous_value);
+  inline bool cas_prime(T *out_previous_value, MemoryOrder order = kSeqCst);
+
+  inline static bool is_primed(T value) {
+    return (reinterpret_cast<Word>(value) & kPrimeBit) != 0;
+  }
 
   /// Convenience functions which return an unprimed value of type T.
   /// Helps avoid ugly casts in some cases.
@@ -55,44 +88,99 @@ class Atomic {
 #undef LOAD_UNPRIMED_FUNCTION
 
  private:
+#ifdef EELISH_STD_ATOMICS
+  std::atomic<Word> value_;
+#else
   volatile Word value_;
+#endif
   static const Word kPrimeBit = static_cast<Word>(1);
 };
 
 
+/// Two adjacent words, updated together with Atomic<DoubleWord>.
+struct DoubleWord {
+  Word low;
+  Word high;
+
+  inline bool operator==(const DoubleWord &other) const {
+    return low == other.low && high == other.high;
+  }
+
+  inline bool operator!=(const DoubleWord &other) const {
+    return !(*this == other);
+  }
+} __attribute__((aligned(16)));
+
+/// Atomic access to a pair of words, for when a CAS has to cover a
+/// value and a tag at once.  Both CASes and loads are double-width
+/// compare exchanges (cmpxchg16b on x86-64), so a load is as
+/// expensive as a CAS and writes the cache line; code that can live
+/// with reading each half atomically on its own should use
+/// acquire_load_low and acquire_load_high.
+template<>
+class Atomic<DoubleWord> {
+ public:
+  inline bool boolean_cas(DoubleWord old_value, DoubleWord new_value);
+  inline DoubleWord value_cas(DoubleWord old_value, DoubleWord new_value);
+
+  inline DoubleWord load();
+
+  inline Word acquire_load_low() const;
+  inline Word acquire_load_high() const;
+
+  inline DoubleWord raw_load() const {
+    DoubleWord value = { value_.low, value_.high };
+    return value;
+  }
+
+  inline void raw_store(DoubleWord value) {
+    value_.low = value.low;
+    value_.high = value.high;
+  }
+
+ private:
+  volatile DoubleWord value_;
+};
+
+
 inline void memory_fence();
 
-template<typename T>
-inline void flush_cache(volatile T *begin, volatile T *end);
+/// A full (sequentially consistent) fence.  Unlike memory_fence this
+/// also orders earlier stores with later loads.
+inline void full_memory_fence();
 
+/// Hints to the CPU that we're in a spin-wait loop.
+inline void cpu_relax();
 
 template<typename T>
-T Atomic<T>::raw_load() const {
-  return reinterpret_cast<T>(value_);
-}
+inline void flush_cache(volatile T *begin, volatile T *end);
 
-template<typename T>
-void Atomic<T>::raw_store(T value) {
-  value_ = reinterpret_cast<Word>(value);
-}
 
 template<typename T>
-bool Atomic<T>::cas_prime(T *out_value) {
+bool Atomic<T>::cas_prime(T *out_value, MemoryOrder order) {
   Word old_value = reinterpret_cast<Word>(nobarrier_load());
   if (old_value & kPrimeBit) return false;
 
   Word new_value = old_value | kPrimeBit;
   *out_value = value_cas(reinterpret_cast<T>(old_value),
-                         reinterpret_cast<T>(new_value));
+                         reinterpret_cast<T>(new_value), order);
   return *out_value == reinterpret_cast<T>(old_value);
 }
 
 }
 
-#ifdef __GNUC__
+#if defined(EELISH_STD_ATOMICS)
+#include "atomics-std-inl.hpp"
+#elif defined(__GNUC__)
 #include "atomics-gcc-inl.hpp"
 #else
 #error "eelish only understands gcc atomics"
 #endif
 
+#if defined(__i386__) || defined(__x86_64__)
+#include "atomics-x86-inl.hpp"
+#else
+#error "eelish only understands x86 CPUs!"
+#endif
+
 #endif
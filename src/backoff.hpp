@@ -0,0 +1,188 @@
+#ifndef __EELISH_BACKOFF__HPP
+#define __EELISH_BACKOFF__HPP
+
+#include "atomics.hpp"
+#include "parking-lot.hpp"
+#include "platform.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// Backoff policies decide what a thread does when it runs into a
+/// state it cannot make progress from -- pop_back finding the tail
+/// slot primed by another thread, for instance.  Containers take the
+/// policy as a template parameter and create a fresh policy object
+/// for every operation, so a policy can remember things (like the
+/// current delay) across the retries of one operation.
+///
+/// A policy provides
+///
+///   template<typename Condition>
+///   void backoff(BackoffSite *site, const Condition &blocked);
+///
+/// which waits a while before the caller retries.  `blocked()` keeps
+/// returning true as long as the caller can't make progress.
+///
+/// Policies with `kParks` set may block in the kernel until some
+/// other thread calls `site->wake_waiters()`.  Containers using such
+/// a policy must do so after every change that may unblock a waiter.
+/// Parked threads also wake up on their own after kParkTimeoutUSecs,
+/// as a backstop; a container must not rely on it.
+
+/// Keeps track of threads parked on a container.
+class BackoffSite {
+ public:
+  inline BackoffSite() {
+    waiters_.raw_store(0);
+    generation_.raw_store(0);
+  }
+
+  template<typename Condition>
+  inline void park(const Condition &blocked);
+
+  /// Wakes up all parked threads.  The caller must have executed a
+  /// full barrier (a CAS will do) after making its change.
+  inline void wake_waiters();
+
+  /// Same as wake_waiters, for callers whose change was a plain store.
+  inline void fence_and_wake_waiters() {
+    full_memory_fence();
+    wake_waiters();
+  }
+
+  static const long kParkTimeoutUSecs = 1000;
+
+ private:
+  Atomic<Word> waiters_;
+  Atomic<Word> generation_;
+};
+
+
+template<typename Condition>
+void BackoffSite::park(const Condition &blocked) {
+  waiters_.fetch_add(1);
+
+  // The generation has to be read before re-checking `blocked`.  A
+  // waker makes its change, bumps the generation and only then wakes
+  // us up; so either we see the change here or ParkingLot::Wait sees
+  // the new generation and returns immediately.
+  Word generation = generation_.acquire_load();
+  if (blocked()) {
+    ParkingLot::Wait(&generation_, generation, kParkTimeoutUSecs);
+  }
+
+  waiters_.fetch_add(-1);
+}
+
+void BackoffSite::wake_waiters() {
+  if (unlikely(waiters_.nobarrier_load() != 0)) {
+    generation_.fetch_add(1);
+    ParkingLot::WakeAll(&generation_);
+  }
+}
+
+
+/// Sleeps for a microsecond; the default for the vectors.  In
+/// practice this is a usleep syscall, which takes far longer than a
+/// microsecond, but it gets the blocking thread out of the way.  On
+/// one CPU nothing below beats it at high thread counts.
+class SleepBackoff {
+ public:
+  static const bool kParks = false;
+
+  template<typename Condition>
+  inline void backoff(BackoffSite *, const Condition &) {
+    Platform::Sleep(1);
+  }
+};
+
+
+/// Spins on the pause instruction.
+class SpinBackoff {
+ public:
+  static const bool kParks = false;
+
+  template<typename Condition>
+  inline void backoff(BackoffSite *, const Condition &) {
+    cpu_relax();
+  }
+};
+
+
+/// Gives up the processor.
+class YieldBackoff {
+ public:
+  static const bool kParks = false;
+
+  template<typename Condition>
+  inline void backoff(BackoffSite *, const Condition &) {
+    Platform::Yield();
+  }
+};
+
+
+/// Spins for an exponentially growing number of pause instructions.
+/// The actual count is picked at random from the upper half of the
+/// current limit so that threads which collided once don't keep
+/// colliding in lockstep.
+class ExponentialBackoff {
+ public:
+  static const bool kParks = false;
+
+  inline ExponentialBackoff() :
+      limit_(kMinSpins),
+      random_(reinterpret_cast<Word>(this)) { }
+
+  template<typename Condition>
+  inline void backoff(BackoffSite *, const Condition &) {
+    spin();
+  }
+
+  inline void spin() {
+    int spins = limit_ / 2 + static_cast<int>(random_.next() % (limit_ / 2));
+    for (int i = 0; i < spins; i++) cpu_relax();
+    if (limit_ < kMaxSpins) limit_ *= 2;
+  }
+
+ private:
+  int limit_;
+  XorShiftRandom random_;
+
+  static const int kMinSpins = 4;
+  static const int kMaxSpins = 1024;
+};
+
+
+/// Escalates through the policies above: exponential spinning first,
+/// then yielding and finally parking till whoever is blocking us gets
+/// done.
+class AdaptiveBackoff {
+ public:
+  static const bool kParks = true;
+
+  inline AdaptiveBackoff() : rounds_(0) { }
+
+  template<typename Condition>
+  inline void backoff(BackoffSite *site, const Condition &blocked) {
+    if (rounds_ < kSpinRounds) {
+      spinner_.spin();
+    } else if (rounds_ < kSpinRounds + kYieldRounds) {
+      Platform::Yield();
+    } else {
+      site->park(blocked);
+      return;
+    }
+    rounds_++;
+  }
+
+ private:
+  int rounds_;
+  ExponentialBackoff spinner_;
+
+  static const int kSpinRounds = 8;
+  static const int kYieldRounds = 4;
+};
+
+}
+
+#endif
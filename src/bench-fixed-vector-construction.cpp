@@ -0,0 +1,118 @@
+#include "fixed-vector.hpp"
+#include "fixed-vector-variants.hpp"
+#include "tests.hpp"
+#include "value-fixed-vector.hpp"
+
+#include <cstdio>
+#include <map>
+#include <string>
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+/// What the tests construct in every synch_init.
+const size_t kVectorSize = 4 * 1024 * 1024;
+
+template<typename Vector>
+inline void push(Vector *vector, size_t i) {
+  vector->push_back(to_pointer(i));
+}
+
+/// ValueFixedVector stores values rather than pointers.  It is here as
+/// a vector that still initializes every slot up front.
+inline void push(ValueFixedVector<long, kVectorSize> *vector, size_t i) {
+  vector->push_back(i);
+}
+
+struct Timings {
+  long construct;
+  long fill;
+  long destroy;
+};
+
+/// Times constructing a vector, pushing `length` values into it and
+/// destroying it, in microseconds.  Pushing is where a vector whose
+/// slots are faulted in lazily pays for them.
+template<typename Vector>
+Timings time_once(size_t length) {
+  Timings timings;
+  long begin = Platform::CurrentTimeInUSec();
+  Vector *vector = new Vector;
+  long constructed = Platform::CurrentTimeInUSec();
+  for (size_t i = 0; i < length; i++) push(vector, i);
+  long filled = Platform::CurrentTimeInUSec();
+  delete vector;
+  long destroyed = Platform::CurrentTimeInUSec();
+
+  timings.construct = constructed - begin;
+  timings.fill = filled - constructed;
+  timings.destroy = destroyed - filled;
+  return timings;
+}
+
+
+struct BenchConfig {
+  long length;
+  int repetitions;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["length"].type = CommandLine::INTEGER;
+    arg_info["length"].integer = 0;
+
+    arg_info["repetitions"].type = CommandLine::INTEGER;
+    arg_info["repetitions"].integer = 10;
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    length = min(max(0L, arg_info["length"].integer),
+                 static_cast<long>(kVectorSize));
+    repetitions = max(1L, arg_info["repetitions"].integer);
+  }
+};
+
+/// Prints the mean and the minimum of every timing over the
+/// repetitions.
+template<typename Vector>
+void run(const char *name, BenchConfig *config) {
+  Timings total = { 0, 0, 0 };
+  Timings best = { -1, -1, -1 };
+  for (int i = 0; i < config->repetitions; i++) {
+    Timings timings = time_once<Vector>(config->length);
+    total.construct += timings.construct;
+    total.fill += timings.fill;
+    total.destroy += timings.destroy;
+    if (best.construct == -1 || timings.construct < best.construct) {
+      best.construct = timings.construct;
+    }
+    if (best.fill == -1 || timings.fill < best.fill) best.fill = timings.fill;
+    if (best.destroy == -1 || timings.destroy < best.destroy) {
+      best.destroy = timings.destroy;
+    }
+  }
+
+  double repetitions = config->repetitions;
+  printf("%-14s %10ld %10.0f %10ld %10.0f %10ld %10.0f %10ld\n", name,
+         config->length, total.construct / repetitions, best.construct,
+         total.fill / repetitions, best.fill,
+         total.destroy / repetitions, best.destroy);
+}
+
+}
+
+int main(int argc, char **argv) {
+  BenchConfig config;
+  config.read_config(argc, argv);
+
+  printf("%-14s %10s %21s %21s %21s\n", "", "", "construct usecs",
+         "fill usecs", "destroy usecs");
+  printf("%-14s %10s %10s %10s %10s %10s %10s %10s\n", "container",
+         "length", "mean", "min", "mean", "min", "mean", "min");
+  run<FixedVector<long, kVectorSize> >("real", &config);
+  run<EliminationFixedVector<long, kVectorSize> >("elimination", &config);
+  run<ShardedStack<long, kVectorSize> >("sharded", &config);
+  run<ValueFixedVector<long, kVectorSize> >("value", &config);
+  return 0;
+}
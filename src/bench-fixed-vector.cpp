@@ -0,0 +1,349 @@
+#include "benchmarks.hpp"
+#include "fixed-vector.hpp"
+#include "fixed-vector-variants.hpp"
+#include "tests.hpp"
+#include "topology.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const int kVectorSize = 4 * 1024 * 1024;
+const int kSampleValue = 4242;
+
+/// Pushes and pops done by every thread before the clock starts.
+const int kWarmUpOperations = 16 * 1024;
+
+
+template<template<typename T, size_t S> class Vec>
+class FixedVectorBenchmark : public ThreadedBenchmark {
+ public:
+  FixedVectorBenchmark(const string &container, const string &name,
+                       long operations) :
+      ThreadedBenchmark(container, name),
+      operations_(operations) { }
+
+ protected:
+  virtual void synch_init() {
+    vector_ = new Vec<long, kVectorSize>;
+  }
+
+  virtual void synch_destroy() {
+    delete vector_;
+  }
+
+  virtual void warm_up() {
+    for (int i = 0; i < kWarmUpOperations / 2; i++) {
+      definite_push(kSampleValue);
+      definite_pop();
+    }
+  }
+
+  long per_thread_operations() const {
+    return operations_ / get_thread_count();
+  }
+
+  long *definite_pop() {
+    while (true) {
+      long *value = vector_->pop_back(NULL);
+      if (!FixedVector<long, kVectorSize>::is_out_of_range(value)) {
+        return value;
+      }
+    }
+  }
+
+  void definite_push(int value) {
+    while (vector_->push_back(to_pointer(value)) == static_cast<size_t>(-1))
+      ;
+  }
+
+  long operations_;
+  Vec<long, kVectorSize> *vector_;
+};
+
+
+/// Every thread pushes its share of `operations` values into an empty
+/// vector.  `operations` must be at most kVectorSize.
+template<template<typename T, size_t S> class Vec>
+class PushOnlyBenchmark : public FixedVectorBenchmark<Vec> {
+ public:
+  PushOnlyBenchmark(const string &container, long operations) :
+      FixedVectorBenchmark<Vec>(container, "push-only", operations) { }
+
+ protected:
+  virtual void warm_up() { }
+
+  virtual long measured() {
+    long operations = FixedVectorBenchmark<Vec>::per_thread_operations();
+    for (long i = 0; i < operations; i++) {
+      FixedVectorBenchmark<Vec>::vector_->push_back(to_pointer(kSampleValue));
+    }
+    return operations;
+  }
+};
+
+
+/// kContiguity pushes followed by kContiguity pops, over and over.
+template<template<typename T, size_t S> class Vec>
+class PushPopBenchmark : public FixedVectorBenchmark<Vec> {
+ public:
+  PushPopBenchmark(const string &container, long operations) :
+      FixedVectorBenchmark<Vec>(container, "push-pop", operations) { }
+
+ protected:
+  virtual long measured() {
+    long iterations = FixedVectorBenchmark<Vec>::per_thread_operations() /
+        (2 * kContiguity);
+    for (long i = 0; i < iterations; i++) {
+      for (int j = 0; j < kContiguity; j++) {
+        FixedVectorBenchmark<Vec>::definite_push(kSampleValue);
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        FixedVectorBenchmark<Vec>::definite_pop();
+      }
+    }
+    return iterations * 2 * kContiguity;
+  }
+
+  static const int kContiguity = 8;
+};
+
+
+/// Same as PushPopBenchmark, with push_back_n and pop_back_n.  Each
+/// value pushed or popped counts as an operation.
+template<template<typename T, size_t S> class Vec>
+class BatchedPushPopBenchmark : public FixedVectorBenchmark<Vec> {
+ public:
+  BatchedPushPopBenchmark(const string &container, long operations) :
+      FixedVectorBenchmark<Vec>(container, "batched-push-pop", operations) { }
+
+ protected:
+  virtual long measured() {
+    long iterations = FixedVectorBenchmark<Vec>::per_thread_operations() /
+        (2 * kContiguity);
+    long *values[kContiguity];
+    long *popped[kContiguity];
+    fill(values, values + kContiguity, to_pointer(kSampleValue));
+
+    for (long i = 0; i < iterations; i++) {
+      size_t n = kContiguity;
+      while (n != 0) {
+        n -= FixedVectorBenchmark<Vec>::vector_->push_back_n(
+            values + kContiguity - n, n);
+      }
+      n = kContiguity;
+      while (n != 0) {
+        n -= FixedVectorBenchmark<Vec>::vector_->pop_back_n(
+            popped + kContiguity - n, n);
+      }
+    }
+    return iterations * 2 * kContiguity;
+  }
+
+  static const int kContiguity = 8;
+};
+
+
+/// kContiguity pushes, kContiguity reads at random indices and
+/// kContiguity pops, over and over.
+template<template<typename T, size_t S> class Vec>
+class PushPopGetBenchmark : public FixedVectorBenchmark<Vec> {
+ public:
+  PushPopGetBenchmark(const string &container, long operations) :
+      FixedVectorBenchmark<Vec>(container, "push-pop-get", operations) { }
+
+ protected:
+  virtual long measured() {
+    long iterations = FixedVectorBenchmark<Vec>::per_thread_operations() /
+        (3 * kContiguity);
+    XorShiftRandom random(reinterpret_cast<Word>(&iterations));
+    Vec<long, kVectorSize> *vector = FixedVectorBenchmark<Vec>::vector_;
+
+    // Sum what we read so that the reads can't be optimized away.
+    Word sum = 0;
+    for (long i = 0; i < iterations; i++) {
+      for (int j = 0; j < kContiguity; j++) {
+        FixedVectorBenchmark<Vec>::definite_push(kSampleValue);
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        size_t index = random.next() % (vector->length() + 1);
+        sum += reinterpret_cast<Word>(vector->get(index));
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        FixedVectorBenchmark<Vec>::definite_pop();
+      }
+    }
+    sink_.fetch_add(sum);
+    return iterations * 3 * kContiguity;
+  }
+
+  static const int kContiguity = 8;
+  Atomic<Word> sink_;
+};
+
+
+struct BenchConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  int repetitions;
+  long operations;
+  bool push_only;
+  bool push_pop;
+  bool batched_push_pop;
+  bool push_pop_get;
+  string test_type;
+  string format;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["push-only"].type = CommandLine::BOOL;
+    arg_info["push-only"].boolean = true;
+
+    arg_info["push-pop"].type = CommandLine::BOOL;
+    arg_info["push-pop"].boolean = true;
+
+    arg_info["batched-push-pop"].type = CommandLine::BOOL;
+    arg_info["batched-push-pop"].boolean = true;
+
+    arg_info["push-pop-get"].type = CommandLine::BOOL;
+    arg_info["push-pop-get"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    // Past one thread per CPU we'd mostly be benchmarking the
+    // scheduler.
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer = CpuTopology::Get().cpu_count();
+
+    arg_info["repetitions"].type = CommandLine::INTEGER;
+    arg_info["repetitions"].integer = 5;
+
+    arg_info["operations"].type = CommandLine::INTEGER;
+    arg_info["operations"].integer = 2 * 1024 * 1024;
+
+    arg_info["test-type"].type = CommandLine::STRING;
+    arg_info["test-type"].string = "real";
+
+    arg_info["format"].type = CommandLine::STRING;
+    arg_info["format"].string = "text";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    push_only = arg_info["push-only"].boolean;
+    push_pop = arg_info["push-pop"].boolean;
+    batched_push_pop = arg_info["batched-push-pop"].boolean;
+    push_pop_get = arg_info["push-pop-get"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+    repetitions = arg_info["repetitions"].integer;
+    operations = min(arg_info["operations"].integer,
+                     static_cast<long>(kVectorSize));
+    test_type = arg_info["test-type"].string;
+    format = arg_info["format"].string;
+  }
+};
+
+
+template<template<typename T, size_t Size> class Vec>
+void run_benchmarks_on_container(BenchConfig *config,
+                                 BenchmarkReport *report) {
+  const string &name = config->test_type;
+  long operations = config->operations;
+  int repetitions = config->repetitions;
+
+  for (int i = config->thread_count_lower;
+       i <= config->thread_count_upper;
+       i++) {
+    cerr << "benchmarking " << name << " with " << i << " threads" << endl;
+    if (config->push_only) {
+      report->add(PushOnlyBenchmark<Vec>(name, operations).execute(
+          i, repetitions));
+    }
+    if (config->push_pop) {
+      report->add(PushPopBenchmark<Vec>(name, operations).execute(
+          i, repetitions));
+    }
+    if (config->batched_push_pop) {
+      report->add(BatchedPushPopBenchmark<Vec>(name, operations).execute(
+          i, repetitions));
+    }
+    if (config->push_pop_get) {
+      report->add(PushPopGetBenchmark<Vec>(name, operations).execute(
+          i, repetitions));
+    }
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  BenchConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  cerr << "running on " << CpuTopology::Get().describe() << endl;
+
+  BenchmarkReport::Format format;
+  if (!BenchmarkReport::ParseFormat(config.format, &format)) {
+    cerr << "unknown format `" << config.format << "`" << endl;
+    return 1;
+  }
+
+  BenchmarkReport report;
+  if (config.test_type == "real") {
+    run_benchmarks_on_container<FixedVector>(&config, &report);
+  } else if (config.test_type == "fake") {
+    run_benchmarks_on_container<NaiveFixedVector>(&config, &report);
+  } else if (config.test_type == "fake-futex") {
+    run_benchmarks_on_container<
+      LockedFixedVector<FutexMutex>::Type>(&config, &report);
+  } else if (config.test_type == "fake-ticket") {
+    run_benchmarks_on_container<
+      LockedFixedVector<TicketLock>::Type>(&config, &report);
+  } else if (config.test_type == "fake-mcs") {
+    run_benchmarks_on_container<
+      LockedFixedVector<McsLock>::Type>(&config, &report);
+  } else if (config.test_type == "fake-clh") {
+    run_benchmarks_on_container<
+      LockedFixedVector<ClhLock>::Type>(&config, &report);
+  } else if (config.test_type == "elimination") {
+    run_benchmarks_on_container<EliminationFixedVector>(&config, &report);
+  } else if (config.test_type == "sharded") {
+    run_benchmarks_on_container<ShardedStack>(&config, &report);
+  } else if (config.test_type == "real-fetch-add") {
+    run_benchmarks_on_container<FetchAddFixedVector>(&config, &report);
+  } else if (config.test_type == "real-counted") {
+    run_benchmarks_on_container<CountedFixedVector>(&config, &report);
+  } else if (config.test_type == "real-huge-pages") {
+    run_benchmarks_on_container<HugePageFixedVector>(&config, &report);
+  } else if (config.test_type == "real-padded") {
+    run_benchmarks_on_container<PaddedFixedVector>(&config, &report);
+  } else if (config.test_type == "real-scattered") {
+    run_benchmarks_on_container<ScatteredFixedVector>(&config, &report);
+  } else if (config.test_type == "real-adaptive") {
+    run_benchmarks_on_container<
+      BackoffFixedVector<AdaptiveBackoff>::Type>(&config, &report);
+  } else if (config.test_type == "real-spin") {
+    run_benchmarks_on_container<
+      BackoffFixedVector<SpinBackoff>::Type>(&config, &report);
+  } else if (config.test_type == "real-exponential") {
+    run_benchmarks_on_container<
+      BackoffFixedVector<ExponentialBackoff>::Type>(&config, &report);
+  } else if (config.test_type == "real-yield") {
+    run_benchmarks_on_container<
+      BackoffFixedVector<YieldBackoff>::Type>(&config, &report);
+  } else {
+    cerr << "unknown test type `" << config.test_type << "`" << endl;
+    return 1;
+  }
+
+  report.write(format, cout);
+  return 0;
+}
@@ -0,0 +1,261 @@
+#include "benchmarks.hpp"
+#include "fixed-vector.hpp"
+#include "page-allocator.hpp"
+#include "tests.hpp"
+#include "topology.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+typedef FixedVector<long, kRuntimeCapacity> Vector;
+
+const int kSampleValue = 4242;
+
+/// Room left at the top of the vector for the push-pop benchmark's
+/// pushes.
+const size_t kHeadroom = 64 * 1024;
+
+
+/// The benchmarks share one vector per allocator, filled up to
+/// kHeadroom short of its capacity once, since filling a multi-GB
+/// vector takes much longer than benchmarking it.  Neither benchmark
+/// changes what is in it.
+class PageBenchmark : public ThreadedBenchmark {
+ public:
+  PageBenchmark(const string &container, const string &name,
+                Vector *vector, long operations) :
+      ThreadedBenchmark(container, name),
+      vector_(vector),
+      operations_(operations) { }
+
+ protected:
+  long per_thread_operations() const {
+    return operations_ / get_thread_count();
+  }
+
+  Vector *vector_;
+  long operations_;
+};
+
+
+/// Reads at random indices all over the vector: a TLB miss almost
+/// every time with small pages, once the vector is larger than what
+/// the TLB covers.
+class RandomGetBenchmark : public PageBenchmark {
+ public:
+  RandomGetBenchmark(const string &container, Vector *vector,
+                     long operations) :
+      PageBenchmark(container, "random-get", vector, operations) { }
+
+ protected:
+  virtual long measured() {
+    long operations = per_thread_operations();
+    XorShiftRandom random(reinterpret_cast<Word>(&operations));
+    size_t length = vector_->length();
+
+    // Sum what we read so that the reads can't be optimized away.
+    Word sum = 0;
+    for (long i = 0; i < operations; i++) {
+      sum += reinterpret_cast<Word>(vector_->get(random.next() % length));
+    }
+    sink_.fetch_add(sum);
+    return operations;
+  }
+
+  Atomic<Word> sink_;
+};
+
+
+/// kContiguity pushes followed by kContiguity pops at the top of the
+/// vector, as in bench-fixed-vector.  These stay within a few pages,
+/// so page size should matter little; this is the control.
+class PushPopBenchmark : public PageBenchmark {
+ public:
+  PushPopBenchmark(const string &container, Vector *vector,
+                   long operations) :
+      PageBenchmark(container, "push-pop", vector, operations) { }
+
+ protected:
+  virtual long measured() {
+    long iterations = per_thread_operations() / (2 * kContiguity);
+    for (long i = 0; i < iterations; i++) {
+      for (int j = 0; j < kContiguity; j++) {
+        while (vector_->push_back(to_pointer(kSampleValue)) ==
+               static_cast<size_t>(-1))
+          ;
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        while (Vector::is_out_of_range(vector_->pop_back(NULL)))
+          ;
+      }
+    }
+    return iterations * 2 * kContiguity;
+  }
+
+  static const int kContiguity = 8;
+};
+
+
+struct BenchConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  int repetitions;
+  long operations;
+  long capacity;
+  bool small_pages;
+  bool transparent_huge_pages;
+  bool explicit_huge_pages;
+  string placement;
+  string format;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["small-pages"].type = CommandLine::BOOL;
+    arg_info["small-pages"].boolean = true;
+
+    arg_info["transparent-huge-pages"].type = CommandLine::BOOL;
+    arg_info["transparent-huge-pages"].boolean = true;
+
+    arg_info["explicit-huge-pages"].type = CommandLine::BOOL;
+    arg_info["explicit-huge-pages"].boolean = true;
+
+    // default, local or interleaved; see PageAllocator::Placement.
+    arg_info["placement"].type = CommandLine::STRING;
+    arg_info["placement"].string = "default";
+
+    // 256MB of slots: far more than the TLB covers in small pages.
+    arg_info["capacity"].type = CommandLine::INTEGER;
+    arg_info["capacity"].integer = 32 * 1024 * 1024;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer = CpuTopology::Get().cpu_count();
+
+    arg_info["repetitions"].type = CommandLine::INTEGER;
+    arg_info["repetitions"].integer = 5;
+
+    arg_info["operations"].type = CommandLine::INTEGER;
+    arg_info["operations"].integer = 4 * 1024 * 1024;
+
+    arg_info["format"].type = CommandLine::STRING;
+    arg_info["format"].string = "text";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    small_pages = arg_info["small-pages"].boolean;
+    transparent_huge_pages = arg_info["transparent-huge-pages"].boolean;
+    explicit_huge_pages = arg_info["explicit-huge-pages"].boolean;
+    placement = arg_info["placement"].string;
+    capacity = max(arg_info["capacity"].integer,
+                   static_cast<long>(2 * kHeadroom));
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+    repetitions = arg_info["repetitions"].integer;
+    operations = arg_info["operations"].integer;
+    format = arg_info["format"].string;
+  }
+};
+
+bool parse_placement(const string &name,
+                     PageAllocator::Placement *out_placement) {
+  if (name == "default") {
+    *out_placement = PageAllocator::kDefaultPlacement;
+  } else if (name == "local") {
+    *out_placement = PageAllocator::kLocalPlacement;
+  } else if (name == "interleaved") {
+    *out_placement = PageAllocator::kInterleavedPlacement;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void run_benchmarks_on_allocator(const string &name,
+                                 const PageAllocator &allocator,
+                                 BenchConfig *config,
+                                 BenchmarkReport *report) {
+  // Explicit huge pages need a reserved pool, which most machines
+  // don't have; FixedVector would throw.
+  size_t size = config->capacity * sizeof(Atomic<long *>);
+  PageAllocator probe = allocator;
+  void *memory = probe.allocate(size);
+  if (memory == NULL) {
+    cerr << "skipping " << name << ": can't allocate " << size << " bytes"
+         << endl;
+    return;
+  }
+  probe.deallocate(memory, size);
+
+  Vector *vector = new Vector(config->capacity, allocator);
+  for (size_t i = 0; i < config->capacity - kHeadroom; i++) {
+    vector->push_back(to_pointer(kSampleValue));
+  }
+
+  for (int i = config->thread_count_lower;
+       i <= config->thread_count_upper;
+       i++) {
+    cerr << "benchmarking " << name << " with " << i << " threads" << endl;
+    report->add(RandomGetBenchmark(name, vector, config->operations).execute(
+        i, config->repetitions));
+    report->add(PushPopBenchmark(name, vector, config->operations).execute(
+        i, config->repetitions));
+  }
+
+  delete vector;
+}
+
+}
+
+int main(int argc, char **argv) {
+  BenchConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  cerr << "running on " << CpuTopology::Get().describe() << endl;
+
+  BenchmarkReport::Format format;
+  if (!BenchmarkReport::ParseFormat(config.format, &format)) {
+    cerr << "unknown format `" << config.format << "`" << endl;
+    return 1;
+  }
+
+  PageAllocator::Placement placement;
+  if (!parse_placement(config.placement, &placement)) {
+    cerr << "unknown placement `" << config.placement << "`" << endl;
+    return 1;
+  }
+  string suffix =
+      config.placement == "default" ? "" : "-" + config.placement;
+
+  BenchmarkReport report;
+  if (config.small_pages) {
+    run_benchmarks_on_allocator(
+        "small-pages" + suffix,
+        PageAllocator(PageAllocator::kSmallPages, placement),
+        &config, &report);
+  }
+  if (config.transparent_huge_pages) {
+    run_benchmarks_on_allocator(
+        "transparent-huge-pages" + suffix,
+        PageAllocator(PageAllocator::kTransparentHugePages, placement),
+        &config, &report);
+  }
+  if (config.explicit_huge_pages) {
+    run_benchmarks_on_allocator(
+        "explicit-huge-pages" + suffix,
+        PageAllocator(PageAllocator::kExplicitHugePages, placement),
+        &config, &report);
+  }
+
+  report.write(format, cout);
+  return 0;
+}
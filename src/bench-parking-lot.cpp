@@ -0,0 +1,213 @@
+#include "benchmarks.hpp"
+#include "cycle-clock.hpp"
+#include "histogram.hpp"
+#include "locks.hpp"
+#include "parking-lot.hpp"
+#include "tests.hpp"
+#include "topology.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+/// Hand-offs through futex(2) on the low half of the turn word, which
+/// only ever holds 0 or 1.
+class FutexWords {
+ public:
+  static inline void Wait(Atomic<Word> *turn, Word value) {
+    ParkingLot::Wait(low_half(turn), static_cast<int32_t>(value));
+  }
+
+  static inline void Wake(Atomic<Word> *turn) {
+    ParkingLot::WakeOne(low_half(turn));
+  }
+
+ private:
+  static inline volatile int32_t *low_half(Atomic<Word> *turn) {
+    return reinterpret_cast<volatile int32_t *>(turn->raw_location());
+  }
+};
+
+/// Hand-offs through the ParkingLot's hashed wait queues.
+class HashedWords {
+ public:
+  static inline void Wait(Atomic<Word> *turn, Word value) {
+    ParkingLot::Wait(turn, value);
+  }
+
+  static inline void Wake(Atomic<Word> *turn) {
+    ParkingLot::WakeOne(turn);
+  }
+};
+
+
+/// Threads pair up and pass a turn back and forth, parking in between
+/// without spinning first, so every hand-off is a wake-up.  The
+/// throughput is hand-offs per second; the time from a thread handing
+/// the turn over till its partner is back from Wait is recorded as
+/// the wake latency.
+template<typename Words>
+class WakeLatencyBenchmark : public ThreadedBenchmark {
+ public:
+  WakeLatencyBenchmark(const string &words, long operations) :
+      ThreadedBenchmark("parking-lot-" + words, "wake-latency"),
+      operations_(operations),
+      pairs_(NULL) { }
+
+  /// Prints the latencies recorded in all repetitions so far.
+  void report_latencies(const char *words) {
+    fprintf(stderr, "%s wake latency with %d threads (ns): p50 %.0f "
+            "p99 %.0f p99.9 %.0f max %.0f, %llu samples\n", words,
+            get_thread_count(),
+            CycleClock::ToNanoseconds(latencies_.percentile(50)),
+            CycleClock::ToNanoseconds(latencies_.percentile(99)),
+            CycleClock::ToNanoseconds(latencies_.percentile(99.9)),
+            CycleClock::ToNanoseconds(latencies_.max()),
+            static_cast<unsigned long long>(latencies_.count()));
+  }
+
+ protected:
+  virtual void synch_init() {
+    pairs_ = new Pair[get_thread_count() / 2];
+    for (int i = 0; i < get_thread_count() / 2; i++) {
+      pairs_[i].turn.raw_store(0);
+      pairs_[i].handed_at = 0;
+    }
+    next_thread_.raw_store(0);
+  }
+
+  virtual void synch_destroy() {
+    delete[] pairs_;
+  }
+
+  virtual long measured() {
+    int index = static_cast<int>(next_thread_.fetch_add(1));
+    Pair *pair = &pairs_[index / 2];
+    Word side = index % 2;
+    long hand_offs = operations_ / get_thread_count();
+    LogHistogram latencies;
+
+    for (long i = 0; i < hand_offs; i++) {
+      while (pair->turn.acquire_load() != side) {
+        Words::Wait(&pair->turn, 1 - side);
+      }
+      if (pair->handed_at != 0) {
+        latencies.record(CycleClock::Now() - pair->handed_at);
+      }
+
+      pair->handed_at = CycleClock::Now();
+      pair->turn.release_store(1 - side);
+      Words::Wake(&pair->turn);
+    }
+
+    MutexLocker<> lock(&latencies_mutex_);
+    latencies_.merge(latencies);
+    return hand_offs;
+  }
+
+ private:
+  struct Pair {
+    Atomic<Word> turn;
+
+    /// When the turn was last handed over; written by the thread
+    /// handing it over, before it does.
+    uint64_t handed_at;
+  } __attribute__((aligned(kCacheLineSize)));
+
+  long operations_;
+  Pair *pairs_;
+  Atomic<Word> next_thread_;
+
+  Mutex latencies_mutex_;
+  LogHistogram latencies_;
+};
+
+struct BenchConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  int repetitions;
+  long operations;
+  bool futex;
+  bool hashed;
+  string format;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["futex"].type = CommandLine::BOOL;
+    arg_info["futex"].boolean = true;
+
+    arg_info["hashed"].type = CommandLine::BOOL;
+    arg_info["hashed"].boolean = true;
+
+    // Threads come in pairs; odd counts are skipped.
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 2;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        max(2, CpuTopology::Get().cpu_count());
+
+    arg_info["repetitions"].type = CommandLine::INTEGER;
+    arg_info["repetitions"].integer = 5;
+
+    arg_info["operations"].type = CommandLine::INTEGER;
+    arg_info["operations"].integer = 128 * 1024;
+
+    arg_info["format"].type = CommandLine::STRING;
+    arg_info["format"].string = "text";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    futex = arg_info["futex"].boolean;
+    hashed = arg_info["hashed"].boolean;
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+    repetitions = arg_info["repetitions"].integer;
+    operations = arg_info["operations"].integer;
+    format = arg_info["format"].string;
+  }
+};
+
+
+template<typename Words>
+void run_benchmark(const char *words, BenchConfig *config,
+                   BenchmarkReport *report) {
+  for (int i = config->thread_count_lower;
+       i <= config->thread_count_upper;
+       i++) {
+    if (i % 2 != 0) continue;
+    cerr << "benchmarking " << words << " words with " << i << " threads"
+         << endl;
+    WakeLatencyBenchmark<Words> benchmark(words, config->operations);
+    report->add(benchmark.execute(i, config->repetitions));
+    benchmark.report_latencies(words);
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  BenchConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  cerr << "running on " << CpuTopology::Get().describe() << endl;
+
+  BenchmarkReport::Format format;
+  if (!BenchmarkReport::ParseFormat(config.format, &format)) {
+    cerr << "unknown format `" << config.format << "`" << endl;
+    return 1;
+  }
+
+  BenchmarkReport report;
+  if (config.futex) run_benchmark<FutexWords>("futex", &config, &report);
+  if (config.hashed) run_benchmark<HashedWords>("hashed", &config, &report);
+
+  report.write(format, cout);
+  return 0;
+}
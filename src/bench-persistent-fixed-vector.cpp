@@ -0,0 +1,147 @@
+#include "fixed-vector.hpp"
+#include "persistent-fixed-vector.hpp"
+#include "tests.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const size_t kVectorSize = 4 * 1024 * 1024;
+
+typedef PersistentFixedVector<> Vector;
+
+/// How a service gets its work list back after a restart.  Each
+/// returns the time it took, in microseconds.
+///
+/// rebuild: constructs a FixedVector and pushes `length` values into
+///   it, which is what we do today.
+///
+/// reopen: opens a PersistentFixedVector holding `length` values that
+///   was closed properly.
+///
+/// recover: opens a PersistentFixedVector holding `length` values that
+///   a crashed process left open, which takes a recovery pass.
+long time_rebuild(const string &, size_t length) {
+  long begin = Platform::CurrentTimeInUSec();
+  FixedVector<long, kVectorSize> *vector = new FixedVector<long, kVectorSize>;
+  for (size_t i = 0; i < length; i++) vector->push_back(to_pointer(i));
+  long elapsed = Platform::CurrentTimeInUSec() - begin;
+  delete vector;
+  return elapsed;
+}
+
+void fill(const string &path, size_t length) {
+  unlink(path.c_str());
+  Vector *vector = Vector::Open(path, kVectorSize);
+  if (vector == NULL) {
+    cerr << "can't open `" << path << "`" << endl;
+    exit(1);
+  }
+  for (size_t i = 0; i < length; i++) vector->push_back(i);
+  delete vector;
+}
+
+long time_open(const string &path) {
+  long begin = Platform::CurrentTimeInUSec();
+  Vector *vector = Vector::Open(path, kVectorSize);
+  long elapsed = Platform::CurrentTimeInUSec() - begin;
+  delete vector;
+  return elapsed;
+}
+
+long time_reopen(const string &path, size_t length) {
+  fill(path, length);
+  return time_open(path);
+}
+
+long time_recover(const string &path, size_t length) {
+  fill(path, length);
+
+  // A child that opens the vector and exits without closing it leaves
+  // it just like a crash would.
+  pid_t child = fork();
+  if (child == 0) {
+    Vector::Open(path, kVectorSize);
+    _exit(0);
+  }
+  waitpid(child, NULL, 0);
+  return time_open(path);
+}
+
+
+struct BenchConfig {
+  long length;
+  int repetitions;
+  bool rebuild;
+  bool reopen;
+  bool recover;
+  string path;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["rebuild"].type = CommandLine::BOOL;
+    arg_info["rebuild"].boolean = true;
+
+    arg_info["reopen"].type = CommandLine::BOOL;
+    arg_info["reopen"].boolean = true;
+
+    arg_info["recover"].type = CommandLine::BOOL;
+    arg_info["recover"].boolean = true;
+
+    arg_info["length"].type = CommandLine::INTEGER;
+    arg_info["length"].integer = kVectorSize;
+
+    arg_info["repetitions"].type = CommandLine::INTEGER;
+    arg_info["repetitions"].integer = 5;
+
+    arg_info["path"].type = CommandLine::STRING;
+    arg_info["path"].string = "/tmp/eelish-bench-persistent-vector";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    rebuild = arg_info["rebuild"].boolean;
+    reopen = arg_info["reopen"].boolean;
+    recover = arg_info["recover"].boolean;
+    length = min(arg_info["length"].integer, static_cast<long>(kVectorSize));
+    repetitions = max(1L, arg_info["repetitions"].integer);
+    path = arg_info["path"].string;
+  }
+};
+
+void run(const char *name, long (*restart)(const string &, size_t),
+         BenchConfig *config) {
+  long total = 0;
+  long best = -1;
+  for (int i = 0; i < config->repetitions; i++) {
+    long elapsed = restart(config->path, config->length);
+    total += elapsed;
+    if (best == -1 || elapsed < best) best = elapsed;
+  }
+  printf("%-10s %10ld %14.0f %14ld\n", name, config->length,
+         static_cast<double>(total) / config->repetitions, best);
+}
+
+}
+
+int main(int argc, char **argv) {
+  BenchConfig config;
+  config.read_config(argc, argv);
+
+  printf("%-10s %10s %14s %14s\n", "restart", "length", "mean usecs",
+         "min usecs");
+  if (config.rebuild) run("rebuild", time_rebuild, &config);
+  if (config.reopen) run("reopen", time_reopen, &config);
+  if (config.recover) run("recover", time_recover, &config);
+
+  unlink(config.path.c_str());
+  return 0;
+}
@@ -0,0 +1,321 @@
+#include "benchmarks.hpp"
+#include "fixed-vector.hpp"
+#include "shared-fixed-vector.hpp"
+#include "tests.hpp"
+#include "topology.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const int kVectorSize = 1024 * 1024;
+
+/// kContiguity pushes followed by kContiguity pops, over and over, as
+/// in bench-fixed-vector.  Every thread pushes items of its own, which
+/// it gets back as often as not.
+const int kContiguity = 8;
+
+/// Pushes and pops done by every thread before the clock starts.
+const int kWarmUpOperations = 16 * 1024;
+
+typedef SharedFixedVector<long> SharedVector;
+
+
+/// The vectors under comparison, each behind the same three calls.
+/// `thread` numbers the threads (or processes) from 0, and picks the
+/// items they push.
+class InProcessVector {
+ public:
+  InProcessVector() : vector_(new FixedVector<long, kVectorSize>) { }
+  ~InProcessVector() { delete vector_; }
+
+  inline void push(int thread, int item) {
+    while (vector_->push_back(&items_[thread * kContiguity + item]) ==
+           static_cast<size_t>(-1))
+      ;
+  }
+
+  inline void pop() {
+    while (FixedVector<long, kVectorSize>::is_out_of_range(
+               vector_->pop_back(NULL)))
+      ;
+  }
+
+ private:
+  FixedVector<long, kVectorSize> *vector_;
+  long items_[kVectorSize];
+};
+
+class SharedVectorHandle {
+ public:
+  explicit SharedVectorHandle(SharedVector *vector) : vector_(vector) { }
+
+  inline void push(int thread, int item) {
+    while (vector_->push_back(vector_->arena() + thread * kContiguity +
+                              item) == static_cast<size_t>(-1))
+      ;
+  }
+
+  inline void pop() {
+    long *item;
+    while (!vector_->pop_back(&item, NULL))
+      ;
+  }
+
+ private:
+  SharedVector *vector_;
+};
+
+template<typename Vector>
+long PushPop(Vector *vector, int thread, long operations) {
+  long iterations = operations / (2 * kContiguity);
+  for (long i = 0; i < iterations; i++) {
+    for (int j = 0; j < kContiguity; j++) vector->push(thread, j);
+    for (int j = 0; j < kContiguity; j++) vector->pop();
+  }
+  return iterations * 2 * kContiguity;
+}
+
+
+class PushPopBenchmark : public ThreadedBenchmark {
+ public:
+  PushPopBenchmark(const string &container, long operations) :
+      ThreadedBenchmark(container, "push-pop"),
+      operations_(operations) { }
+
+ protected:
+  long per_thread_operations() const {
+    return operations_ / get_thread_count();
+  }
+
+  /// Hands out thread numbers, afresh every repetition.
+  int next_thread() { return next_thread_.fetch_add(1); }
+
+  virtual void synch_init() { next_thread_.raw_store(0); }
+
+  long operations_;
+
+ private:
+  Atomic<Word> next_thread_;
+};
+
+
+/// FixedVector, in process.  What SharedFixedVector is measured
+/// against.
+class InProcessBenchmark : public PushPopBenchmark {
+ public:
+  explicit InProcessBenchmark(long operations) :
+      PushPopBenchmark("fixed-vector", operations) { }
+
+ protected:
+  virtual void synch_init() {
+    PushPopBenchmark::synch_init();
+    vector_ = new InProcessVector;
+  }
+
+  virtual void synch_destroy() { delete vector_; }
+
+  virtual void warm_up() {
+    thread_ = next_thread();
+    PushPop(vector_, thread_, kWarmUpOperations);
+  }
+
+  virtual long measured() {
+    return PushPop(vector_, thread_, per_thread_operations());
+  }
+
+  static __thread int thread_;
+  InProcessVector *vector_;
+};
+
+__thread int InProcessBenchmark::thread_;
+
+
+/// SharedFixedVector, with the segment created by the benchmark.
+/// With `processes` every thread forks a child during warm-up that
+/// attaches to the segment and does the thread's pushes and pops,
+/// released by the thread once the clock starts; the thread then
+/// waits for it.  Otherwise the threads push and pop themselves.
+class SharedBenchmark : public PushPopBenchmark {
+ public:
+  SharedBenchmark(long operations, const string &name, bool processes) :
+      PushPopBenchmark(processes ? "shared-processes" : "shared-threads",
+                       operations),
+      name_(name),
+      processes_(processes) { }
+
+ protected:
+  virtual void synch_init() {
+    PushPopBenchmark::synch_init();
+    SharedVector::Unlink(name_);
+    vector_ = SharedVector::Create(name_, kVectorSize, kVectorSize);
+    if (vector_ == NULL) {
+      cerr << "can't create `" << name_ << "`" << endl;
+      exit(1);
+    }
+  }
+
+  virtual void synch_destroy() {
+    delete vector_;
+    SharedVector::Unlink(name_);
+  }
+
+  virtual void warm_up() {
+    thread_ = next_thread();
+    if (!processes_) {
+      SharedVectorHandle handle(vector_);
+      PushPop(&handle, thread_, kWarmUpOperations);
+      return;
+    }
+
+    if (pipe(start_) != 0) exit(1);
+    child_ = fork();
+    if (child_ == 0) RunChild(name_, start_[0], thread_,
+                              per_thread_operations());
+    close(start_[0]);
+  }
+
+  virtual long measured() {
+    if (!processes_) {
+      SharedVectorHandle handle(vector_);
+      return PushPop(&handle, thread_, per_thread_operations());
+    }
+
+    char byte = 0;
+    if (write(start_[1], &byte, 1) != 1) exit(1);
+    close(start_[1]);
+    int status;
+    waitpid(child_, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) exit(1);
+    return per_thread_operations() / (2 * kContiguity) * 2 * kContiguity;
+  }
+
+ private:
+  static void RunChild(const string &name, int start, int thread,
+                       long operations) {
+    SharedVector *vector = SharedVector::Attach(name);
+    if (vector == NULL) _exit(1);
+    SharedVectorHandle handle(vector);
+    PushPop(&handle, thread, kWarmUpOperations);
+
+    char byte;
+    if (read(start, &byte, 1) != 1) _exit(1);
+    PushPop(&handle, thread, operations);
+    _exit(0);
+  }
+
+  string name_;
+  bool processes_;
+  SharedVector *vector_;
+
+  static __thread int thread_;
+  static __thread pid_t child_;
+  static __thread int start_[2];
+};
+
+__thread int SharedBenchmark::thread_;
+__thread pid_t SharedBenchmark::child_;
+__thread int SharedBenchmark::start_[2];
+
+
+struct BenchConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  int repetitions;
+  long operations;
+  bool in_process;
+  bool shared_threads;
+  bool shared_processes;
+  string format;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["in-process"].type = CommandLine::BOOL;
+    arg_info["in-process"].boolean = true;
+
+    arg_info["shared-threads"].type = CommandLine::BOOL;
+    arg_info["shared-threads"].boolean = true;
+
+    arg_info["shared-processes"].type = CommandLine::BOOL;
+    arg_info["shared-processes"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer = CpuTopology::Get().cpu_count();
+
+    arg_info["repetitions"].type = CommandLine::INTEGER;
+    arg_info["repetitions"].integer = 5;
+
+    arg_info["operations"].type = CommandLine::INTEGER;
+    arg_info["operations"].integer = 2 * 1024 * 1024;
+
+    arg_info["format"].type = CommandLine::STRING;
+    arg_info["format"].string = "text";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    in_process = arg_info["in-process"].boolean;
+    shared_threads = arg_info["shared-threads"].boolean;
+    shared_processes = arg_info["shared-processes"].boolean;
+
+    // Every thread pushes items of its own, kContiguity of them.
+    thread_count_lower = max(1L, arg_info["thread-count-lower"].integer);
+    thread_count_upper = min(arg_info["thread-count-upper"].integer,
+                             static_cast<long>(kVectorSize / kContiguity));
+    repetitions = arg_info["repetitions"].integer;
+    operations = arg_info["operations"].integer;
+    format = arg_info["format"].string;
+  }
+};
+
+}
+
+int main(int argc, char **argv) {
+  BenchConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  cerr << "running on " << CpuTopology::Get().describe() << endl;
+
+  BenchmarkReport::Format format;
+  if (!BenchmarkReport::ParseFormat(config.format, &format)) {
+    cerr << "unknown format `" << config.format << "`" << endl;
+    return 1;
+  }
+
+  char name[64];
+  snprintf(name, sizeof(name), "/eelish-bench-shared-vector-%d",
+           static_cast<int>(getpid()));
+
+  BenchmarkReport report;
+  for (int i = config.thread_count_lower;
+       i <= config.thread_count_upper;
+       i++) {
+    cerr << "benchmarking with " << i << " threads" << endl;
+    if (config.in_process) {
+      report.add(InProcessBenchmark(config.operations).execute(
+          i, config.repetitions));
+    }
+    if (config.shared_threads) {
+      report.add(SharedBenchmark(config.operations, name, false).execute(
+          i, config.repetitions));
+    }
+    if (config.shared_processes) {
+      report.add(SharedBenchmark(config.operations, name, true).execute(
+          i, config.repetitions));
+    }
+  }
+
+  report.write(format, cout);
+  return 0;
+}
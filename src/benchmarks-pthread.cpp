@@ -0,0 +1,67 @@
+#include "benchmarks.hpp"
+
+#include <pthread.h>
+
+#include "topology.hpp"
+
+using namespace std;
+using namespace eelish;
+
+struct ThreadedBenchmark::PlatformData {
+  pthread_barrier_t start_barrier;
+};
+
+void ThreadedBenchmark::initialize_platform() {
+  platform_data_ = new PlatformData();
+}
+
+void ThreadedBenchmark::destroy_platform() {
+  delete platform_data_;
+}
+
+void ThreadedBenchmark::wait_for_start() {
+  pthread_barrier_wait(&platform_data_->start_barrier);
+}
+
+static void *thread_function(void *data) {
+  reinterpret_cast<ThreadedBenchmark *>(data)->run_thread();
+  return NULL;
+}
+
+double ThreadedBenchmark::run_once() {
+  operations_.raw_store(0);
+  end_time_.raw_store(0);
+
+  // The master thread waits on the barrier too, so that it knows when
+  // the threads have been let go.
+  pthread_barrier_init(&platform_data_->start_barrier, NULL,
+                       thread_count_ + 1);
+
+  vector<int> cpus = ThreadPlacement::cpus(thread_count_);
+  pthread_t *thread_ids = new pthread_t[thread_count_];
+  for (int i = 0; i < thread_count_; i++) {
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    if (!cpus.empty()) {
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(cpus[i], &cpu_set);
+      pthread_attr_setaffinity_np(&attributes, sizeof(cpu_set), &cpu_set);
+    }
+    pthread_create(&thread_ids[i], &attributes, thread_function, this);
+    pthread_attr_destroy(&attributes);
+  }
+
+  wait_for_start();
+  long start_time = Platform::CurrentTimeInUSec();
+
+  for (int i = 0; i < thread_count_; i++) {
+    pthread_join(thread_ids[i], NULL);
+  }
+  delete[] thread_ids;
+  pthread_barrier_destroy(&platform_data_->start_barrier);
+
+  long elapsed = static_cast<long>(end_time_.raw_load()) - start_time;
+  if (elapsed <= 0) elapsed = 1;
+  return operations_.raw_load() * 1e6 / elapsed;
+}
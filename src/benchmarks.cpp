@@ -0,0 +1,134 @@
+#include "benchmarks.hpp"
+
+#include <cmath>
+#include <cstdio>
+
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+bool BenchmarkReport::ParseFormat(const string &name, Format *out_format) {
+  if (name == "text") {
+    *out_format = TEXT;
+  } else if (name == "csv") {
+    *out_format = CSV;
+  } else if (name == "json") {
+    *out_format = JSON;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void BenchmarkReport::write(Format format, ostream &out) const {
+  char line[512];
+
+  switch (format) {
+    case TEXT:
+      snprintf(line, sizeof(line), "%-28s %-18s %7s %14s %12s  %s\n",
+               "container", "benchmark", "threads", "ops/sec", "stddev",
+               "pinning");
+      out << line;
+      for (size_t i = 0; i < results_.size(); i++) {
+        const BenchmarkResult &r = results_[i];
+        // A placement lists a CPU per thread, so it goes out separately
+        // rather than through the fixed size line.
+        snprintf(line, sizeof(line), "%-28s %-18s %7d %14.0f %12.0f  ",
+                 r.container.c_str(), r.benchmark.c_str(), r.thread_count,
+                 r.mean_ops_per_sec, r.stddev_ops_per_sec);
+        out << line << r.placement << "\n";
+      }
+      break;
+
+    case CSV:
+      out << "container,benchmark,threads,repetitions,mean_ops_per_sec,"
+          << "stddev_ops_per_sec,min_ops_per_sec,max_ops_per_sec,pinning\n";
+      for (size_t i = 0; i < results_.size(); i++) {
+        const BenchmarkResult &r = results_[i];
+        snprintf(line, sizeof(line), "%s,%s,%d,%d,%.0f,%.0f,%.0f,%.0f,",
+                 r.container.c_str(), r.benchmark.c_str(), r.thread_count,
+                 r.repetitions, r.mean_ops_per_sec, r.stddev_ops_per_sec,
+                 r.min_ops_per_sec, r.max_ops_per_sec);
+        out << line << r.placement << "\n";
+      }
+      break;
+
+    case JSON:
+      // Container and benchmark names are plain identifiers and
+      // placements are digits and spaces, so they need no escaping.
+      out << "[\n";
+      for (size_t i = 0; i < results_.size(); i++) {
+        const BenchmarkResult &r = results_[i];
+        snprintf(line, sizeof(line),
+                 "  {\"container\": \"%s\", \"benchmark\": \"%s\", "
+                 "\"threads\": %d, \"repetitions\": %d, "
+                 "\"mean_ops_per_sec\": %.0f, \"stddev_ops_per_sec\": %.0f, "
+                 "\"min_ops_per_sec\": %.0f, \"max_ops_per_sec\": %.0f, "
+                 "\"pinning\": \"",
+                 r.container.c_str(), r.benchmark.c_str(), r.thread_count,
+                 r.repetitions, r.mean_ops_per_sec, r.stddev_ops_per_sec,
+                 r.min_ops_per_sec, r.max_ops_per_sec);
+        out << line << r.placement << "\"}"
+            << (i + 1 == results_.size() ? "" : ",") << "\n";
+      }
+      out << "]\n";
+      break;
+  }
+}
+
+BenchmarkResult ThreadedBenchmark::execute(int thread_count,
+                                           int repetitions) {
+  thread_count_ = thread_count;
+  if (repetitions < 1) repetitions = 1;
+
+  vector<double> samples;
+  for (int i = 0; i < repetitions; i++) {
+    synch_init();
+    samples.push_back(run_once());
+    synch_destroy();
+  }
+
+  BenchmarkResult result;
+  result.container = container_;
+  result.benchmark = benchmark_;
+  result.thread_count = thread_count;
+  result.repetitions = repetitions;
+  result.placement = ThreadPlacement::describe(thread_count);
+
+  double sum = 0;
+  result.min_ops_per_sec = samples[0];
+  result.max_ops_per_sec = samples[0];
+  for (size_t i = 0; i < samples.size(); i++) {
+    sum += samples[i];
+    result.min_ops_per_sec = min(result.min_ops_per_sec, samples[i]);
+    result.max_ops_per_sec = max(result.max_ops_per_sec, samples[i]);
+  }
+  result.mean_ops_per_sec = sum / samples.size();
+
+  // The sample standard deviation; 0 for a single repetition.
+  double squares = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    double delta = samples[i] - result.mean_ops_per_sec;
+    squares += delta * delta;
+  }
+  result.stddev_ops_per_sec =
+      samples.size() > 1 ? sqrt(squares / (samples.size() - 1)) : 0;
+
+  return result;
+}
+
+void ThreadedBenchmark::run_thread() {
+  warm_up();
+  wait_for_start();
+
+  long operations = measured();
+
+  Word now = static_cast<Word>(Platform::CurrentTimeInUSec());
+  operations_.fetch_add(operations);
+  Word end_time;
+  do {
+    end_time = end_time_.nobarrier_load();
+    if (end_time >= now) break;
+  } while (!end_time_.boolean_cas(end_time, now));
+}
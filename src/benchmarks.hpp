@@ -0,0 +1,111 @@
+#ifndef __EELISH_BENCHMARKS__HPP
+#define __EELISH_BENCHMARKS__HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "platform.hpp"
+
+namespace eelish {
+
+/// The throughput of one benchmark at one thread count, over several
+/// repetitions.
+struct BenchmarkResult {
+  std::string container;
+  std::string benchmark;
+  int thread_count;
+  int repetitions;
+
+  /// Where the threads ran, as ThreadPlacement::describe has it.
+  std::string placement;
+
+  /// Operations per second, summed over all threads.
+  double mean_ops_per_sec;
+  double stddev_ops_per_sec;
+  double min_ops_per_sec;
+  double max_ops_per_sec;
+};
+
+/// The benchmark counterpart of ThreadedTest.
+///
+/// A ThreadedTest times everything: creating threads, setting the
+/// container up, verifying it.  A ThreadedBenchmark times only the
+/// steady state.  Every repetition runs synch_init in the master
+/// thread, then warm_up in every thread.  Once all threads are warmed
+/// up they are let go together and run `measured`.  The clock runs
+/// from that moment till the last thread is done with `measured`.
+class ThreadedBenchmark {
+ public:
+  BenchmarkResult execute(int thread_count, int repetitions);
+
+  /// Runs warm_up and then measured, for the thread function.
+  void run_thread();
+
+ protected:
+  ThreadedBenchmark(const std::string &container,
+                    const std::string &benchmark) :
+      container_(container),
+      benchmark_(benchmark) {
+    initialize_platform();
+  }
+
+  /// The synch_* functions are all executed in the master thread,
+  /// outside the timed region.
+  virtual void synch_init() { }
+  virtual void synch_destroy() { }
+
+  virtual void warm_up() { }
+
+  /// The part being timed.  Returns how many operations this thread
+  /// did.
+  virtual long measured() = 0;
+
+  int get_thread_count() const { return thread_count_; }
+
+  virtual ~ThreadedBenchmark() { destroy_platform(); }
+
+ private:
+  /// Runs one repetition and returns its throughput.
+  double run_once();
+
+  std::string container_;
+  std::string benchmark_;
+  int thread_count_;
+
+  /// Filled in by the threads as they finish `measured`.
+  Atomic<Word> operations_;
+  Atomic<Word> end_time_;
+
+  struct PlatformData;
+  PlatformData *platform_data_;
+  void initialize_platform();
+  void destroy_platform();
+
+  /// Blocks till all threads and the master thread are waiting.
+  void wait_for_start();
+};
+
+/// Collects BenchmarkResults and writes them out, as a human readable
+/// table, as CSV or as a JSON array.
+class BenchmarkReport {
+ public:
+  enum Format {
+    TEXT,
+    CSV,
+    JSON
+  };
+
+  /// Returns false if `name` isn't one of "text", "csv" or "json".
+  static bool ParseFormat(const std::string &name, Format *out_format);
+
+  void add(const BenchmarkResult &result) { results_.push_back(result); }
+  void write(Format format, std::ostream &out) const;
+
+ private:
+  std::vector<BenchmarkResult> results_;
+};
+
+}
+
+#endif
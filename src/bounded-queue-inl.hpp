@@ -0,0 +1,115 @@
+#ifndef __EELISH_BOUNDED_QUEUE__HPP
+#error "bounded-queue-inl.hpp can only be included from within \
+        bounded-queue.hpp"
+#endif
+
+namespace eelish {
+
+template<typename T, std::size_t Size, typename Backoff>
+BoundedQueue<T, Size, Backoff>::BoundedQueue() {
+  assert_static((Size & (Size - 1)) == 0);
+
+  head_.word.raw_store(0);
+  tail_.word.raw_store(0);
+  for (std::size_t i = 0; i < Size; i++) {
+    slots_[i].sequence.raw_store(i);
+    slots_[i].value.raw_store(NULL);
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+bool BoundedQueue<T, Size, Backoff>::try_enqueue(T *value) {
+  Word tail = tail_.word.nobarrier_load();
+  Slot *slot;
+
+  while (true) {
+    slot = &slots_[tail & kIndexMask];
+    intptr_t lag =
+        static_cast<intptr_t>(slot->sequence.acquire_load() - tail);
+
+    if (lag == 0) {
+      Word seen = tail_.word.value_cas(tail, tail + 1);
+      if (seen == tail) break;
+      tail = seen;
+    } else if (lag < 0) {
+      // The slot still holds the value enqueued a lap ago.
+      return false;
+    } else {
+      // Another enqueue got this position, try the next one.
+      tail = tail_.word.nobarrier_load();
+    }
+  }
+
+  slot->value.nobarrier_store(value);
+
+  // Publishing the sequence hands the slot to the dequeue at `tail`,
+  // which has to see the value.
+  slot->sequence.release_store(tail + 1);
+
+  // The sequence is published with a plain store, which a dequeue
+  // about to park may not see yet; the fence makes sure that either
+  // it does, or we see it registered as a waiter.
+  if (Backoff::kParks) not_empty_.fence_and_wake_waiters();
+  return true;
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+bool BoundedQueue<T, Size, Backoff>::try_dequeue(T **out_value) {
+  Word head = head_.word.nobarrier_load();
+  Slot *slot;
+
+  while (true) {
+    slot = &slots_[head & kIndexMask];
+    intptr_t lag =
+        static_cast<intptr_t>(slot->sequence.acquire_load() - (head + 1));
+
+    if (lag == 0) {
+      Word seen = head_.word.value_cas(head, head + 1);
+      if (seen == head) break;
+      head = seen;
+    } else if (lag < 0) {
+      // Nothing has been enqueued at this position yet.
+      return false;
+    } else {
+      head = head_.word.nobarrier_load();
+    }
+  }
+
+  *out_value = slot->value.nobarrier_load();
+
+  // The load above must not move past this store, or the enqueue a
+  // lap later could overwrite the value before we read it.
+  slot->sequence.release_store(head + Size);
+
+  if (Backoff::kParks) not_full_.fence_and_wake_waiters();
+  return true;
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+void BoundedQueue<T, Size, Backoff>::enqueue(T *value) {
+  Backoff backoff;
+  while (!try_enqueue(value)) {
+    backoff.backoff(&not_full_, Full(this));
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+T *BoundedQueue<T, Size, Backoff>::dequeue() {
+  Backoff backoff;
+  T *value;
+  while (!try_dequeue(&value)) {
+    backoff.backoff(&not_empty_, Empty(this));
+  }
+  return value;
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+std::size_t BoundedQueue<T, Size, Backoff>::size() const {
+  Word head = head_.word.nobarrier_load();
+  Word tail = tail_.word.nobarrier_load();
+  intptr_t size = static_cast<intptr_t>(tail - head);
+  if (size < 0) return 0;
+  return size > static_cast<intptr_t>(Size) ? Size : size;
+}
+
+}
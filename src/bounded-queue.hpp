@@ -0,0 +1,121 @@
+#ifndef __EELISH_BOUNDED_QUEUE__HPP
+#define __EELISH_BOUNDED_QUEUE__HPP
+
+#include <cstring>
+
+#include "atomics.hpp"
+#include "backoff.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// A bounded multi-producer, multi-consumer FIFO queue of `T *`.
+///
+/// This is Dmitry Vyukov's array queue.  Every slot carries a
+/// sequence number that says whose turn it is:
+///
+///   sequence == position       the slot is free for the enqueue
+///                              at `position`
+///   sequence == position + 1   the slot holds the value for the
+///                              dequeue at `position`
+///
+/// where positions are the ever increasing values of tail_ (for
+/// enqueues) and head_ (for dequeues).  An enqueue claims position
+/// `p` with a single CAS on tail_, stores its value and publishes it
+/// by setting the slot's sequence to `p + 1`.  A dequeue claims `p`
+/// with a single CAS on head_, reads the value and hands the slot to
+/// the enqueue at `p + Size` by setting the sequence to `p + Size`.
+/// Producers and consumers meet only on the slots, never on the same
+/// counter, and head_ and tail_ live on cache lines of their own.
+///
+/// A slot whose sequence is behind the position we want means the
+/// queue is full (for an enqueue) or empty (for a dequeue).  The try_
+/// operations return false then; the blocking ones back off with
+/// `Backoff` (see backoff.hpp) till somebody makes room or enqueues
+/// something.  By default they sleep, like FixedVector's pop_back:
+/// a policy that parks makes every enqueue and dequeue pay for a full
+/// fence on top of its CAS, to wake the parked threads safely.
+///
+/// The queue is linearizable but not lock-free in the strict sense:
+/// an enqueue or dequeue that stops between its CAS and the sequence
+/// store holds up whoever comes around to that slot next.
+///
+/// `Size` must be a power of two.
+template<typename T, std::size_t Size, typename Backoff = SleepBackoff>
+class BoundedQueue {
+ public:
+  BoundedQueue();
+
+  /// Returns false if the queue is full.
+  bool try_enqueue(T *value);
+
+  /// Returns false if the queue is empty.
+  bool try_dequeue(T **out_value);
+
+  /// Waits for the queue to have room.
+  void enqueue(T *value);
+
+  /// Waits for the queue to have something.
+  T *dequeue();
+
+  /// Only a hint while other threads are at work.
+  std::size_t size() const;
+
+ private:
+  struct Slot {
+    Atomic<Word> sequence;
+    Atomic<T *> value;
+  };
+
+  struct PaddedWord {
+    Atomic<Word> word;
+    char padding[kCacheLineSize - sizeof(Atomic<Word>)];
+  } __attribute__((aligned(kCacheLineSize)));
+
+  /// Holds as long as the queue is full (or empty, for dequeues).
+  class Full {
+   public:
+    explicit inline Full(BoundedQueue *queue) : queue_(queue) { }
+
+    inline bool operator()() const {
+      Word tail = queue_->tail_.word.nobarrier_load();
+      Slot *slot = &queue_->slots_[tail & kIndexMask];
+      return static_cast<intptr_t>(slot->sequence.nobarrier_load() - tail) < 0;
+    }
+
+   private:
+    BoundedQueue *queue_;
+  };
+
+  class Empty {
+   public:
+    explicit inline Empty(BoundedQueue *queue) : queue_(queue) { }
+
+    inline bool operator()() const {
+      Word head = queue_->head_.word.nobarrier_load();
+      Slot *slot = &queue_->slots_[head & kIndexMask];
+      return static_cast<intptr_t>(slot->sequence.nobarrier_load() -
+                                   (head + 1)) < 0;
+    }
+
+   private:
+    BoundedQueue *queue_;
+  };
+
+  PaddedWord head_;
+  PaddedWord tail_;
+  Slot slots_[Size];
+
+  /// Producers blocked on a full queue park on not_full_, consumers
+  /// blocked on an empty one on not_empty_.
+  BackoffSite not_full_;
+  BackoffSite not_empty_;
+
+  static const std::size_t kIndexMask = Size - 1;
+};
+
+}
+
+#include "bounded-queue-inl.hpp"
+
+#endif
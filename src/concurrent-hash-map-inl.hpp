@@ -0,0 +1,83 @@
+#ifndef __EELISH_CONCURRENT_HASH_MAP__HPP
+#error "concurrent-hash-map-inl.hpp can only be included from within \
+        concurrent-hash-map.hpp"
+#endif
+
+namespace eelish {
+
+template<typename K, typename V, std::size_t Capacity, typename Hash>
+ConcurrentHashMap<K, V, Capacity, Hash>::ConcurrentHashMap() {
+  assert_static((Capacity & (Capacity - 1)) == 0);
+
+  for (std::size_t i = 0; i < Capacity; i++) {
+    entries_[i].key.raw_store(NULL);
+    entries_[i].value.raw_store(reinterpret_cast<V *>(kNoValue));
+  }
+}
+
+template<typename K, typename V, std::size_t Capacity, typename Hash>
+typename ConcurrentHashMap<K, V, Capacity, Hash>::Entry *
+ConcurrentHashMap<K, V, Capacity, Hash>::find_entry(K *key, bool claim) {
+  std::size_t index = Hash()(key) & kIndexMask;
+
+  for (std::size_t i = 0; i < Capacity; i++) {
+    Entry *entry = &entries_[index];
+    K *entry_key = entry->key.acquire_load();
+
+    if (entry_key == key) return entry;
+
+    if (entry_key == NULL) {
+      // Keys never leave their entries, so `key` can't be further
+      // along the probe sequence.
+      if (!claim) return NULL;
+
+      entry_key = entry->key.value_cas(NULL, key);
+      if (entry_key == NULL || entry_key == key) return entry;
+    }
+
+    index = (index + 1) & kIndexMask;
+  }
+
+  return NULL;
+}
+
+template<typename K, typename V, std::size_t Capacity, typename Hash>
+V *ConcurrentHashMap<K, V, Capacity, Hash>::get(K *key) {
+  Entry *entry = find_entry(key, false);
+  if (entry == NULL) return reinterpret_cast<V *>(kNotFound);
+
+  V *value = entry->value.acquire_load();
+  if (Atomic<V *>::is_primed(value)) return reinterpret_cast<V *>(kNotFound);
+  return value;
+}
+
+template<typename K, typename V, std::size_t Capacity, typename Hash>
+bool ConcurrentHashMap<K, V, Capacity, Hash>::insert(K *key, V *value) {
+  Entry *entry = find_entry(key, true);
+  if (entry == NULL) return false;
+
+  while (true) {
+    V *current = entry->value.acquire_load();
+    if (!Atomic<V *>::is_primed(current)) return false;
+    if (entry->value.boolean_cas(current, value)) return true;
+  }
+}
+
+template<typename K, typename V, std::size_t Capacity, typename Hash>
+V *ConcurrentHashMap<K, V, Capacity, Hash>::erase(K *key) {
+  Entry *entry = find_entry(key, false);
+  if (entry == NULL) return reinterpret_cast<V *>(kNotFound);
+
+  // cas_prime fails if the value is primed already, i.e. if there is
+  // no value.  It may also fail because the value changed under our
+  // feet (a racing erase and insert), in which case we try again.
+  while (true) {
+    V *value;
+    if (entry->value.cas_prime(&value)) return value;
+    if (Atomic<V *>::is_primed(entry->value.acquire_load())) {
+      return reinterpret_cast<V *>(kNotFound);
+    }
+  }
+}
+
+}
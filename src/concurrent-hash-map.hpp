@@ -0,0 +1,89 @@
+#ifndef __EELISH_CONCURRENT_HASH_MAP__HPP
+#define __EELISH_CONCURRENT_HASH_MAP__HPP
+
+#include <cstring>
+
+#include "atomics.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// Hashes a pointer by its address.
+template<typename K>
+struct PointerHash {
+  inline Word operator()(K *key) const {
+    Word hash = reinterpret_cast<Word>(key) * 0x9E3779B97F4A7C15ULL;
+    return hash ^ (hash >> 32);
+  }
+};
+
+/// A lock-free, fixed-capacity hash map from `K *` to `V *` using
+/// open addressing and linear probing.
+///
+/// Every entry holds a key word and a value word.  A key word starts
+/// out NULL and is claimed for a key with a single CAS; after that it
+/// never changes, so a probe sequence can stop at the first NULL key
+/// it runs into.  Keys are compared by address.
+///
+/// Value words use the same low bit as Atomic<T>::cas_prime.  A
+/// primed value word means "no value": a freshly claimed entry starts
+/// out primed (the insert claiming it is still in progress) and
+/// erasing a value primes it, leaving a tombstone.  This makes
+/// erase a single cas_prime, and insert a single CAS from any primed
+/// word to the new value.  A key whose value was erased keeps its
+/// entry and reuses it when it is inserted again, so the capacity
+/// bounds the number of distinct keys ever inserted rather than the
+/// number of keys present at any point of time.
+///
+/// All operations are linearizable: get and erase at the load or
+/// cas_prime of the value word, insert at the CAS that installs the
+/// value.
+///
+/// `Capacity` must be a power of two.  Keys must not be NULL and
+/// values must have their lowest bit clear and must not collide with
+/// the sentinels declared below.
+template<typename K, typename V, std::size_t Capacity,
+         typename Hash = PointerHash<K> >
+class ConcurrentHashMap {
+ public:
+  ConcurrentHashMap();
+
+  /// Returns the value for `key`, or kNotFound (check using
+  /// is_not_found) if `key` isn't in the map.
+  V *get(K *key);
+
+  /// Maps `key` to `value` if `key` isn't in the map already.
+  /// Returns false if it is, or if the map is full.
+  bool insert(K *key, V *value);
+
+  /// Removes `key` from the map.  Returns the value it was mapped to,
+  /// or kNotFound if there was none.
+  V *erase(K *key);
+
+  inline static bool is_not_found(V *value) {
+    return reinterpret_cast<Word>(value) == kNotFound;
+  }
+
+ private:
+  struct Entry {
+    Atomic<K *> key;
+    Atomic<V *> value;
+  };
+
+  /// Returns the entry for `key`, claiming a free one if `claim` is
+  /// set.  Returns NULL if there is no such entry (or, when claiming,
+  /// if the map is full).
+  inline Entry *find_entry(K *key, bool claim);
+
+  Entry entries_[Capacity];
+
+  static const Word kNoValue = 1;
+  static const Word kNotFound = ~static_cast<Word>(0);
+  static const std::size_t kIndexMask = Capacity - 1;
+};
+
+}
+
+#include "concurrent-hash-map-inl.hpp"
+
+#endif
@@ -0,0 +1,113 @@
+#ifndef __EELISH_CONTENTION_COUNTERS__HPP
+#define __EELISH_CONTENTION_COUNTERS__HPP
+
+#include "atomics.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// The things that go wrong for a FixedVector under contention.
+enum ContentionEvent {
+  /// A CAS on the length, and one that failed because another thread
+  /// changed the length first.
+  kLengthCasAttempt,
+  kLengthCasFailure,
+
+  /// A pop that found the tail slot already primed (or unwritten).
+  kPrimeFailure,
+
+  /// A pop that had to back off (see backoff.hpp) before retrying.
+  kBackoff,
+
+  /// A pop that primed the tail slot but lost the race on the length
+  /// and had to unprime it.
+  kUndonePrime,
+
+  kContentionEventCount
+};
+
+/// Totals of the ContentionEvents seen by a container.
+struct ContentionStats {
+  Word counts[kContentionEventCount];
+
+  inline ContentionStats() {
+    for (int i = 0; i < kContentionEventCount; i++) counts[i] = 0;
+  }
+
+  inline Word operator[](ContentionEvent event) const {
+    return counts[event];
+  }
+};
+
+/// The counter policies FixedVector takes as a template parameter.
+/// Both have the same interface: `count` records an event and `stats`
+/// adds up everything recorded so far.
+///
+/// NoContentionCounters, the default, counts nothing; with it
+/// inlined, instrumented code compiles to exactly what it would be
+/// without the instrumentation.
+class NoContentionCounters {
+ public:
+  static const bool kEnabled = false;
+
+  inline void count(ContentionEvent) { }
+  inline ContentionStats stats() const { return ContentionStats(); }
+};
+
+/// Counts events in per-thread counters, each on its own cache line so
+/// that counting doesn't add contention of its own.  A thread gets its
+/// slot from a global thread number, so counts are exact as long as
+/// no more than kSlots threads use a container at once; past that,
+/// threads share slots and a few counts may get lost.
+class ContentionCounters {
+ public:
+  static const bool kEnabled = true;
+
+  inline ContentionCounters() {
+    for (int i = 0; i < kSlots; i++) {
+      for (int j = 0; j < kContentionEventCount; j++) {
+        slots_[i].counts[j].raw_store(0);
+      }
+    }
+  }
+
+  inline void count(ContentionEvent event) {
+    // Only this thread writes to its slot, so there is no need for an
+    // atomic add; `stats` may read a slightly stale count.
+    Atomic<Word> *counter = &slots_[ThreadSlot()].counts[event];
+    counter->nobarrier_store(counter->nobarrier_load() + 1);
+  }
+
+  inline ContentionStats stats() const {
+    ContentionStats stats;
+    for (int i = 0; i < kSlots; i++) {
+      for (int j = 0; j < kContentionEventCount; j++) {
+        stats.counts[j] += slots_[i].counts[j].nobarrier_load();
+      }
+    }
+    return stats;
+  }
+
+  static const int kSlots = 128;
+
+ private:
+  static inline int ThreadSlot() {
+    static Atomic<Word> next_thread_number;
+    static __thread Word thread_number = ~static_cast<Word>(0);
+
+    if (unlikely(thread_number == ~static_cast<Word>(0))) {
+      thread_number = next_thread_number.fetch_add(1);
+    }
+    return static_cast<int>(thread_number % kSlots);
+  }
+
+  struct Slot {
+    Atomic<Word> counts[kContentionEventCount];
+  } __attribute__((aligned(kCacheLineSize)));
+
+  Slot slots_[kSlots];
+};
+
+}
+
+#endif
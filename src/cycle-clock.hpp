@@ -0,0 +1,65 @@
+#ifndef __EELISH_CYCLE_CLOCK__HPP
+#define __EELISH_CYCLE_CLOCK__HPP
+
+#include <stdint.h>
+
+#include "platform.hpp"
+
+namespace eelish {
+
+/// A timestamp cheap enough to take around a single push or pop.
+///
+/// On x86 this is the time stamp counter, which on any CPU from the
+/// last decade ticks at a constant rate whatever the core's frequency
+/// and is in sync across cores.  Elsewhere it falls back to
+/// CLOCK_MONOTONIC_RAW, counting nanoseconds.
+///
+/// rdtsc doesn't wait for earlier instructions to finish, so an
+/// interval can be off by the few dozen cycles of the pipeline.  That
+/// is fine for the tail latencies we're after.
+class CycleClock {
+ public:
+  static inline uint64_t Now() {
+#if defined(__i386__) || defined(__x86_64__)
+    uint32_t low, high;
+    __asm__ __volatile__("rdtsc" : "=a"(low), "=d"(high));
+    return (static_cast<uint64_t>(high) << 32) | low;
+#else
+    return static_cast<uint64_t>(Platform::CurrentTimeInNSec());
+#endif
+  }
+
+  /// The length of a tick.  Measured against CLOCK_MONOTONIC_RAW the
+  /// first time it is needed, which takes kCalibrationNSec.
+  static inline double NanosecondsPerTick() {
+    static double nanoseconds_per_tick = Calibrate();
+    return nanoseconds_per_tick;
+  }
+
+  static inline double ToNanoseconds(uint64_t ticks) {
+    return ticks * NanosecondsPerTick();
+  }
+
+ private:
+  static inline double Calibrate() {
+#if defined(__i386__) || defined(__x86_64__)
+    long begin_time = Platform::CurrentTimeInNSec();
+    uint64_t begin_ticks = Now();
+    long end_time;
+    do {
+      end_time = Platform::CurrentTimeInNSec();
+    } while (end_time - begin_time < kCalibrationNSec);
+    uint64_t end_ticks = Now();
+    return static_cast<double>(end_time - begin_time) /
+        (end_ticks - begin_ticks);
+#else
+    return 1.0;
+#endif
+  }
+
+  static const long kCalibrationNSec = 10 * 1000 * 1000;
+};
+
+}
+
+#endif
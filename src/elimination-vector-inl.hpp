@@ -0,0 +1,85 @@
+#ifndef __EELISH_ELIMINATION_VECTOR__HPP
+#error "elimination-vector-inl.hpp can only be included from within \
+        elimination-vector.hpp"
+#endif
+
+namespace eelish {
+
+template<typename T, std::size_t Size, typename Backoff>
+EliminationFixedVector<T, Size, Backoff>::EliminationFixedVector() {
+  for (std::size_t i = 0; i < kSlotCount; i++) {
+    slots_[i].word.raw_store(kFree);
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+std::size_t EliminationFixedVector<T, Size, Backoff>::push_back(T *value) {
+  // Seeding off a stack address gives every thread its own sequence.
+  XorShiftRandom random(reinterpret_cast<Word>(&value));
+
+  for (int i = 0; i < kEliminationRounds; i++) {
+    std::size_t index;
+    if (vector_.try_push_back(value, &index)) return index;
+    if (eliminate_push(value, &random)) return vector_.length();
+  }
+
+  return vector_.push_back(value);
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+T *EliminationFixedVector<T, Size, Backoff>::pop_back(std::size_t *out_index) {
+  XorShiftRandom random(reinterpret_cast<Word>(&out_index));
+
+  for (int i = 0; i < kEliminationRounds; i++) {
+    T *value;
+    if (vector_.try_pop_back(&value, out_index)) return value;
+    if (eliminate_pop(&value, &random)) {
+      if (out_index != NULL) *out_index = vector_.length();
+      return value;
+    }
+  }
+
+  return vector_.pop_back(out_index);
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+bool EliminationFixedVector<T, Size, Backoff>::eliminate_push(
+    T *value, XorShiftRandom *random) {
+  Atomic<Word> *slot = &slots_[(random->next() >> 32) % kSlotCount].word;
+  Word offer = reinterpret_cast<Word>(value) | kOffered;
+
+  if (!slot->boolean_cas(kFree, offer)) return false;
+
+  for (int i = 0; i < kOfferSpins; i++) {
+    if (slot->acquire_load() == kTaken) {
+      slot->release_store(kFree);
+      return true;
+    }
+    cpu_relax();
+  }
+
+  // Nobody showed up, withdraw the offer.  If that fails, a pop took
+  // the value just now.
+  if (slot->boolean_cas(offer, kFree)) return false;
+
+  slot->release_store(kFree);
+  return true;
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+bool EliminationFixedVector<T, Size, Backoff>::eliminate_pop(
+    T **out_value, XorShiftRandom *random) {
+  Atomic<Word> *slot = &slots_[(random->next() >> 32) % kSlotCount].word;
+
+  Word offer = slot->acquire_load();
+  if ((offer & kTagMask) != kOffered) return false;
+
+  // If the CAS succeeds the slot held an offer of this exact value,
+  // even if it was withdrawn and made again in the meantime.
+  if (!slot->boolean_cas(offer, kTaken)) return false;
+
+  *out_value = reinterpret_cast<T *>(offer & ~kTagMask);
+  return true;
+}
+
+}
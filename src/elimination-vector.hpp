@@ -0,0 +1,98 @@
+#ifndef __EELISH_ELIMINATION_VECTOR__HPP
+#define __EELISH_ELIMINATION_VECTOR__HPP
+
+#include "fixed-vector.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// A FixedVector with an elimination array in front of it.
+///
+/// A push and a pop running concurrently may cancel each other out:
+/// the pop returns the value the push was about to push, and neither
+/// touches the vector.  Such a pair is explained by the linearization
+/// in which the push is immediately followed by the pop, so the
+/// consistency guarantee documented in fixed-vector.hpp still holds.
+///
+/// Pairs like that are the most likely exactly when length_ is
+/// contended, so pushes and pops first try the vector once and only
+/// go to the elimination array after losing a race there.  A push
+/// waits in a random slot of the array for a little while; a pop
+/// peeks into a random slot and takes the value offered there, if
+/// any.  If nothing comes of it after a few rounds, they fall back to
+/// the plain (blocking) FixedVector operations.
+///
+/// Eliminated operations report the vector's length at the time as
+/// the index of the value.
+template<typename T, std::size_t Size, typename Backoff = SleepBackoff>
+class EliminationFixedVector {
+ public:
+  EliminationFixedVector();
+
+  std::size_t push_back(T *value);
+  T *pop_back(std::size_t *out_index);
+
+  /// Batched operations aren't eliminated, they go to the vector.
+  inline std::size_t push_back_n(T **values, std::size_t n) {
+    return vector_.push_back_n(values, n);
+  }
+
+  inline std::size_t pop_back_n(T **out, std::size_t max) {
+    return vector_.pop_back_n(out, max);
+  }
+
+  inline T *get(std::size_t index) { return vector_.get(index); }
+
+  /// See FixedVector.  Eliminated pops retire their values too.
+  inline T *get(std::size_t index, const EpochGuard &) {
+    return vector_.get(index);
+  }
+
+  inline T *retire_pop_back(std::size_t *out_index, const EpochGuard &) {
+    T *value = pop_back(out_index);
+    if (!is_out_of_range(value)) Epoch::Retire(value);
+    return value;
+  }
+  inline std::size_t length() const { return vector_.length(); }
+
+  inline static bool is_inconsistent(T *value) {
+    return FixedVector<T, Size, Backoff>::is_inconsistent(value);
+  }
+
+  inline static bool is_out_of_range(T *value) {
+    return FixedVector<T, Size, Backoff>::is_out_of_range(value);
+  }
+
+ private:
+  bool eliminate_push(T *value, XorShiftRandom *random);
+  bool eliminate_pop(T **out_value, XorShiftRandom *random);
+
+  static const std::size_t kSlotCount = 8;
+  static const int kEliminationRounds = 4;
+  static const int kOfferSpins = 64;
+
+  /// An exchange slot is either free, holds a value offered by a push
+  /// (tagged with kOffered) or has just been taken by a pop.  The
+  /// sentinels have both low bits set, so they can't be confused with
+  /// an offer.
+  static const Word kFree = ~static_cast<Word>(0);
+  static const Word kTaken = ~static_cast<Word>(4);
+  static const Word kOffered = 2;
+  static const Word kTagMask = 3;
+
+  /// Slots live on cache lines of their own, we don't want pairs
+  /// using different slots to fight over lines.
+  struct ExchangeSlot {
+    Atomic<Word> word;
+    char padding[kCacheLineSize - sizeof(Atomic<Word>)];
+  } __attribute__((aligned(kCacheLineSize)));
+
+  FixedVector<T, Size, Backoff> vector_;
+  ExchangeSlot slots_[kSlotCount];
+};
+
+}
+
+#include "elimination-vector-inl.hpp"
+
+#endif
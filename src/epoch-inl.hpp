@@ -0,0 +1,135 @@
+#ifndef __EELISH_EPOCH__HPP
+#error "epoch-inl.hpp can only be included from within epoch.hpp"
+#endif
+
+namespace eelish {
+
+Epoch::Globals *Epoch::GetGlobals() {
+  static Globals globals;
+  return &globals;
+}
+
+Epoch::Record *Epoch::ThisThreadRecord() {
+  static __thread Record *record = NULL;
+  if (unlikely(record == NULL)) record = ClaimRecord();
+  return record;
+}
+
+Epoch::Record *Epoch::ClaimRecord() {
+  Globals *globals = GetGlobals();
+
+  // Reuse the record of a thread that has exited, if there is one.
+  Record *record;
+  for (record = globals->records.acquire_load(); record != NULL;
+       record = record->next) {
+    if (record->in_use.nobarrier_load() == 0 &&
+        record->in_use.boolean_cas(0, 1)) {
+      break;
+    }
+  }
+
+  if (record == NULL) {
+    record = new Record;
+    record->state.raw_store(0);
+    record->in_use.raw_store(1);
+    record->nesting = 0;
+    record->retired_since_collect = 0;
+    for (int i = 0; i < 3; i++) record->limbo[i].epoch = 0;
+
+    Record *head;
+    do {
+      head = globals->records.nobarrier_load();
+      record->next = head;
+    } while (!globals->records.boolean_cas(head, record));
+  }
+
+  globals->key.set(record);
+  return record;
+}
+
+inline void Epoch::ReleaseRecord(void *record) {
+  static_cast<Record *>(record)->in_use.release_store(0);
+}
+
+void Epoch::Enter() {
+  Record *record = ThisThreadRecord();
+  if (record->nesting++ != 0) return;
+
+  Word epoch = GetGlobals()->epoch.acquire_load();
+  record->state.nobarrier_store((epoch << 1) | kActive);
+
+  // Whoever advances the epoch must see us before we read anything
+  // out of a container.
+  full_memory_fence();
+}
+
+void Epoch::Exit() {
+  Record *record = ThisThreadRecord();
+  if (--record->nesting != 0) return;
+
+  // Everything we read must be done with before we let the epoch go.
+  record->state.release_store(record->state.nobarrier_load() & ~kActive);
+}
+
+void Epoch::Retire(void *value, void (*deleter)(void *)) {
+  Record *record = ThisThreadRecord();
+  Globals *globals = GetGlobals();
+
+  // The global epoch, not our own: a reader may have seen `value`
+  // from an epoch ahead of ours (the caller unlinked `value` before
+  // calling us, so no reader can have seen it from a later one).
+  Word epoch = globals->epoch.acquire_load();
+
+  Limbo *limbo = &record->limbo[epoch % 3];
+  if (limbo->epoch != epoch) {
+    // The list last held values from three or more epochs ago, the
+    // global epoch has moved on at least two steps since.
+    FreeLimbo(limbo);
+    limbo->epoch = epoch;
+  }
+
+  Retired retired = { value, deleter };
+  limbo->values.push_back(retired);
+
+  if (++record->retired_since_collect >= kRetireBatch) {
+    record->retired_since_collect = 0;
+    TryAdvance();
+    Collect(record, globals->epoch.acquire_load());
+  }
+}
+
+void Epoch::TryAdvance() {
+  Globals *globals = GetGlobals();
+  Word epoch = globals->epoch.acquire_load();
+
+  for (Record *record = globals->records.acquire_load(); record != NULL;
+       record = record->next) {
+    Word state = record->state.acquire_load();
+    if ((state & kActive) != 0 && (state >> 1) != epoch) return;
+  }
+
+  globals->epoch.boolean_cas(epoch, epoch + 1);
+}
+
+void Epoch::Collect(Record *record, Word epoch) {
+  for (int i = 0; i < 3; i++) {
+    Limbo *limbo = &record->limbo[i];
+    if (limbo->epoch + 2 <= epoch) FreeLimbo(limbo);
+  }
+}
+
+void Epoch::FreeLimbo(Limbo *limbo) {
+  for (std::size_t i = 0; i < limbo->values.size(); i++) {
+    limbo->values[i].deleter(limbo->values[i].value);
+  }
+  limbo->values.clear();
+}
+
+void Epoch::CollectAll() {
+  for (Record *record = GetGlobals()->records.acquire_load(); record != NULL;
+       record = record->next) {
+    for (int i = 0; i < 3; i++) FreeLimbo(&record->limbo[i]);
+  }
+}
+
+}
@@ -0,0 +1,138 @@
+#ifndef __EELISH_EPOCH__HPP
+#define __EELISH_EPOCH__HPP
+
+#include <vector>
+
+#include "atomics.hpp"
+#include "platform.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// Epoch based reclamation, for freeing values popped off a container
+/// while other threads may still be looking at them.
+///
+/// A thread reads values out of a container only while it holds an
+/// EpochGuard.  A thread that takes a value out of a container, and
+/// so would like to free it, hands it to Epoch::Retire instead.
+/// Retired values are freed once every thread that could have read
+/// them has dropped its guard.
+///
+/// This is Fraser's scheme.  There is a global epoch, and a guard
+/// records the epoch it was created in.  The global epoch moves from
+/// `e` to `e + 1` only once every thread holding a guard has seen
+/// `e`, so a value retired in epoch `e` can't be reachable by anyone
+/// once the global epoch has reached `e + 2`.  Each thread keeps its
+/// retired values in three lists, one per epoch that can still be
+/// pending, and every kRetireBatch retires tries to advance the
+/// global epoch and frees the lists that have become safe.  Retiring
+/// is then usually just a push onto a thread local std::vector.
+///
+/// A thread stuck inside a guard keeps the epoch from moving, and so
+/// keeps everybody's retired values around.  Guards are meant to be
+/// short lived.
+///
+/// The per-thread state lives in a record that a thread claims the
+/// first time it uses epochs.  Records are never freed: a thread that
+/// exits gives its record (retired values and all) back, and the next
+/// new thread picks it up.
+class Epoch {
+ public:
+  /// Frees `value` with `delete` once no guard that could have seen
+  /// it is left.  `value` must already be unreachable for threads
+  /// that start reading after this call.
+  template<typename T>
+  static inline void Retire(T *value) {
+    Retire(value, &DeleteObject<T>);
+  }
+
+  static inline void Retire(void *value, void (*deleter)(void *));
+
+  /// Frees everything retired so far, whatever the epoch.  Only safe
+  /// when no thread is holding a guard or retiring, e.g. between
+  /// test runs.
+  static inline void CollectAll();
+
+  static const Word kRetireBatch = 64;
+
+ private:
+  struct Retired {
+    void *value;
+    void (*deleter)(void *);
+  };
+
+  /// Values retired in `epoch`.
+  struct Limbo {
+    Word epoch;
+    std::vector<Retired> values;
+  };
+
+  struct Record {
+    /// The epoch this thread is in, shifted left by one, with the low
+    /// bit set while it holds a guard.
+    Atomic<Word> state;
+    Atomic<Word> in_use;
+    Record *next;
+
+    /// Only touched by the owning thread.
+    int nesting;
+    Word retired_since_collect;
+    Limbo limbo[3];
+  };
+
+  struct Globals {
+    Atomic<Word> epoch;
+    Atomic<Record *> records;
+    ThreadLocalKey key;
+
+    inline Globals() : key(&ReleaseRecord) {
+      epoch.raw_store(0);
+      records.raw_store(NULL);
+    }
+  };
+
+  static inline Globals *GetGlobals();
+  static inline Record *ThisThreadRecord();
+  static inline Record *ClaimRecord();
+  static void ReleaseRecord(void *record);
+
+  static inline void Enter();
+  static inline void Exit();
+
+  /// Moves the global epoch on if every thread holding a guard has
+  /// caught up with it.
+  static inline void TryAdvance();
+
+  /// Frees the values in `record` retired two or more epochs before
+  /// `epoch`.
+  static inline void Collect(Record *record, Word epoch);
+  static inline void FreeLimbo(Limbo *limbo);
+
+  template<typename T>
+  static void DeleteObject(void *value) {
+    delete static_cast<T *>(value);
+  }
+
+  static const Word kActive = 1;
+
+  friend class EpochGuard;
+};
+
+
+/// Keeps values read out of containers alive for as long as it
+/// lives.  Guards nest.
+class EpochGuard {
+ public:
+  inline EpochGuard() { Epoch::Enter(); }
+  inline ~EpochGuard() { Epoch::Exit(); }
+
+ private:
+  EpochGuard(const EpochGuard &);
+  EpochGuard &operator=(const EpochGuard &);
+};
+
+}
+
+#include "epoch-inl.hpp"
+
+#endif
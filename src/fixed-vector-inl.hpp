@@ -2,7 +2,9 @@
 #error "fixed-vector-inl.hpp can only be included from within fixed-vector.hpp"
 #endif
 
+#include <algorithm>
 #include <cassert>
+#include <new>
 
 #include "utils.hpp"
 
@@ -11,94 +13,346 @@ namespace eelish {
 // TODO: *IMPORTANT* comment discussing the rationale why FixedVector
 // obeys the consistency principles mentioned in fixed-vector.hpp
 
+// The memory orders used below come in pairs:
+//
+//  * A push stores its value with release semantics and anyone who
+//    reads a slot (a pop priming it, a get) does so with acquire
+//    semantics, so whatever the value points to is visible to them.
+//
+//  * A pop lowers length_ with release semantics and a push bumps it
+//    with acquire semantics.  A push that reuses a slot a pop just
+//    gave up then stores to it strictly after the pop is done reading
+//    it.
+//
+// Nothing else is ordered: in particular length_ is read without
+// barriers everywhere, the CASes on it catch a stale read.
+
 // TODO: add a set_at function to FixedVector.  I don't think doing so
 // should be overly difficult (as long as we are careful not to step
 // on a value that is being popped currently), the harder part is
 // coming up with a bunch of convincing test cases.
 
-template<typename T, std::size_t Size>
-FixedVector<T, Size>::FixedVector() {
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::FixedVector(
+    std::size_t capacity, const Allocator &allocator) :
+    capacity_(capacity),
+    allocator_(allocator) {
+  assert(capacity != 0);
+  assert(Size == kRuntimeCapacity || capacity == Size);
   length_.raw_store(0);
-  for (std::size_t i = 0; i < Size; i++) {
-    buffer_[i].raw_store(reinterpret_cast<T *>(kInconsistent));
+
+  // The allocator hands out zeros, which is every slot kInconsistent
+  // already.
+  buffer_ = reinterpret_cast<Atomic<T *> *>(
+      allocator_.allocate(capacity * sizeof(Atomic<T *>)));
+  if (buffer_ == NULL) throw std::bad_alloc();
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::~FixedVector() {
+  allocator_.deallocate(buffer_, capacity() * sizeof(Atomic<T *>));
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+std::size_t
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::push_back(
+    T *value) {
+  while (true) {
+    std::size_t index;
+    if (attempt_push(value, &index) == kDone) return index;
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+bool FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::try_push_back(
+    T *value, std::size_t *out_index) {
+  return attempt_push(value, out_index) == kDone;
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+typename FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::Attempt
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::attempt_push(
+    T *value, std::size_t *out_index) {
+  Word index = length_.nobarrier_load();
+  if (index >= capacity()) {
+    *out_index = -1;
+    return kDone;
+  }
+
+  // We "make space" for the element we are going to insert by
+  // incrementing the index.  We use a compare exchange here so that
+  // we never bump the index out of bounds; see fetch_add_push_back
+  // for a version that uses an atomic add instead.
+  //
+  // The acquire keeps the store to the buffer from being reordered
+  // ahead of the increment, where it could land on a value a pop is
+  // still busy with.
+  if (!cas_length(index, index + 1, kAcquire)) return kRaced;
+
+  slot(index)->store(encode(value), kRelease);
+
+  // A pop_back may be parked on this slot.  The store is a plain
+  // one, so fence before looking for waiters, or a pop_back parking
+  // right as we store could miss both the value and the wake-up.
+  if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+  *out_index = static_cast<std::size_t>(index);
+  return kDone;
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+std::size_t
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::fetch_add_push_back(
+    T *value) {
+  Word index = length_.fetch_add(1, kAcquire);
+
+  if (unlikely(index >= capacity())) {
+    // The vector is full and we've pushed length_ past capacity.  Till it
+    // is back within bounds pops wait, CAS based pushes fail and other
+    // fetch_add_push_backs roll back just like us; so all we need to
+    // do is undo our increment.
+    length_.fetch_add(-1, kRelaxed);
+    if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+    return -1;
   }
+
+  slot(index)->store(encode(value), kRelease);
+
+  if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+  return static_cast<std::size_t>(index);
 }
 
-template<typename T, std::size_t Size>
-std::size_t FixedVector<T, Size>::push_back(T *value) {
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+T *FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::pop_back(
+    std::size_t *out_index) {
+  Backoff backoff;
   while (true) {
-    Word index = length_.nobarrier_load();
-    if (index >= Size) return -1;
-
-    // We "make space" for the element we are going to insert by
-    // incrementing the index.  We can't use an atomic add here since
-    // we need to ensure we don't bump the index out of bounds and
-    // make the container inconsistent.  There may be some clever way
-    // around that, though; might be worth thinking about if atomic
-    // adds are faster than atomic compare exchanges.
-    if (!length_.boolean_cas(index, index + 1)) continue;
-
-    // We can't let the actual store to the buffer be reordered ahead
-    // of the length_ increment -- another thread might end up writing
-    // to the same location.
-    memory_fence();
-    buffer_[index].nobarrier_store(value);
-    return static_cast<std::size_t>(index);
+    T *value;
+    Word length;
+    switch (attempt_pop(&value, &length)) {
+      case kDone:
+        if (out_index != NULL && length != 0) *out_index = length - 1;
+        return value;
+      case kBlocked:
+        counters_.count(kBackoff);
+        backoff.backoff(&backoff_site_, PopBlocked(this, length));
+        break;
+      case kRaced:
+        break;
+    }
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+bool FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::try_pop_back(
+    T **out_value, std::size_t *out_index) {
+  Word length;
+  if (attempt_pop(out_value, &length) != kDone) return false;
+  if (out_index != NULL && length != 0) *out_index = length - 1;
+  return true;
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+typename FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::Attempt
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::attempt_pop(
+    T **out_value, Word *out_length) {
+  Word length = length_.nobarrier_load();
+  *out_length = length;
+  if (length == 0) {
+    *out_value = reinterpret_cast<T *>(kOutOfRange);
+    return kDone;
+  }
+
+  // A fetch_add_push_back into a full vector is about to roll length_
+  // back.
+  if (unlikely(length > capacity())) return kBlocked;
+
+  Word index = length - 1;
+  T *value;
+
+  // pop_back "primes" the value it is about to pop by setting a
+  // bit.  It is illegal to pop "past" a primed element.
+  if (unlikely(!prime_slot(index, &value))) {
+    counters_.count(kPrimeFailure);
+    return kBlocked;
+  }
+
+  // The release keeps the priming from being reordered to after the
+  // length_ change -- we might end up reading a value pushed after
+  // our pop.
+  if (unlikely(!cas_length(length, length - 1, kRelease))) {
+    // Something's changed, undo priming and retry.
+    counters_.count(kUndonePrime);
+    slot(index)->store(value, kRelease);
+    if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+    return kRaced;
   }
+
+  if (Backoff::kParks) backoff_site_.wake_waiters();
+  *out_value = decode(value);
+  return kDone;
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+bool FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::prime_slot(
+    Word index, T **out_slot) {
+  Atomic<T *> *location = slot(index);
+  T *contents = location->nobarrier_load();
+  if (!is_poppable(contents)) return false;
+
+  T *primed =
+      reinterpret_cast<T *>(reinterpret_cast<intptr_t>(contents) | 1);
+  if (!location->boolean_cas(contents, primed, kAcquire)) return false;
+  *out_slot = contents;
+  return true;
 }
 
-template<typename T, std::size_t Size>
-T *FixedVector<T, Size>::pop_back(std::size_t *out_index) {
-  int kRetryDelay = 1;
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+std::size_t
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::push_back_n(
+    T **values, std::size_t n) {
+  if (n == 0) return 0;
+
   while (true) {
-    Word length = length_.nobarrier_load();
-    if (length == 0) return reinterpret_cast<T *>(kOutOfRange);
+    Word index = length_.nobarrier_load();
+    if (index >= capacity()) return 0;
 
-    Word index = length - 1;
-    T *value;
+    Word count = std::min(static_cast<Word>(n), capacity() - index);
+    if (!cas_length(index, index + count, kAcquire)) continue;
 
-    // pop_back "primes" the value it is about to pop by setting a
-    // bit.  It is illegal to pop "past" a primed element.
-    if (unlikely(!buffer_[index].cas_prime(&value))) {
-      Platform::Sleep(kRetryDelay);
-      continue;
+    for (Word i = 0; i < count; i++) {
+      slot(index + i)->store(encode(values[i]), kRelease);
     }
 
-    // We can't let this load be reordered to after the modifying the
-    // length -- we might end up reading a completely different value.
-    memory_fence();
+    if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+    return static_cast<std::size_t>(count);
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+std::size_t
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::pop_back_n(
+    T **out, std::size_t max) {
+  if (max == 0) return 0;
 
-    if (unlikely(!length_.boolean_cas(length, length - 1))) {
-      // Something's changed, undo priming and retry.
-      buffer_[index].nobarrier_store(value);
-      continue;
+  Backoff backoff;
+  while (true) {
+    Word count;
+    Word length;
+    switch (attempt_pop_n(out, max, &count, &length)) {
+      case kDone:
+        return static_cast<std::size_t>(count);
+      case kBlocked:
+        counters_.count(kBackoff);
+        backoff.backoff(&backoff_site_, PopBlocked(this, length));
+        break;
+      case kRaced:
+        break;
     }
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+std::size_t
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::try_pop_back_n(
+    T **out, std::size_t max) {
+  if (max == 0) return 0;
+
+  Word count;
+  Word length;
+  if (attempt_pop_n(out, max, &count, &length) != kDone) return 0;
+  return static_cast<std::size_t>(count);
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+typename FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::Attempt
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::attempt_pop_n(
+    T **out, Word max, Word *out_count, Word *out_length) {
+  Word length = length_.nobarrier_load();
+  *out_length = length;
+  *out_count = 0;
+  if (length == 0) return kDone;
+
+  if (unlikely(length > capacity())) return kBlocked;
+
+  // Prime the slots from the tail downwards, exactly like a run of
+  // pop_backs would.  We stop at the first slot we can't prime;
+  // popping past it would pop past an ongoing pop (or push).  The
+  // slots above it are ours to pop.
+  Word count = std::min(max, length);
+  Word primed = 0;
+  while (primed < count &&
+         prime_slot(length - 1 - primed, &out[primed])) {
+    primed++;
+  }
+  if (primed < count) counters_.count(kPrimeFailure);
+
+  if (unlikely(primed == 0)) return kBlocked;
 
-    if (out_index != NULL) *out_index = index;
-    return value;
+  if (unlikely(!cas_length(length, length - primed, kRelease))) {
+    counters_.count(kUndonePrime);
+    for (Word i = 0; i < primed; i++) {
+      slot(length - 1 - i)->store(out[i], kRelease);
+    }
+    if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+    return kRaced;
   }
+
+  if (Backoff::kParks) backoff_site_.wake_waiters();
+  for (Word i = 0; i < primed; i++) out[i] = decode(out[i]);
+  *out_count = primed;
+  return kDone;
 }
 
-template<typename T, std::size_t Size>
-T *FixedVector<T, Size>::get(std::size_t index) {
-  assert(index < Size);
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+T *FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::retire_pop_back(
+    std::size_t *out_index, const EpochGuard &) {
+  T *value = pop_back(out_index);
+  if (!is_out_of_range(value)) Epoch::Retire(value);
+  return value;
+}
+
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+T *FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::get(
+    std::size_t index) {
+  assert(index < capacity());
   Word length = length_.nobarrier_load();
   T *out_of_range = reinterpret_cast<T *>(kOutOfRange);
 
   if (index >= length) return out_of_range;
 
-  T *value = buffer_[index].nobarrier_load_unprimed();
-
-  if (is_inconsistent(value)) {
-    return out_of_range;
-  } else {
-    return value;
-  }
+  // A popped slot stays primed, holding the value popped, till a push
+  // stores to it again; and a push bumps length_ before it stores.  So
+  // a primed slot below length_ may hold a value that has long been
+  // popped (and freed, see retire_pop_back).  Only a slot nobody has
+  // started popping holds a live value.
+  T *contents = slot(index)->acquire_load();
+  if (!is_poppable(contents)) return out_of_range;
+  return decode(contents);
 }
 
-template<typename T, std::size_t Size>
-std::size_t FixedVector<T, Size>::length() const {
-  return length_.nobarrier_load();
+template<typename T, std::size_t Size, typename Backoff,
+         typename Counters, typename Allocator, typename Layout>
+std::size_t
+FixedVector<T, Size, Backoff, Counters, Allocator, Layout>::length() const {
+  // length_ can be momentarily out of bounds due to a
+  // fetch_add_push_back on a full vector.
+  return std::min(length_.nobarrier_load(), static_cast<Word>(capacity()));
 }
 
 }
@@ -0,0 +1,277 @@
+#ifndef __EELISH_FIXED_VECTOR_VARIANTS__HPP
+#define __EELISH_FIXED_VECTOR_VARIANTS__HPP
+
+// The vectors test-fixed-vector and bench-fixed-vector run on, besides
+// FixedVector itself.
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <string>
+
+#include "backoff.hpp"
+#include "elimination-vector.hpp"
+#include "epoch.hpp"
+#include "fixed-vector.hpp"
+#include "locks.hpp"
+#include "sharded-stack.hpp"
+
+namespace eelish {
+
+// We will compare the performance of FixedVector with a naive locked
+// implementation.  `Lock` is Mutex or one of the locks in locks.hpp.
+
+template<typename T, size_t Size, typename Lock = Mutex>
+class NaiveFixedVector {
+ public:
+  NaiveFixedVector() : length_(0) { }
+
+  size_t push_back(T *value) {
+    MutexLocker<Lock> lock(&mutex_);
+    if (length_ == Size) return -1;
+    buffer_[length_] = value;
+    return length_++;
+  }
+
+  T *pop_back(size_t *out_index) {
+    MutexLocker<Lock> lock(&mutex_);
+    assert(length_ > 0);
+    T *value = buffer_[--length_];
+    if (out_index != NULL) *out_index = length_;
+    return value;
+  }
+
+  size_t push_back_n(T **values, size_t n) {
+    MutexLocker<Lock> lock(&mutex_);
+    size_t count = std::min(n, Size - length_);
+    std::copy(values, values + count, buffer_ + length_);
+    length_ += count;
+    return count;
+  }
+
+  size_t pop_back_n(T **out, size_t max) {
+    MutexLocker<Lock> lock(&mutex_);
+    size_t count = std::min(max, length_);
+    for (size_t i = 0; i < count; i++) {
+      out[i] = buffer_[--length_];
+    }
+    return count;
+  }
+
+  T *get(size_t index) {
+    MutexLocker<Lock> lock(&mutex_);
+    if (index < length_) {
+      return buffer_[index];
+    } else {
+      return reinterpret_cast<T *>(kOutOfRange);
+    }
+  }
+
+  T *get(size_t index, const EpochGuard &) { return get(index); }
+
+  T *retire_pop_back(size_t *out_index, const EpochGuard &) {
+    T *value = pop_back(out_index);
+    Epoch::Retire(value);
+    return value;
+  }
+
+  size_t length() const { return length_; }
+
+  inline static bool is_consistent(T *) { return true; }
+  inline static bool is_out_of_range(T *value) {
+    return (reinterpret_cast<intptr_t>(value) & (~kBitMask)) ==
+        (kOutOfRange & (~kBitMask));
+  }
+
+ private:
+  size_t length_;
+  T *buffer_[Size];
+  Lock mutex_;
+
+  static const intptr_t kOutOfRange = -2;
+  static const intptr_t kBitMask = 3;
+};
+
+// NaiveFixedVector with a specific lock, so that we compare against
+// well built locks and not just pthread_mutex_t.
+
+template<typename Lock>
+struct LockedFixedVector {
+  template<typename T, size_t Size>
+  class Type : public NaiveFixedVector<T, Size, Lock> { };
+};
+
+// FixedVector with a specific backoff policy, so that we can see how
+// the policies compare.
+
+template<typename Backoff>
+struct BackoffFixedVector {
+  template<typename T, size_t Size>
+  class Type : public FixedVector<T, Size, Backoff> { };
+};
+
+// FixedVector pushing with fetch_add_push_back.
+
+template<typename T, size_t Size>
+class FetchAddFixedVector : public FixedVector<T, Size> {
+ public:
+  size_t push_back(T *value) { return this->fetch_add_push_back(value); }
+};
+
+// FixedVector counting contention events.
+
+template<typename T, size_t Size>
+class CountedFixedVector :
+      public FixedVector<T, Size, SleepBackoff, ContentionCounters> { };
+
+// FixedVector with its capacity given at runtime, and its slots on
+// transparent huge pages.
+
+template<typename T, size_t Size>
+class HugePageFixedVector : public FixedVector<T, kRuntimeCapacity> {
+ public:
+  HugePageFixedVector() :
+      FixedVector<T, kRuntimeCapacity>(
+          Size, PageAllocator(PageAllocator::kTransparentHugePages)) { }
+};
+
+// FixedVector with the length on a line of its own, and with its slots
+// scattered over lines as well, to compare with the default packed
+// layout.
+
+template<typename T, size_t Size>
+class PaddedFixedVector :
+      public FixedVector<T, Size, SleepBackoff, NoContentionCounters,
+                         PageAllocator, PaddedLayout> { };
+
+template<typename T, size_t Size>
+class ScatteredFixedVector :
+      public FixedVector<T, Size, SleepBackoff, NoContentionCounters,
+                         PageAllocator, ScatteredLayout> { };
+
+
+template<template<typename T, size_t S> class Vec>
+struct VectorNamePrefix;
+
+template<>
+struct VectorNamePrefix<FixedVector> {
+  static std::string prefix() { return "fixed-vector-"; }
+};
+
+template<>
+struct VectorNamePrefix<NaiveFixedVector> {
+  static std::string prefix() { return "naive-vector-"; }
+};
+
+template<>
+struct VectorNamePrefix<LockedFixedVector<FutexMutex>::Type> {
+  static std::string prefix() { return "naive-vector-futex-"; }
+};
+
+template<>
+struct VectorNamePrefix<LockedFixedVector<TicketLock>::Type> {
+  static std::string prefix() { return "naive-vector-ticket-"; }
+};
+
+template<>
+struct VectorNamePrefix<LockedFixedVector<McsLock>::Type> {
+  static std::string prefix() { return "naive-vector-mcs-"; }
+};
+
+template<>
+struct VectorNamePrefix<LockedFixedVector<ClhLock>::Type> {
+  static std::string prefix() { return "naive-vector-clh-"; }
+};
+
+template<>
+struct VectorNamePrefix<EliminationFixedVector> {
+  static std::string prefix() { return "elimination-vector-"; }
+};
+
+template<>
+struct VectorNamePrefix<ShardedStack> {
+  static std::string prefix() { return "sharded-stack-"; }
+};
+
+template<>
+struct VectorNamePrefix<FetchAddFixedVector> {
+  static std::string prefix() { return "fixed-vector-fetch-add-"; }
+};
+
+template<>
+struct VectorNamePrefix<CountedFixedVector> {
+  static std::string prefix() { return "fixed-vector-counted-"; }
+};
+
+template<>
+struct VectorNamePrefix<HugePageFixedVector> {
+  static std::string prefix() { return "fixed-vector-huge-pages-"; }
+};
+
+template<>
+struct VectorNamePrefix<PaddedFixedVector> {
+  static std::string prefix() { return "fixed-vector-padded-"; }
+};
+
+template<>
+struct VectorNamePrefix<ScatteredFixedVector> {
+  static std::string prefix() { return "fixed-vector-scattered-"; }
+};
+
+template<>
+struct VectorNamePrefix<BackoffFixedVector<AdaptiveBackoff>::Type> {
+  static std::string prefix() { return "fixed-vector-adaptive-"; }
+};
+
+template<>
+struct VectorNamePrefix<BackoffFixedVector<SpinBackoff>::Type> {
+  static std::string prefix() { return "fixed-vector-spin-"; }
+};
+
+template<>
+struct VectorNamePrefix<BackoffFixedVector<ExponentialBackoff>::Type> {
+  static std::string prefix() { return "fixed-vector-exponential-"; }
+};
+
+template<>
+struct VectorNamePrefix<BackoffFixedVector<YieldBackoff>::Type> {
+  static std::string prefix() { return "fixed-vector-yield-"; }
+};
+
+
+// A ShardedStack doesn't keep its elements at contiguous indices, so
+// tests that read the vector back by index don't apply to it.
+
+template<template<typename T, size_t S> class Vec>
+struct HasContiguousIndices {
+  static const bool value = true;
+};
+
+template<>
+struct HasContiguousIndices<ShardedStack> {
+  static const bool value = false;
+};
+
+
+// ContentionStatsOf<Vec>::Get returns the contention counted by a
+// vector, for the vectors that count it, and nothing otherwise.
+
+template<template<typename T, size_t S> class Vec>
+struct ContentionStatsOf {
+  static const bool kCounted = false;
+
+  template<typename VectorType>
+  static ContentionStats Get(VectorType *) { return ContentionStats(); }
+};
+
+template<>
+struct ContentionStatsOf<CountedFixedVector> {
+  static const bool kCounted = true;
+
+  template<typename VectorType>
+  static ContentionStats Get(VectorType *vector) { return vector->stats(); }
+};
+
+}
+
+#endif
@@ -4,9 +4,18 @@
 #include <cstring>
 
 #include "atomics.hpp"
+#include "backoff.hpp"
+#include "contention-counters.hpp"
+#include "epoch.hpp"
+#include "page-allocator.hpp"
+#include "slot-layout.hpp"
 
 namespace eelish {
 
+/// As FixedVector's `Size`: the capacity is given to the constructor
+/// instead.
+const std::size_t kRuntimeCapacity = 0;
+
 /// A mostly lock-free fixed-size Vector
 ///
 ///        This is the first time I've done any non-trivial lock-free
@@ -74,27 +83,110 @@ namespace eelish {
 /// implementation steal the last two bits of the pointers, so keep
 /// this in mind when doing naughty things.  Moreover, the range for
 /// `T *` must not include the sentinels declared below.
-template<typename T, std::size_t Size>
+///
+/// With `Size` kRuntimeCapacity, the capacity is whatever the
+/// constructor is given, so that capacities that come from a
+/// configuration don't each need an instantiation of their own.
+///
+/// The slots come from `Allocator` (see page-allocator.hpp), and a
+/// slot that is all zeros reads as kInconsistent (see encode).  So
+/// constructing a vector doesn't touch its slots, and with the default
+/// PageAllocator a page of them is only backed by memory once a push
+/// gets to it.
+///
+/// `Backoff` decides what pop_back does when it finds the tail slot
+/// primed by another thread (see backoff.hpp); by default it sleeps.
+/// `Counters` decides whether the vector keeps count of the CASes it
+/// loses, the slots it can't prime and so on (see
+/// contention-counters.hpp); by default it doesn't, at no cost.
+/// `Layout` decides whether the length gets a cache line of its own
+/// and whether consecutive indices share lines (see slot-layout.hpp);
+/// by default it doesn't and they do.
+template<typename T, std::size_t Size, typename Backoff = SleepBackoff,
+         typename Counters = NoContentionCounters,
+         typename Allocator = PageAllocator,
+         typename Layout = PackedLayout>
 class FixedVector {
  public:
-  FixedVector();
+  /// `capacity` may only differ from `Size` if `Size` is
+  /// kRuntimeCapacity.  Throws std::bad_alloc if `allocator` fails.
+  explicit FixedVector(std::size_t capacity = Size,
+                       const Allocator &allocator = Allocator());
+  ~FixedVector();
 
   /// Push a value into the vector.  Returns the index at which the
   /// value is inserted, or -1 if the FixedVector is currently full.
   std::size_t push_back(T *value);
 
+  /// Same as push_back, but bumps the length with a single atomic add
+  /// instead of a compare exchange loop, so it never retries however
+  /// contended the length is.  Pushing into a full vector briefly
+  /// takes the length past the capacity before rolling it back; pops
+  /// wait that out.
+  std::size_t fetch_add_push_back(T *value);
+
   /// Pop a value from the tail of the vector.  The index of the value
   /// is returned in `out_index`.  `pop_back` on an empty vector
   /// returns kOutOfRange, which can be tested using
   /// `is_out_of_range`.
   T * __attribute__((flatten)) pop_back(std::size_t *out_index);
 
+  /// Single attempts at push_back and pop_back, for callers that
+  /// would rather do something else than retry.  They return false if
+  /// they lost a race to another thread or (for try_pop_back) found
+  /// the tail busy.  Otherwise they return true and report what
+  /// push_back or pop_back would have returned in `out_index` and
+  /// `out_value`.
+  bool try_push_back(T *value, std::size_t *out_index);
+  bool try_pop_back(T **out_value, std::size_t *out_index);
+
+  /// Push `values[0]` ... `values[n - 1]` (in that order) into the
+  /// vector at consecutive indices, using a single CAS on the length.
+  /// If the vector doesn't have space for all of them, only a prefix
+  /// of `values` is pushed.  Returns the number of values pushed.
+  std::size_t push_back_n(T **values, std::size_t n);
+
+  /// Pop at most `max` values from the tail of the vector, using a
+  /// single CAS on the length.  The values are stored into `out` in
+  /// the order successive pop_backs would have returned them.
+  /// Returns the number of values popped, which is 0 for an empty
+  /// vector and less than `max` if the vector had fewer elements or
+  /// some of them are still being pushed or popped by other threads.
+  std::size_t pop_back_n(T **out, std::size_t max);
+
+  /// A single attempt at pop_back_n.  Returns 0, rather than backing
+  /// off and retrying, if it lost a race to another thread or found
+  /// the tail busy.
+  std::size_t try_pop_back_n(T **out, std::size_t max);
+
   /// Fetches a value from the vector.  Returns kOutOfRange for an
-  /// invalid index (check using is_out_of_range).
+  /// invalid index (check using is_out_of_range), and for an index
+  /// that is being pushed to or popped from right now.
   T *get(std::size_t index);
 
+  /// get and pop_back for vectors holding values that get freed once
+  /// popped.  get only returns values no pop has primed yet, so none
+  /// of them have been retired before `guard` was taken; the value
+  /// stays valid for as long as `guard` lives, even if another thread
+  /// pops it meanwhile.
+  /// retire_pop_back pops a value and hands it to Epoch::Retire, so
+  /// the caller may use it only till `guard` goes away.  See epoch.hpp.
+  inline T *get(std::size_t index, const EpochGuard &) {
+    return get(index);
+  }
+
+  T *retire_pop_back(std::size_t *out_index, const EpochGuard &guard);
+
   std::size_t length() const;
 
+  inline std::size_t capacity() const {
+    return Size == kRuntimeCapacity ? capacity_ : Size;
+  }
+
+  /// What the vector's Counters have counted so far; all zeros with
+  /// NoContentionCounters.
+  inline ContentionStats stats() const { return counters_.stats(); }
+
   inline static bool is_inconsistent(T *value) {
     return (reinterpret_cast<intptr_t>(value) & (~kBitMask)) ==
         (kInconsistent & (~kBitMask));
@@ -106,13 +198,94 @@ class FixedVector {
   }
 
  private:
-  Atomic<Word> length_;
-  Atomic<T *> buffer_[Size];
+  FixedVector(const FixedVector &);
+  FixedVector &operator=(const FixedVector &);
+
+  alignas(Layout::kLengthAlignment) Atomic<Word> length_;
+  alignas(Layout::kLengthAlignment) Atomic<T *> *buffer_;
+  std::size_t capacity_;
+  Allocator allocator_;
+  BackoffSite backoff_site_;
+  Counters counters_;
+
+  /// A CAS on length_, counted.
+  inline bool cas_length(Word old_length, Word new_length,
+                         MemoryOrder order) {
+    counters_.count(kLengthCasAttempt);
+    if (likely(length_.boolean_cas(old_length, new_length, order))) {
+      return true;
+    }
+    counters_.count(kLengthCasFailure);
+    return false;
+  }
+
+  /// Holds as long as the vector's length is `length` and a pop
+  /// can't proceed: either because the slot at `length - 1` is primed
+  /// or because `length` is out of bounds.
+  class PopBlocked {
+   public:
+    inline PopBlocked(FixedVector *vector, Word length) :
+        vector_(vector), length_(length) { }
+
+    inline bool operator()() const {
+      if (vector_->length_.nobarrier_load() != length_) return false;
+      return length_ > vector_->capacity() ||
+          !is_poppable(vector_->slot(length_ - 1)->nobarrier_load());
+    }
+
+   private:
+    FixedVector *vector_;
+    Word length_;
+  };
+
+  /// The outcome of a single attempt at pushing or popping.  kDone
+  /// means the operation went through (or found the vector full or
+  /// empty), kBlocked that the tail is busy and we should back off
+  /// and kRaced that we lost a race on length_ and can retry
+  /// immediately.
+  enum Attempt {
+    kDone,
+    kBlocked,
+    kRaced
+  };
+
+  /// Where the slot for `index` is; see Layout.
+  inline Atomic<T *> *slot(Word index) {
+    return &buffer_[Layout::Slot(index, capacity())];
+  }
+
+  inline Attempt attempt_push(T *value, std::size_t *out_index);
+  inline Attempt attempt_pop(T **out_value, Word *out_length);
+  inline Attempt attempt_pop_n(T **out, Word max, Word *out_count,
+                               Word *out_length);
+
+  /// Slots hold values with every bit but the two low ones flipped,
+  /// which takes kInconsistent to 0 (give or take those bits).  The
+  /// low bits are Atomic's to prime with, and are left alone.  Flipping
+  /// twice is a no-op, so decode is encode.
+  static inline T *encode(T *value) {
+    return reinterpret_cast<T *>(reinterpret_cast<intptr_t>(value) ^
+                                 kEncodingMask);
+  }
+
+  static inline T *decode(T *slot) { return encode(slot); }
+
+  /// Whether a pop may take the value in `slot`: it must be neither
+  /// primed nor unwritten.  Unwritten slots are zero, not primed, so
+  /// Atomic::cas_prime would happily prime one; prime_slot doesn't.
+  static inline bool is_poppable(T *slot) {
+    return slot != NULL && !Atomic<T *>::is_primed(slot);
+  }
+
+  /// Primes the slot at `index` if it is poppable and returns its
+  /// contents, unprimed and still encoded, in `out_slot`.
+  inline bool prime_slot(Word index, T **out_slot);
 
   /// Sentinels.  We expect no pointer to have these exact values.
   static const intptr_t kInconsistent = -1;
   static const intptr_t kOutOfRange = -2;
   static const intptr_t kBitMask = 3;
+  static const intptr_t kEncodingMask = ~kBitMask;
 };
 
 }
@@ -0,0 +1,172 @@
+#ifndef __EELISH_GROWABLE_VECTOR__HPP
+#error "growable-vector-inl.hpp can only be included from within \
+        growable-vector.hpp"
+#endif
+
+#include <algorithm>
+#include <cassert>
+
+#include "utils.hpp"
+
+namespace eelish {
+
+// The memory orders are FixedVector's; see fixed-vector-inl.hpp.
+
+template<typename T, typename Backoff>
+GrowableVector<T, Backoff>::GrowableVector(std::size_t max_length) :
+    max_length_(std::min(max_length, kMaxLength)) {
+  length_.raw_store(0);
+  for (int i = 0; i < kBucketCount; i++) {
+    buckets_[i].raw_store(NULL);
+  }
+}
+
+template<typename T, typename Backoff>
+GrowableVector<T, Backoff>::~GrowableVector() {
+  for (int i = 0; i < kBucketCount; i++) {
+    delete[] buckets_[i].raw_load();
+  }
+}
+
+template<typename T, typename Backoff>
+void GrowableVector<T, Backoff>::locate(Word index, int *out_bucket,
+                                        Word *out_offset) {
+  // Bucket b covers the indices [F * (2^b - 1), F * (2^(b + 1) - 1))
+  // where F is kFirstBucketSize.  Shifting the index by F turns that
+  // into [F * 2^b, F * 2^(b + 1)), so the bucket can be read off the
+  // most significant bit.
+  Word position = index + kFirstBucketSize;
+  int msb = static_cast<int>(sizeof(Word) * 8 - 1) - __builtin_clzl(position);
+  *out_bucket = msb - kFirstBucketBits;
+  *out_offset = position - (static_cast<Word>(1) << msb);
+}
+
+template<typename T, typename Backoff>
+Atomic<T *> *GrowableVector<T, Backoff>::allocate_bucket(int bucket) {
+  std::size_t bucket_size = kFirstBucketSize << bucket;
+  Atomic<T *> *new_bucket = new Atomic<T *>[bucket_size];
+  for (std::size_t i = 0; i < bucket_size; i++) {
+    new_bucket[i].raw_store(reinterpret_cast<T *>(kInconsistent));
+  }
+
+  // The release makes sure the slots are initialized before the
+  // bucket is visible; the acquire (should we lose) that the winner's
+  // slots are, before we use them.
+  Atomic<T *> *existing =
+      buckets_[bucket].value_cas(NULL, new_bucket, kAcqRel);
+  if (existing == NULL) return new_bucket;
+
+  // Somebody beat us to it.
+  delete[] new_bucket;
+  return existing;
+}
+
+template<typename T, typename Backoff>
+Atomic<T *> *GrowableVector<T, Backoff>::slot(Word index) {
+  int bucket;
+  Word offset;
+  locate(index, &bucket, &offset);
+
+  Atomic<T *> *bucket_slots = buckets_[bucket].acquire_load();
+  if (unlikely(bucket_slots == NULL)) {
+    bucket_slots = allocate_bucket(bucket);
+  }
+  return &bucket_slots[offset];
+}
+
+template<typename T, typename Backoff>
+Atomic<T *> *GrowableVector<T, Backoff>::existing_slot(Word index) {
+  int bucket;
+  Word offset;
+  locate(index, &bucket, &offset);
+
+  Atomic<T *> *bucket_slots = buckets_[bucket].acquire_load();
+  if (bucket_slots == NULL) return NULL;
+  return &bucket_slots[offset];
+}
+
+template<typename T, typename Backoff>
+std::size_t GrowableVector<T, Backoff>::push_back(T *value) {
+  while (true) {
+    Word index = length_.nobarrier_load();
+    if (index >= max_length_) return -1;
+
+    // Same as in FixedVector::attempt_push, the acquire keeps the
+    // store from being reordered ahead of the length_ increment.
+    if (!length_.boolean_cas(index, index + 1, kAcquire)) continue;
+
+    slot(index)->store(value, kRelease);
+
+    if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+    return static_cast<std::size_t>(index);
+  }
+}
+
+template<typename T, typename Backoff>
+T *GrowableVector<T, Backoff>::pop_back(std::size_t *out_index) {
+  Backoff backoff;
+  while (true) {
+    Word length = length_.nobarrier_load();
+    if (length == 0) return reinterpret_cast<T *>(kOutOfRange);
+
+    Word index = length - 1;
+    T *value;
+
+    // The push that made space for this slot may not have gotten
+    // around to allocating its bucket yet, so we might have to.  The
+    // fresh slot is inconsistent, which fails cas_prime just like a
+    // primed slot does.
+    Atomic<T *> *tail = slot(index);
+    if (unlikely(!tail->cas_prime(&value, kAcquire))) {
+      backoff.backoff(&backoff_site_, PopBlocked(this, length));
+      continue;
+    }
+
+    // The release keeps the priming from being reordered to after the
+    // length_ change, as in FixedVector::attempt_pop.
+    if (unlikely(!length_.boolean_cas(length, length - 1, kRelease))) {
+      tail->store(value, kRelease);
+      if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+      continue;
+    }
+
+    if (Backoff::kParks) backoff_site_.wake_waiters();
+    if (out_index != NULL) *out_index = index;
+    return value;
+  }
+}
+
+template<typename T, typename Backoff>
+T *GrowableVector<T, Backoff>::get(std::size_t index) {
+  Word length = length_.nobarrier_load();
+  T *out_of_range = reinterpret_cast<T *>(kOutOfRange);
+
+  if (index >= length) return out_of_range;
+
+  Atomic<T *> *index_slot = existing_slot(index);
+  if (index_slot == NULL) return out_of_range;
+
+  // A primed slot is being popped or has been popped (and its value
+  // perhaps freed) already; see FixedVector::get.
+  T *value = index_slot->acquire_load();
+  if (is_inconsistent(value) || Atomic<T *>::is_primed(value)) {
+    return out_of_range;
+  }
+  return value;
+}
+
+template<typename T, typename Backoff>
+std::size_t GrowableVector<T, Backoff>::length() const {
+  return length_.nobarrier_load();
+}
+
+template<typename T, typename Backoff>
+std::size_t GrowableVector<T, Backoff>::capacity() const {
+  std::size_t slots = 0;
+  for (int i = 0; i < kBucketCount; i++) {
+    if (buckets_[i].nobarrier_load() != NULL) slots += kFirstBucketSize << i;
+  }
+  return slots;
+}
+
+}
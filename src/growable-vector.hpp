@@ -0,0 +1,120 @@
+#ifndef __EELISH_GROWABLE_VECTOR__HPP
+#define __EELISH_GROWABLE_VECTOR__HPP
+
+#include <cstring>
+
+#include "atomics.hpp"
+#include "backoff.hpp"
+
+namespace eelish {
+
+/// A mostly lock-free vector that grows as needed.
+///
+/// GrowableVector provides the same operations and the same
+/// consistency guarantee as FixedVector (see fixed-vector.hpp),
+/// including the restriction that a pop can't pop past another
+/// ongoing pop.  The difference is in how the slots are stored:
+/// instead of one big buffer, GrowableVector keeps a small table of
+/// buckets, each twice as large as the one before it.  Bucket `b`
+/// holds kFirstBucketSize * 2^b slots and is only allocated when the
+/// vector first grows into it, so memory use stays proportional to
+/// the largest length the vector has seen.  Finding the slot for an
+/// index is a couple of bit operations, and buckets never move once
+/// allocated, so indexing stays O(1) and lock-free.
+///
+/// Buckets are allocated by whichever thread first needs them (a
+/// push or a pop) and installed with a CAS; the losers of that race
+/// free their allocation.  Buckets are only freed when the vector is
+/// destroyed.
+///
+/// A GrowableVector may optionally be given a maximum length, after
+/// which push_back fails just like it does on a full FixedVector.
+/// The same restrictions on `T *` as in FixedVector apply.
+template<typename T, typename Backoff = SleepBackoff>
+class GrowableVector {
+ public:
+  explicit GrowableVector(std::size_t max_length = kMaxLength);
+  ~GrowableVector();
+
+  /// Push a value into the vector.  Returns the index at which the
+  /// value is inserted, or -1 if the vector has hit its maximum length.
+  std::size_t push_back(T *value);
+
+  /// Pop a value from the tail of the vector.  The index of the value
+  /// is returned in `out_index`.  `pop_back` on an empty vector
+  /// returns kOutOfRange, which can be tested using
+  /// `is_out_of_range`.
+  T * __attribute__((flatten)) pop_back(std::size_t *out_index);
+
+  /// Fetches a value from the vector.  Returns kOutOfRange for an
+  /// invalid index (check using is_out_of_range), and for an index
+  /// that is being pushed to or popped from right now.
+  T *get(std::size_t index);
+
+  std::size_t length() const;
+
+  /// The number of slots allocated so far.
+  std::size_t capacity() const;
+
+  inline static bool is_inconsistent(T *value) {
+    return (reinterpret_cast<intptr_t>(value) & (~kBitMask)) ==
+        (kInconsistent & (~kBitMask));
+  }
+
+  inline static bool is_out_of_range(T *value) {
+    return (reinterpret_cast<intptr_t>(value) & (~kBitMask)) ==
+        (kOutOfRange & (~kBitMask));
+  }
+
+  static const int kFirstBucketBits = 6;
+  static const std::size_t kFirstBucketSize =
+      static_cast<std::size_t>(1) << kFirstBucketBits;
+  static const int kBucketCount = 32;
+  static const std::size_t kMaxLength =
+      kFirstBucketSize * ((static_cast<std::size_t>(1) << kBucketCount) - 1);
+
+ private:
+  Atomic<Word> length_;
+  Word max_length_;
+  Atomic<Atomic<T *> *> buckets_[kBucketCount];
+  BackoffSite backoff_site_;
+
+  /// Returns the slot for `index`, allocating its bucket if needed.
+  inline Atomic<T *> *slot(Word index);
+
+  /// Returns the slot for `index`, or NULL if its bucket hasn't been
+  /// allocated yet.
+  inline Atomic<T *> *existing_slot(Word index);
+
+  inline static void locate(Word index, int *out_bucket, Word *out_offset);
+
+  Atomic<T *> *allocate_bucket(int bucket);
+
+  /// Same as FixedVector::PopBlocked.
+  class PopBlocked {
+   public:
+    inline PopBlocked(GrowableVector *vector, Word length) :
+        vector_(vector), length_(length) { }
+
+    inline bool operator()() const {
+      if (vector_->length_.nobarrier_load() != length_) return false;
+      return Atomic<T *>::is_primed(
+          vector_->slot(length_ - 1)->nobarrier_load());
+    }
+
+   private:
+    GrowableVector *vector_;
+    Word length_;
+  };
+
+  /// Sentinels.  We expect no pointer to have these exact values.
+  static const intptr_t kInconsistent = -1;
+  static const intptr_t kOutOfRange = -2;
+  static const intptr_t kBitMask = 3;
+};
+
+}
+
+#include "growable-vector-inl.hpp"
+
+#endif
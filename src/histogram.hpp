@@ -0,0 +1,91 @@
+#ifndef __EELISH_HISTOGRAM__HPP
+#define __EELISH_HISTOGRAM__HPP
+
+#include <algorithm>
+#include <cstring>
+#include <stdint.h>
+
+namespace eelish {
+
+/// A histogram of unsigned 64 bit values with log-sized buckets, in
+/// the manner of HdrHistogram.
+///
+/// Values below kSubBuckets get a bucket each.  Above that, every
+/// power of two range [2^k, 2^(k + 1)) is split into kSubBuckets
+/// equal buckets, so a value is known to within 1 / kSubBuckets of
+/// itself (6.25%) whatever its magnitude.  That takes a fixed 976
+/// buckets for the whole 64 bit range, and recording is a count
+/// leading zeros and an increment.
+///
+/// Not thread safe: give every thread its own and merge them.
+class LogHistogram {
+ public:
+  inline LogHistogram() { clear(); }
+
+  inline void clear() {
+    memset(counts_, 0, sizeof(counts_));
+    count_ = 0;
+    max_ = 0;
+  }
+
+  inline void record(uint64_t value) {
+    counts_[BucketOf(value)]++;
+    count_++;
+    max_ = std::max(max_, value);
+  }
+
+  inline void merge(const LogHistogram &other) {
+    for (int i = 0; i < kBuckets; i++) counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  inline uint64_t count() const { return count_; }
+  inline uint64_t max() const { return max_; }
+
+  /// The smallest value that at least `percentile` percent of the
+  /// recorded values are less than or equal to, give or take the
+  /// bucket size.  0 for an empty histogram.
+  inline uint64_t percentile(double percentile) const {
+    if (count_ == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count_ + 0.5);
+    rank = std::max(rank, static_cast<uint64_t>(1));
+
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+      seen += counts_[i];
+      if (seen >= rank) return std::min(HighestValueIn(i), max_);
+    }
+    return max_;
+  }
+
+ private:
+  static const int kSubBucketBits = 4;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  static inline int BucketOf(uint64_t value) {
+    if (value < static_cast<uint64_t>(kSubBuckets)) {
+      return static_cast<int>(value);
+    }
+    int shift = (63 - __builtin_clzll(value)) - kSubBucketBits;
+    return (shift + 1) * kSubBuckets +
+        static_cast<int>((value >> shift) & (kSubBuckets - 1));
+  }
+
+  static inline uint64_t HighestValueIn(int bucket) {
+    if (bucket < kSubBuckets) return bucket;
+    int shift = bucket / kSubBuckets - 1;
+    uint64_t next = static_cast<uint64_t>(kSubBuckets +
+                                          bucket % kSubBuckets + 1) << shift;
+    return next - 1;
+  }
+
+  uint64_t counts_[kBuckets];
+  uint64_t count_;
+  uint64_t max_;
+};
+
+}
+
+#endif
@@ -1,20 +1,320 @@
 #ifndef __EELISH_LOCKS__HPP
 #define __EELISH_LOCKS__HPP
 
+#include <unistd.h>
+
+#include "atomics.hpp"
 #include "platform.hpp"
+#include "utils.hpp"
 
 namespace eelish {
 
+/// Holds a lock for as long as it is in scope.  Works with Mutex and
+/// with every lock below; they all have `lock` and `unlock`.
+template<typename Lock = Mutex>
 class MutexLocker {
  public:
-  explicit inline MutexLocker(Mutex *mutex) : mutex_(mutex) {
-    mutex_->lock();
+  explicit inline MutexLocker(Lock *lock) : lock_(lock) {
+    lock_->lock();
+  }
+
+  inline ~MutexLocker() { lock_->unlock(); }
+
+ private:
+  Lock *lock_;
+};
+
+/// Waiting for a spin lock.  Spinning on a lock whose holder has been
+/// preempted only keeps the holder off the CPU, so after kSpinLimit
+/// spins we start yielding; on a uniprocessor the holder can't be
+/// running while we wait, so we yield right away.
+class SpinWait {
+ public:
+  inline SpinWait() : spins_(Uniprocessor() ? kSpinLimit : 0) { }
+
+  /// Spins `relax_count` pause instructions, or yields.
+  inline void wait(Word relax_count = 1) {
+    if (spins_ < kSpinLimit) {
+      spins_++;
+      for (Word i = 0; i < relax_count; i++) cpu_relax();
+    } else {
+      Platform::Yield();
+    }
+  }
+
+  static const int kSpinLimit = 64;
+
+ private:
+  static inline bool Uniprocessor() {
+    static const bool uniprocessor = sysconf(_SC_NPROCESSORS_ONLN) == 1;
+    return uniprocessor;
+  }
+
+  int spins_;
+};
+
+/// A mutex on futex(2), after Drepper's "Futexes Are Tricky".  The
+/// state is 0 when unlocked, 1 when locked and 2 when locked with
+/// (possibly) someone asleep waiting for it.  A contended lock spins
+/// for a while before going to sleep, since critical sections are
+/// usually shorter than a trip through the kernel; an uncontended
+/// lock and unlock are a CAS and an atomic add.
+class FutexMutex {
+ public:
+  inline FutexMutex() { state_.raw_store(kUnlocked); }
+
+  inline void lock() {
+    if (likely(state_.boolean_cas(kUnlocked, kLocked, kAcquire))) return;
+
+    for (int i = 0; i < kSpinLimit; i++) {
+      cpu_relax();
+      if (state_.nobarrier_load() == kUnlocked &&
+          state_.boolean_cas(kUnlocked, kLocked, kAcquire)) {
+        return;
+      }
+    }
+
+    // From here on we take the lock as kContended, since we can't tell
+    // whether there are others asleep besides us.
+    while (exchange(kContended) != kUnlocked) {
+      Platform::FutexWait(futex_word(), kContended);
+    }
+  }
+
+  inline bool try_lock() {
+    return state_.boolean_cas(kUnlocked, kLocked, kAcquire);
+  }
+
+  inline void unlock() {
+    if (state_.fetch_add(-1, kRelease) != kLocked) {
+      state_.release_store(kUnlocked);
+      Platform::FutexWake(futex_word(), 1);
+    }
+  }
+
+  static const int kSpinLimit = 128;
+
+ private:
+  static const Word kUnlocked = 0;
+  static const Word kLocked = 1;
+  static const Word kContended = 2;
+
+  inline Word exchange(Word value) {
+    Word old_value;
+    do {
+      old_value = state_.nobarrier_load();
+    } while (!state_.boolean_cas(old_value, value, kAcquire));
+    return old_value;
+  }
+
+  /// futex(2) only understands 32 bit words; we wait on the low half
+  /// of state_ (x86 is little endian).
+  inline volatile int32_t *futex_word() {
+    return reinterpret_cast<volatile int32_t *>(state_.raw_location());
+  }
+
+  Atomic<Word> state_;
+};
+
+/// A ticket lock: threads take a number and wait till it is served,
+/// so the lock is handed out first come first served.  Waiters back
+/// off in proportion to how far back in line they are.  Every waiter
+/// spins on now_serving_, so every hand-off costs a cache miss per
+/// waiter; see McsLock and ClhLock for locks that don't.
+class TicketLock {
+ public:
+  inline TicketLock() {
+    next_ticket_.word.raw_store(0);
+    now_serving_.word.raw_store(0);
+  }
+
+  inline void lock() {
+    Word ticket = next_ticket_.word.fetch_add(1, kRelaxed);
+    SpinWait spin_wait;
+    while (true) {
+      Word serving = now_serving_.word.acquire_load();
+      if (serving == ticket) return;
+      spin_wait.wait((ticket - serving) * kBackoffPerWaiter);
+    }
+  }
+
+  inline bool try_lock() {
+    Word serving = now_serving_.word.acquire_load();
+    return next_ticket_.word.boolean_cas(serving, serving + 1, kAcquire);
+  }
+
+  inline void unlock() {
+    // Only the holder writes now_serving_.
+    now_serving_.word.release_store(now_serving_.word.nobarrier_load() + 1);
   }
 
-  inline ~MutexLocker() { mutex_->unlock(); }
+  static const Word kBackoffPerWaiter = 16;
 
  private:
-  Mutex *mutex_;
+  struct PaddedWord {
+    Atomic<Word> word;
+    char padding[kCacheLineSize - sizeof(Atomic<Word>)];
+  } __attribute__((aligned(kCacheLineSize)));
+
+  PaddedWord next_ticket_;
+  PaddedWord now_serving_;
+};
+
+/// A waiter's place in the queue of an McsLock or a ClhLock.
+struct QueueLockNode {
+  Atomic<Word> locked;
+  Atomic<QueueLockNode *> next;
+
+  /// Links the nodes in a thread's free list.
+  QueueLockNode *next_free;
+} __attribute__((aligned(kCacheLineSize)));
+
+/// The queue locks take a node per acquisition from a per-thread free
+/// list and put one back on unlock, so locking only allocates the
+/// first few times a thread does it.  Nodes are never freed: a node
+/// can move to another thread's list (see ClhLock) and threads don't
+/// give their lists back when they exit.
+class QueueLockNodes {
+ public:
+  static inline QueueLockNode *Allocate() {
+    QueueLockNode **free_list = FreeList();
+    QueueLockNode *node = *free_list;
+    if (node == NULL) return new QueueLockNode;
+    *free_list = node->next_free;
+    return node;
+  }
+
+  static inline void Free(QueueLockNode *node) {
+    QueueLockNode **free_list = FreeList();
+    node->next_free = *free_list;
+    *free_list = node;
+  }
+
+ private:
+  static inline QueueLockNode **FreeList() {
+    static __thread QueueLockNode *free_list = NULL;
+    return &free_list;
+  }
+};
+
+/// Swaps `value` into `location` and returns what was there.
+template<typename T>
+inline T *atomic_exchange(Atomic<T *> *location, T *value,
+                          MemoryOrder order) {
+  T *old_value;
+  do {
+    old_value = location->nobarrier_load();
+  } while (!location->boolean_cas(old_value, value, order));
+  return old_value;
+}
+
+/// Mellor-Crummey and Scott's queue lock.  Waiters queue up in a
+/// linked list of nodes, each spinning on a flag in its own node, and
+/// the holder hands the lock on by clearing its successor's flag: a
+/// hand-off touches one remote cache line whatever the number of
+/// waiters.
+class McsLock {
+ public:
+  inline McsLock() : owner_(NULL) { tail_.raw_store(NULL); }
+
+  inline void lock() {
+    QueueLockNode *node = QueueLockNodes::Allocate();
+    node->locked.raw_store(1);
+    node->next.raw_store(NULL);
+
+    QueueLockNode *predecessor = atomic_exchange(&tail_, node, kAcqRel);
+    if (predecessor != NULL) {
+      predecessor->next.release_store(node);
+      SpinWait spin_wait;
+      while (node->locked.acquire_load() != 0) spin_wait.wait();
+    }
+    owner_ = node;
+  }
+
+  inline bool try_lock() {
+    QueueLockNode *node = QueueLockNodes::Allocate();
+    node->locked.raw_store(1);
+    node->next.raw_store(NULL);
+    if (!tail_.boolean_cas(NULL, node, kAcquire)) {
+      QueueLockNodes::Free(node);
+      return false;
+    }
+    owner_ = node;
+    return true;
+  }
+
+  inline void unlock() {
+    QueueLockNode *node = owner_;
+    QueueLockNode *successor = node->next.acquire_load();
+    if (successor == NULL) {
+      if (tail_.boolean_cas(node, NULL, kRelease)) {
+        QueueLockNodes::Free(node);
+        return;
+      }
+
+      // Someone has swapped themselves in behind us but hasn't linked
+      // their node to ours yet.
+      SpinWait spin_wait;
+      while ((successor = node->next.acquire_load()) == NULL) {
+        spin_wait.wait();
+      }
+    }
+    successor->locked.release_store(0);
+    QueueLockNodes::Free(node);
+  }
+
+ private:
+  Atomic<QueueLockNode *> tail_;
+
+  /// The holder's node; only the holder touches it.
+  QueueLockNode *owner_;
+};
+
+/// Craig's and Landin and Hagersten's queue lock.  Like McsLock, but
+/// the queue is implicit: a waiter spins on its predecessor's node,
+/// and releasing the lock is a single store to one's own node.  The
+/// price is that a thread gives up its node on unlock and takes its
+/// predecessor's instead.
+///
+/// There is no try_lock: the tail node can be recycled and re-queued
+/// between being looked at and being CASed out, which a lock that
+/// never waits on it can't tell apart from a free lock.
+class ClhLock {
+ public:
+  inline ClhLock() : owner_(NULL), owner_predecessor_(NULL) {
+    QueueLockNode *node = new QueueLockNode;
+    node->locked.raw_store(0);
+    tail_.raw_store(node);
+  }
+
+  inline void lock() {
+    QueueLockNode *node = QueueLockNodes::Allocate();
+    node->locked.raw_store(1);
+
+    QueueLockNode *predecessor = atomic_exchange(&tail_, node, kAcqRel);
+    SpinWait spin_wait;
+    while (predecessor->locked.acquire_load() != 0) spin_wait.wait();
+
+    owner_ = node;
+    owner_predecessor_ = predecessor;
+  }
+
+  inline void unlock() {
+    QueueLockNode *predecessor = owner_predecessor_;
+    owner_->locked.release_store(0);
+    QueueLockNodes::Free(predecessor);
+  }
+
+  /// The node left at the tail belongs to no thread.
+  inline ~ClhLock() { delete tail_.raw_load(); }
+
+ private:
+  Atomic<QueueLockNode *> tail_;
+
+  /// The holder's node and its predecessor's; only the holder touches
+  /// them.
+  QueueLockNode *owner_;
+  QueueLockNode *owner_predecessor_;
 };
 
 }
@@ -0,0 +1,106 @@
+#ifndef __EELISH_MAPPED_WORD_VECTOR__HPP
+#error "mapped-word-vector-inl.hpp can only be included from within \
+        mapped-word-vector.hpp"
+#endif
+
+#include <algorithm>
+#include <cassert>
+
+namespace eelish {
+
+// The memory orders are FixedVector's; see fixed-vector-inl.hpp.
+
+template<typename Backoff>
+std::size_t MappedWordVector<Backoff>::push_back(Word value) {
+  assert(value <= kMaxValue);
+
+  while (true) {
+    Word index = length_->nobarrier_load();
+    if (index >= capacity_) return -1;
+
+    if (!length_->boolean_cas(index, index + 1, kAcquire)) continue;
+
+    slots_[index].store(encode(value), kRelease);
+    if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+    return static_cast<std::size_t>(index);
+  }
+}
+
+template<typename Backoff>
+bool MappedWordVector<Backoff>::pop_back(Word *out_value,
+                                         std::size_t *out_index) {
+  Backoff backoff;
+  while (true) {
+    Word value;
+    Word length;
+    switch (attempt_pop(&value, &length)) {
+      case kDone:
+        if (length == 0) return false;
+        if (out_index != NULL) *out_index = length - 1;
+        *out_value = value;
+        return true;
+      case kBlocked:
+        backoff.backoff(&backoff_site_, PopBlocked(this, length));
+        break;
+      case kRaced:
+        break;
+    }
+  }
+}
+
+template<typename Backoff>
+typename MappedWordVector<Backoff>::Attempt
+MappedWordVector<Backoff>::attempt_pop(Word *out_value, Word *out_length) {
+  Word length = length_->nobarrier_load();
+  *out_length = length;
+  if (length == 0) return kDone;
+
+  // An unwritten slot is one a push hasn't got to yet, and can't be
+  // popped any more than a primed one; so we can't use cas_prime.
+  Atomic<Word> *slot = &slots_[length - 1];
+  Word old_slot = slot->acquire_load();
+  if (!is_poppable(old_slot) ||
+      !slot->boolean_cas(old_slot, old_slot | kPrimed, kAcquire)) {
+    return kBlocked;
+  }
+
+  if (unlikely(!length_->boolean_cas(length, length - 1, kRelease))) {
+    slot->store(old_slot, kRelease);
+    if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+    return kRaced;
+  }
+
+  if (Backoff::kParks) backoff_site_.wake_waiters();
+  *out_value = decode(old_slot);
+  return kDone;
+}
+
+template<typename Backoff>
+bool MappedWordVector<Backoff>::get(std::size_t index, Word *out_value) {
+  if (index >= length_->nobarrier_load()) return false;
+
+  Word slot = slots_[index].acquire_load();
+  if (!is_poppable(slot)) return false;
+  *out_value = decode(slot);
+  return true;
+}
+
+template<typename Backoff>
+void MappedWordVector<Backoff>::recover() {
+  Word length = std::min(length_->raw_load(), static_cast<Word>(capacity_));
+
+  Word kept = 0;
+  for (Word i = 0; i < length; i++) {
+    Word slot = slots_[i].raw_load();
+    if (is_poppable(slot)) slots_[kept++].raw_store(slot);
+  }
+
+  // The slots above the length must not hold anything a pop could
+  // take, or an unwritten push into one of them would look pushed the
+  // next time around.
+  for (Word i = kept; i < length; i++) slots_[i].raw_store(0);
+
+  length_->raw_store(kept);
+}
+
+}
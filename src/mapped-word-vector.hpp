@@ -0,0 +1,119 @@
+#ifndef __EELISH_MAPPED_WORD_VECTOR__HPP
+#define __EELISH_MAPPED_WORD_VECTOR__HPP
+
+#include "atomics.hpp"
+#include "backoff.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// FixedVector's algorithm on a length and an array of slots that
+/// live in memory someone else maps: a file (PersistentFixedVector)
+/// or a shared memory segment (SharedFixedVector).
+///
+/// Pointers mean nothing to another process, or to the next run of
+/// this one, so the vector holds words: indices into or offsets of
+/// whatever the caller keeps elsewhere, up to kMaxValue.  A slot
+/// holds its value shifted left by two:
+///
+///   0                  unwritten: no value was ever pushed here, or
+///                      recover cleared the slot
+///   value << 2 | 2     the slot holds `value`
+///   value << 2 | 3     a pop_back has primed `value`, or popped it
+///                      and left it behind
+///
+/// Zero meaning unwritten is what makes a new vector cheap: fresh
+/// pages read as zeros, so there is nothing to initialize.
+///
+/// The algorithm is otherwise FixedVector's, and so are the
+/// guarantees; see fixed-vector.hpp.  Every process has its own
+/// BackoffSite, so a pop parked in one process is not woken up by a
+/// push in another; it waits out the park timeout instead.
+template<typename Backoff = SleepBackoff>
+class MappedWordVector {
+ public:
+  /// `length` and the `capacity` slots at `slots` must be zero for a
+  /// new vector.
+  inline MappedWordVector(Atomic<Word> *length, Atomic<Word> *slots,
+                          std::size_t capacity) :
+      length_(length), slots_(slots), capacity_(capacity) { }
+
+  /// Returns the index at which the value is inserted, or -1 if the
+  /// vector is full.  `value` must be at most kMaxValue.
+  std::size_t push_back(Word value);
+
+  /// Returns false if the vector is empty.  `out_index` may be NULL.
+  bool pop_back(Word *out_value, std::size_t *out_index);
+
+  /// Returns false if there is no value at `index`, or if the value
+  /// there is still being pushed or being popped.
+  bool get(std::size_t index, Word *out_value);
+
+  std::size_t length() const { return length_->nobarrier_load(); }
+  std::size_t capacity() const { return capacity_; }
+
+  /// Repairs the vector after whoever used it died in the middle of
+  /// pushes and pops (see fixed-vector.hpp):
+  ///
+  ///   a. A pop_back primed the slot at the tail but didn't lower the
+  ///      length.  The pop is taken to have happened; the popping
+  ///      process is gone, and the value with it.
+  ///
+  ///   b. A push_back bumped the length but didn't write its slot.
+  ///      The push is taken not to have happened.
+  ///
+  /// This is a pass over the slots below the length, which keeps the
+  /// values that are fully pushed, in order, and clears the rest.  No
+  /// one else may be using the vector meanwhile.
+  void recover();
+
+  static const Word kMaxValue = ~static_cast<Word>(0) >> 2;
+
+ private:
+  static inline Word encode(Word value) { return (value << 2) | kWritten; }
+  static inline Word decode(Word slot) { return slot >> 2; }
+
+  /// Whether a pop may take the value in `slot`.
+  static inline bool is_poppable(Word slot) {
+    return (slot & (kWritten | kPrimed)) == kWritten;
+  }
+
+  /// Holds as long as the vector's length is `length` and the slot at
+  /// `length - 1` can't be popped.
+  class PopBlocked {
+   public:
+    inline PopBlocked(MappedWordVector *vector, Word length) :
+        vector_(vector), length_(length) { }
+
+    inline bool operator()() const {
+      if (vector_->length_->nobarrier_load() != length_) return false;
+      return !is_poppable(vector_->slots_[length_ - 1].nobarrier_load());
+    }
+
+   private:
+    MappedWordVector *vector_;
+    Word length_;
+  };
+
+  enum Attempt {
+    kDone,
+    kBlocked,
+    kRaced
+  };
+
+  inline Attempt attempt_pop(Word *out_value, Word *out_length);
+
+  Atomic<Word> *length_;
+  Atomic<Word> *slots_;
+  std::size_t capacity_;
+  BackoffSite backoff_site_;
+
+  static const Word kPrimed = 1;
+  static const Word kWritten = 2;
+};
+
+}
+
+#include "mapped-word-vector-inl.hpp"
+
+#endif
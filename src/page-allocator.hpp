@@ -0,0 +1,125 @@
+#ifndef __EELISH_PAGE_ALLOCATOR__HPP
+#define __EELISH_PAGE_ALLOCATOR__HPP
+
+#include <cstddef>
+#include <stdint.h>
+
+#include "platform.hpp"
+
+namespace eelish {
+
+/// Where FixedVector gets its slots from.  An allocator is a small
+/// value, copied into every vector it allocates for, with
+///
+///   void *allocate(std::size_t size);
+///   void deallocate(void *address, std::size_t size);
+///
+/// allocate returns `size` bytes of zeros, or NULL.  The zeros matter:
+/// FixedVector doesn't initialize its slots (see fixed-vector.hpp).
+///
+/// PageAllocator maps fresh pages, so it gets zeros for free, and can
+/// back a large vector with huge pages, which cuts the TLB misses a
+/// random access into a multi-GB vector costs, and place it on NUMA
+/// nodes.
+class PageAllocator {
+ public:
+  enum PageSize {
+    /// Whatever the kernel gives an anonymous mapping.
+    kSmallPages,
+
+    /// Transparent huge pages, if the kernel has any to spare; small
+    /// pages otherwise.
+    kTransparentHugePages,
+
+    /// Huge pages out of the reserved pool.  allocate fails if the
+    /// pool is too small.
+    kExplicitHugePages
+  };
+
+  enum Placement {
+    /// The system's policy: usually the node of the thread that first
+    /// touches a page.
+    kDefaultPlacement,
+
+    /// The node of the thread that allocates, so that every page of a
+    /// vector is local to whoever made it.
+    kLocalPlacement,
+
+    /// Page by page over all nodes, so that threads on every node see
+    /// the same, average, latency.
+    kInterleavedPlacement
+  };
+
+  explicit PageAllocator(PageSize page_size = kSmallPages,
+                         Placement placement = kDefaultPlacement) :
+      page_size_(page_size),
+      placement_(placement) { }
+
+  inline void *allocate(std::size_t size) {
+    void *address;
+    if (page_size_ == kSmallPages) {
+      address = Platform::AllocatePages(size);
+    } else if (page_size_ == kExplicitHugePages) {
+      address = Platform::AllocateHugePages(RoundUp(size));
+    } else {
+      address = AllocateAligned(size);
+      if (address != NULL) Platform::AdviseHugePages(address, RoundUp(size));
+    }
+    if (address == NULL) return NULL;
+
+    // None of the pages have been touched yet, so the policy applies
+    // to all of them.  Failing to set it only costs performance.
+    std::size_t mapped_size = mapped(size);
+    if (placement_ == kLocalPlacement) {
+      Platform::PreferNumaNode(address, mapped_size,
+                               Platform::CurrentNumaNode());
+    } else if (placement_ == kInterleavedPlacement) {
+      Platform::InterleaveNumaNodes(address, mapped_size);
+    }
+    return address;
+  }
+
+  inline void deallocate(void *address, std::size_t size) {
+    Platform::FreePages(address, mapped(size));
+  }
+
+  PageSize page_size() const { return page_size_; }
+  Placement placement() const { return placement_; }
+
+ private:
+  static inline std::size_t RoundUp(std::size_t size) {
+    std::size_t huge = Platform::kHugePageSize;
+    return (size + huge - 1) / huge * huge;
+  }
+
+  /// How much of the address space an allocation of `size` takes.
+  inline std::size_t mapped(std::size_t size) const {
+    return page_size_ == kSmallPages ? size : RoundUp(size);
+  }
+
+  /// Transparent huge pages only back huge page aligned memory, which
+  /// mmap doesn't promise.  So we map a huge page more than we need and
+  /// unmap whatever sticks out on either side of an aligned range.
+  static inline void *AllocateAligned(std::size_t size) {
+    std::size_t huge = Platform::kHugePageSize;
+    std::size_t rounded = RoundUp(size);
+    char *address =
+        reinterpret_cast<char *>(Platform::AllocatePages(rounded + huge));
+    if (address == NULL) return NULL;
+
+    uintptr_t offset = reinterpret_cast<uintptr_t>(address) % huge;
+    std::size_t head = offset == 0 ? 0 : huge - offset;
+    if (head != 0) Platform::FreePages(address, head);
+    if (huge - head != 0) {
+      Platform::FreePages(address + head + rounded, huge - head);
+    }
+    return address + head;
+  }
+
+  PageSize page_size_;
+  Placement placement_;
+};
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef __EELISH_PARKING_LOT__HPP
+#error "parking-lot-inl.hpp can only be included from within parking-lot.hpp"
+#endif
+
+#include <climits>
+
+namespace eelish {
+
+bool ParkingLot::Wait(volatile int32_t *address, int32_t expected,
+                      long timeout_usecs) {
+  return Platform::FutexWait(address, expected, timeout_usecs);
+}
+
+void ParkingLot::WakeOne(volatile int32_t *address) {
+  Platform::FutexWake(address, 1);
+}
+
+void ParkingLot::WakeAll(volatile int32_t *address) {
+  Platform::FutexWake(address, INT_MAX);
+}
+
+template<typename T>
+bool ParkingLot::Wait(Atomic<T> *location, T expected, long timeout_usecs) {
+  Word address = reinterpret_cast<Word>(location);
+  Bucket *bucket = GetBucket(address);
+
+  // Counting ourselves in before looking at the word pairs with the
+  // fence in Wake: either the waker sees the count or we see its
+  // change.  If it sees the count it takes the bucket's lock, which we
+  // hold from before looking at the word till we're queued.
+  bucket->waiter_count.fetch_add(1);
+
+  Waiter waiter;
+  waiter.address = address;
+  waiter.woken.raw_store(0);
+
+  bucket->lock.lock();
+  bool queued = location->acquire_load() == expected;
+  if (queued) Enqueue(bucket, &waiter);
+  bucket->lock.unlock();
+
+  bool result = true;
+  if (queued) result = WaitInBucket(bucket, &waiter, timeout_usecs);
+
+  bucket->waiter_count.fetch_add(-1, kRelaxed);
+  return result;
+}
+
+template<typename T>
+void ParkingLot::WakeOne(Atomic<T> *location) {
+  Wake(reinterpret_cast<Word>(location), 1);
+}
+
+template<typename T>
+void ParkingLot::WakeAll(Atomic<T> *location) {
+  Wake(reinterpret_cast<Word>(location), INT_MAX);
+}
+
+ParkingLot::Bucket *ParkingLot::GetBucket(Word address) {
+  static Bucket buckets[kBuckets];
+
+  // Fibonacci hashing.  Atomics are word aligned, so the low bits of
+  // the address carry nothing.
+  uint64_t hash = static_cast<uint64_t>(address / sizeof(Word)) *
+      0x9E3779B97F4A7C15ULL;
+  return &buckets[hash >> (64 - kBucketBits)];
+}
+
+bool ParkingLot::WaitInBucket(Bucket *bucket, Waiter *waiter,
+                              long timeout_usecs) {
+  long deadline = -1;
+  if (timeout_usecs > 0) {
+    deadline = Platform::CurrentTimeInUSec() + timeout_usecs;
+  }
+
+  while (waiter->woken.acquire_load() == 0) {
+    long remaining = -1;
+    if (deadline != -1) {
+      remaining = deadline - Platform::CurrentTimeInUSec();
+      if (remaining <= 0) {
+        // Wakers set `woken` under the lock, so if it still is 0 we
+        // are still queued and no one will touch `waiter` again once
+        // we're off the queue.
+        bucket->lock.lock();
+        bool timed_out = waiter->woken.nobarrier_load() == 0;
+        if (timed_out) Unlink(bucket, waiter);
+        bucket->lock.unlock();
+        if (timed_out) return false;
+        break;
+      }
+    }
+    Platform::FutexWait(futex_word(&waiter->woken), 0, remaining);
+  }
+  return true;
+}
+
+void ParkingLot::Wake(Word address, int count) {
+  Bucket *bucket = GetBucket(address);
+
+  full_memory_fence();
+  if (likely(bucket->waiter_count.nobarrier_load() == 0)) return;
+
+  bucket->lock.lock();
+  Waiter *waiter = bucket->head;
+  while (waiter != NULL && count > 0) {
+    // `waiter` may return from Wait as soon as it sees `woken` set.
+    Waiter *next = waiter->next;
+    if (waiter->address == address) {
+      Unlink(bucket, waiter);
+      waiter->woken.release_store(1);
+
+      // By now the waiter may be gone, and its stack reused.  A stray
+      // futex wake-up there is harmless: every futex waiter re-checks
+      // its word.
+      Platform::FutexWake(futex_word(&waiter->woken), 1);
+      count--;
+    }
+    waiter = next;
+  }
+  bucket->lock.unlock();
+}
+
+void ParkingLot::Enqueue(Bucket *bucket, Waiter *waiter) {
+  waiter->next = NULL;
+  waiter->previous = bucket->tail;
+  if (bucket->tail == NULL) {
+    bucket->head = waiter;
+  } else {
+    bucket->tail->next = waiter;
+  }
+  bucket->tail = waiter;
+}
+
+void ParkingLot::Unlink(Bucket *bucket, Waiter *waiter) {
+  if (waiter->previous == NULL) {
+    bucket->head = waiter->next;
+  } else {
+    waiter->previous->next = waiter->next;
+  }
+  if (waiter->next == NULL) {
+    bucket->tail = waiter->previous;
+  } else {
+    waiter->next->previous = waiter->previous;
+  }
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef __EELISH_PARKING_LOT__HPP
+#define __EELISH_PARKING_LOT__HPP
+
+#include "atomics.hpp"
+#include "locks.hpp"
+#include "platform.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// Blocking on a memory word till some other thread changes it, for
+/// when spinning has gone on long enough.
+///
+/// Wait blocks as long as the word holds `expected`, and WakeOne and
+/// WakeAll wake up threads waiting on it.  A thread that changes the
+/// word has to wake the waiters afterwards; it needs no barrier of its
+/// own in between.  Wait returns false if it gave up after
+/// `timeout_usecs` (when that is positive), and true otherwise, which
+/// may be spuriously: callers re-check whatever they were waiting for.
+///
+/// 32 bit words are waited on with futex(2) directly.  Atomic<T> words
+/// are wider than futex(2) understands, so their waiters queue up in a
+/// table of kBuckets wait queues, hashed on the word's address.  A
+/// waiter counts itself in its bucket before it looks at the word, so
+/// waking a word nobody waits on is a fence and a load; waking a word
+/// that does have waiters takes the bucket's lock and a futex(2) call
+/// per thread woken.
+class ParkingLot {
+ public:
+  static inline bool Wait(volatile int32_t *address, int32_t expected,
+                          long timeout_usecs = -1);
+  static inline void WakeOne(volatile int32_t *address);
+  static inline void WakeAll(volatile int32_t *address);
+
+  template<typename T>
+  static inline bool Wait(Atomic<T> *location, T expected,
+                          long timeout_usecs = -1);
+  template<typename T>
+  static inline void WakeOne(Atomic<T> *location);
+  template<typename T>
+  static inline void WakeAll(Atomic<T> *location);
+
+  static const int kBucketBits = 8;
+  static const int kBuckets = 1 << kBucketBits;
+
+ private:
+  /// A thread blocked in Wait, on its stack.  `woken` turns 1 once a
+  /// waker has taken it off its bucket's queue.
+  struct Waiter {
+    Word address;
+    Atomic<Word> woken;
+    Waiter *next;
+    Waiter *previous;
+  };
+
+  struct Bucket {
+    inline Bucket() : head(NULL), tail(NULL) { waiter_count.raw_store(0); }
+
+    /// Threads in Wait on any of the addresses hashing here, queued or
+    /// about to be.
+    Atomic<Word> waiter_count;
+    FutexMutex lock;
+    Waiter *head;
+    Waiter *tail;
+  } __attribute__((aligned(kCacheLineSize)));
+
+  static inline Bucket *GetBucket(Word address);
+
+  static inline bool WaitInBucket(Bucket *bucket, Waiter *waiter,
+                                  long timeout_usecs);
+  static inline void Wake(Word address, int count);
+
+  static inline void Enqueue(Bucket *bucket, Waiter *waiter);
+  static inline void Unlink(Bucket *bucket, Waiter *waiter);
+
+  /// futex(2) only understands 32 bit words; we wait on the low half
+  /// of a Waiter's `woken` (x86 is little endian).
+  static inline volatile int32_t *futex_word(Atomic<Word> *word) {
+    return reinterpret_cast<volatile int32_t *>(word->raw_location());
+  }
+};
+
+}
+
+#include "parking-lot-inl.hpp"
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef __EELISH_PERSISTENT_FIXED_VECTOR__HPP
+#error "persistent-fixed-vector-inl.hpp can only be included from within \
+        persistent-fixed-vector.hpp"
+#endif
+
+namespace eelish {
+
+template<typename Backoff>
+PersistentFixedVector<Backoff> *PersistentFixedVector<Backoff>::Open(
+    const std::string &path, std::size_t capacity) {
+  std::size_t size = sizeof(Header) + capacity * sizeof(Atomic<Word>);
+
+  // Without the lock a second Open could take a file that is in use
+  // for one left open by a crash, and "recover" it under the feet of
+  // the process using it.
+  int lock = Platform::LockFile(path.c_str());
+  if (lock == -1) return NULL;
+
+  std::size_t mapped_size;
+  void *memory = Platform::MapFile(path.c_str(), size, &mapped_size);
+  if (memory == NULL) {
+    Platform::UnlockFile(lock);
+    return NULL;
+  }
+
+  Header *header = reinterpret_cast<Header *>(memory);
+  bool created = header->magic == 0;
+  if (created) {
+    // A new file, or one whose creator died before getting here.
+    // Either way all of it is still zeros, which makes every slot
+    // unwritten and the length 0.  The magic goes in last, so that a
+    // file with a magic has a complete header.
+    header->version = kVersion;
+    header->capacity = capacity;
+    memory_fence();
+    header->magic = kMagic;
+  }
+
+  if (mapped_size != size || header->magic != kMagic ||
+      header->version != kVersion || header->capacity != capacity) {
+    Platform::UnmapFile(memory, mapped_size);
+    Platform::UnlockFile(lock);
+    return NULL;
+  }
+
+  PersistentFixedVector *vector =
+      new PersistentFixedVector(header, mapped_size, lock);
+  if (!created && header->open != 0) {
+    vector->vector_.recover();
+    vector->recovered_ = true;
+  }
+  header->open = 1;
+  return vector;
+}
+
+template<typename Backoff>
+PersistentFixedVector<Backoff>::PersistentFixedVector(
+    Header *header, std::size_t mapped_size, int lock) :
+    header_(header),
+    mapped_size_(mapped_size),
+    lock_(lock),
+    recovered_(false),
+    vector_(&header->length, reinterpret_cast<Atomic<Word> *>(header + 1),
+            header->capacity) { }
+
+template<typename Backoff>
+PersistentFixedVector<Backoff>::~PersistentFixedVector() {
+  // Whatever the threads that used the vector wrote has to be in
+  // place before the file is marked closed.
+  full_memory_fence();
+  header_->open = 0;
+  Platform::UnmapFile(header_, mapped_size_);
+  Platform::UnlockFile(lock_);
+}
+
+}
@@ -0,0 +1,100 @@
+#ifndef __EELISH_PERSISTENT_FIXED_VECTOR__HPP
+#define __EELISH_PERSISTENT_FIXED_VECTOR__HPP
+
+#include <string>
+
+#include "atomics.hpp"
+#include "backoff.hpp"
+#include "mapped-word-vector.hpp"
+#include "platform.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// A FixedVector that lives in a memory mapped file, so that its
+/// contents outlive the process.  The file is a Header followed by
+/// the slots of a MappedWordVector, which holds words rather than
+/// pointers.  A new file is sparse, so creating a vector is cheap, and
+/// reopening a file that was closed properly is O(1) too; nothing but
+/// the header is touched.
+///
+/// The header records whether the file is open.  If Open finds it
+/// still open, the last process to use it went down without closing
+/// it, possibly in the middle of pushes and pops, and Open runs
+/// MappedWordVector::recover before handing the vector out.
+///
+/// The file is shared with the kernel, not written through: what a
+/// crashed process did survives, but what a crashed machine did only
+/// does as of the last call to sync.  Only one PersistentFixedVector
+/// may have the file open at a time: Open locks the file, and fails
+/// if it is locked already.
+template<typename Backoff = SleepBackoff>
+class PersistentFixedVector {
+ public:
+  /// Opens the vector in `path`, first creating it with room for
+  /// `capacity` values if the file doesn't exist.  Returns NULL if the
+  /// file can't be mapped, or holds something other than a vector of
+  /// `capacity` values, or is open already.
+  static PersistentFixedVector *Open(const std::string &path,
+                                     std::size_t capacity);
+
+  /// Marks the file closed and unmaps it.  No thread may be using the
+  /// vector by now.
+  ~PersistentFixedVector();
+
+  /// See MappedWordVector.
+  inline std::size_t push_back(Word value) {
+    return vector_.push_back(value);
+  }
+
+  inline bool pop_back(Word *out_value, std::size_t *out_index) {
+    return vector_.pop_back(out_value, out_index);
+  }
+
+  inline bool get(std::size_t index, Word *out_value) {
+    return vector_.get(index, out_value);
+  }
+
+  std::size_t length() const { return vector_.length(); }
+  std::size_t capacity() const { return vector_.capacity(); }
+
+  /// Whether Open found the file left open by a crashed process, and
+  /// had to repair it.
+  bool recovered() const { return recovered_; }
+
+  /// Writes the vector back to its file.
+  void sync() { Platform::SyncFile(header_, mapped_size_); }
+
+  static const Word kMaxValue = MappedWordVector<Backoff>::kMaxValue;
+
+ private:
+  struct Header {
+    Word magic;
+    Word version;
+    Word capacity;
+
+    /// 1 from Open till the vector is destroyed.
+    Word open;
+
+    Atomic<Word> length;
+  } __attribute__((aligned(kCacheLineSize)));
+
+  PersistentFixedVector(Header *header, std::size_t mapped_size, int lock);
+
+  Header *header_;
+  std::size_t mapped_size_;
+
+  /// From Platform::LockFile, held till the vector is destroyed.
+  int lock_;
+  bool recovered_;
+  MappedWordVector<Backoff> vector_;
+
+  static const Word kMagic = 0x454c4953485056ULL;   // "ELISHPV"
+  static const Word kVersion = 1;
+};
+
+}
+
+#include "persistent-fixed-vector-inl.hpp"
+
+#endif
@@ -2,53 +2,76 @@
 #error "platform-linux.hpp can only be included from within platform-posix.hpp"
 #endif
 
-#include <cstdio>
+#include <cerrno>
+#include <ctime>
 #include <unistd.h>
+#include <sys/mman.h>
 #include <sys/syscall.h>
 #include <linux/futex.h>
+#include <linux/mempolicy.h>
 
 #include "utils.hpp"
 
 namespace eelish {
 
-template<typename T>
-void Platform::WaitOnMemory(Atomic<T> location, T current_value) {
-  assert_static(sizeof(T) == 2 * sizeof(int) || sizeof(T) == sizeof(int));
-
-  volatile int *uaddr;
-  if (sizeof(T) == 2 * sizeof(int)) {
-    uaddr = reinterpret_cast<volatile int *>(location.raw_location()) + 1;
-  } else {
-    uaddr = reinterpret_cast<volatile int *>(location.raw_location());
+bool Platform::FutexWait(volatile int32_t *address, int32_t expected,
+                         long timeout_usecs) {
+  struct timespec timeout;
+  struct timespec *timeout_pointer = NULL;
+  if (timeout_usecs > 0) {
+    timeout.tv_sec = timeout_usecs / 1000000;
+    timeout.tv_nsec = (timeout_usecs % 1000000) * 1000;
+    timeout_pointer = &timeout;
   }
-  int int_value = static_cast<int>(reinterpret_cast<intptr_t>(current_value));
 
-  printf("  waiting on %p (%p, %d)!\n", uaddr, current_value, int_value);
-  int result = syscall(SYS_futex, uaddr, FUTEX_WAIT, int_value, NULL, NULL, 0);
-  printf("  done!\n");
+  // EAGAIN (`*address` already changed) and EINTR are fine; the
+  // caller re-checks whatever it was waiting for anyway.
+  long result = syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expected,
+                        timeout_pointer, NULL, 0);
+  return result == 0 || errno != ETIMEDOUT;
+}
 
-  assert(result != -1);
-  (void) result;
+void Platform::FutexWake(volatile int32_t *address, int num_waiters) {
+  syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, num_waiters, NULL, NULL, 0);
 }
 
-template<typename T>
-void Platform::WakeWaiters(Atomic<T> location, int num_waiters) {
-  assert_static(sizeof(T) == 2 * sizeof(int) || sizeof(T) == sizeof(int));
+void *Platform::AllocateHugePages(std::size_t size) {
+  void *address = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  return address == MAP_FAILED ? NULL : address;
+}
 
-  volatile int *uaddr;
-  if (sizeof(T) == 2 * sizeof(int)) {
-    uaddr = reinterpret_cast<volatile int *>(location.raw_location()) + 1;
-  } else {
-    uaddr = reinterpret_cast<volatile int *>(location.raw_location());
-  }
+bool Platform::AdviseHugePages(void *address, std::size_t size) {
+  return madvise(address, size, MADV_HUGEPAGE) == 0;
+}
 
-  int result = syscall(SYS_futex, uaddr, FUTEX_WAKE, num_waiters, NULL,
-                       NULL, 0);
+bool Platform::PreferNumaNode(void *address, std::size_t size, int node) {
+  // As many nodes as the kernel can be configured with; a mask wider
+  // than the kernel's is fine as long as the extra bits are clear.
+  const int kMaxNodes = 1024;
+  const int kBitsPerWord = sizeof(unsigned long) * 8;
+  if (node < 0 || node >= kMaxNodes) return false;
+
+  unsigned long mask[kMaxNodes / kBitsPerWord] = { 0 };
+  mask[node / kBitsPerWord] = 1UL << (node % kBitsPerWord);
+  // The kernel reads one bit less than `maxnode` says.
+  return syscall(SYS_mbind, address, size, MPOL_PREFERRED, mask,
+                 kMaxNodes + 1, 0) == 0;
+}
+
+bool Platform::InterleaveNumaNodes(void *address, std::size_t size) {
+  // Nodes we aren't allowed to use, or that don't exist, are dropped
+  // from the mask by the kernel.
+  unsigned long mask = ~0UL;
+  return syscall(SYS_mbind, address, size, MPOL_INTERLEAVE, &mask,
+                 sizeof(mask) * 8 + 1, 0) == 0;
+}
 
-  if (result != 0)
-    printf("woke %d workers %p\n", result, uaddr);
-  assert(result != -1);
-  (void) result;
+int Platform::CurrentNumaNode() {
+  unsigned cpu;
+  unsigned node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) return 0;
+  return static_cast<int>(node);
 }
 
 }
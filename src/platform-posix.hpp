@@ -3,8 +3,14 @@
 #endif
 
 #include <cassert>
+#include <fcntl.h>
 #include <pthread.h>
+#include <sched.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 namespace eelish {
@@ -33,16 +39,125 @@ class Mutex {
   pthread_mutex_t mutex_;
 };
 
+/// A per-thread slot for a pointer.  `destructor` is called with the
+/// thread's value when a thread that set a non-NULL value exits.
+class ThreadLocalKey {
+ public:
+  explicit inline ThreadLocalKey(void (*destructor)(void *)) {
+    int result = pthread_key_create(&key_, destructor);
+    assert(result == 0 && "pthread_key_create failed!");
+    (void) result;
+  }
+
+  inline void set(void *value) { pthread_setspecific(key_, value); }
+  inline void *get() const { return pthread_getspecific(key_); }
+
+ private:
+  pthread_key_t key_;
+};
+
 long Platform::CurrentTimeInUSec() {
-  struct timeval time;
-  gettimeofday(&time, NULL);
-  return time.tv_sec * 1000000 + time.tv_usec;
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+long Platform::CurrentTimeInNSec() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+  return time.tv_sec * 1000000000L + time.tv_nsec;
 }
 
 void Platform::Sleep(int usecs) {
   usleep(usecs);
 }
 
+void Platform::Yield() {
+  sched_yield();
+}
+
+void *Platform::AllocatePages(std::size_t size) {
+  void *address = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  return address == MAP_FAILED ? NULL : address;
+}
+
+void Platform::FreePages(void *address, std::size_t size) {
+  munmap(address, size);
+}
+
+/// Maps all of `fd` and closes it.  An empty file is first made `size`
+/// bytes long; a file that was just made longer reads as zeros.
+inline void *MapDescriptor(int fd, std::size_t size, std::size_t *out_size) {
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  std::size_t file_size = static_cast<std::size_t>(status.st_size);
+  if (file_size == 0) {
+    if (size == 0 || ftruncate(fd, size) != 0) {
+      close(fd);
+      return NULL;
+    }
+    file_size = size;
+  }
+
+  void *address = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) return NULL;
+  *out_size = file_size;
+  return address;
+}
+
+void *Platform::MapFile(const char *path, std::size_t size,
+                        std::size_t *out_size) {
+  // A new file is sparse: its pages are zeros till first written.
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd == -1) return NULL;
+  return MapDescriptor(fd, size, out_size);
+}
+
+void Platform::UnmapFile(void *address, std::size_t size) {
+  munmap(address, size);
+}
+
+int Platform::LockFile(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd == -1) return -1;
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void Platform::UnlockFile(int lock) {
+  // Closing the descriptor drops the lock.
+  close(lock);
+}
+
+void Platform::SyncFile(void *address, std::size_t size) {
+  msync(address, size, MS_SYNC);
+}
+
+void *Platform::MapSharedMemory(const char *name, std::size_t size,
+                                bool create, std::size_t *out_size) {
+  int flags = create ? O_RDWR | O_CREAT | O_EXCL : O_RDWR;
+  int fd = shm_open(name, flags, 0600);
+  if (fd == -1) return NULL;
+
+  // Whoever creates the object sizes it.  Till they have, it is empty,
+  // and an attach fails rather than size it.
+  return MapDescriptor(fd, create ? size : 0, out_size);
+}
+
+void Platform::UnlinkSharedMemory(const char *name) {
+  shm_unlink(name);
+}
+
 }
 
 #include "platform-linux.hpp"
@@ -1,20 +1,92 @@
 #ifndef __EELISH_PLATFORM__HPP
 #define __EELISH_PLATFORM__HPP
 
+#include <cstddef>
+
 #include "atomics.hpp"
 
 namespace eelish {
 
 class Platform {
  public:
+  /// Monotonic clocks, for measuring intervals; they don't go back
+  /// when the wall clock is set.  CurrentTimeInNSec isn't slewed by
+  /// NTP either.
   static inline long CurrentTimeInUSec();
+  static inline long CurrentTimeInNSec();
   static inline void Sleep(int usecs);
+  static inline void Yield();
+
+  /// Thin wrappers over futex(2).  FutexWait blocks as long as
+  /// `*address` is `expected`, but no longer than `timeout_usecs` if
+  /// it is positive, and returns false if it timed out.  FutexWake
+  /// wakes up at most `num_waiters` threads blocked on `address`.
+  /// ParkingLot (parking-lot.hpp) builds on these.
+  static inline bool FutexWait(volatile int32_t *address, int32_t expected,
+                               long timeout_usecs = -1);
+  static inline void FutexWake(volatile int32_t *address, int num_waiters);
+
+  /// `size` bytes of zeros straight from the kernel, page aligned.
+  /// Nothing backs a page till it is first touched, so allocating is
+  /// O(1) however large `size` is.  Returns NULL on failure.
+  static inline void *AllocatePages(std::size_t size);
+  static inline void FreePages(void *address, std::size_t size);
+
+  /// Like AllocatePages, but out of the explicitly reserved pool of
+  /// kHugePageSize pages (vm.nr_hugepages).  `size` must be a multiple
+  /// of kHugePageSize.  Returns NULL if the pool is too small.  Free
+  /// with FreePages.
+  static inline void *AllocateHugePages(std::size_t size);
+
+  /// Asks for pages from AllocatePages to be backed by transparent huge
+  /// pages.  Only the kHugePageSize aligned parts of the range can be.
+  static inline bool AdviseHugePages(void *address, std::size_t size);
+
+  /// Where pages that haven't been touched yet will come from, on a
+  /// machine with several NUMA nodes: preferably `node`, or spread
+  /// over all nodes page by page.  Both return false on failure, and
+  /// leave the pages where they would have been.
+  static inline bool PreferNumaNode(void *address, std::size_t size,
+                                    int node);
+  static inline bool InterleaveNumaNodes(void *address, std::size_t size);
+
+  /// The NUMA node the calling thread is running on just now.
+  static inline int CurrentNumaNode();
+
+  static const std::size_t kHugePageSize = 2 * 1024 * 1024;
+
+  /// Maps the file at `path` into memory, shared with every other
+  /// mapping of it.  A file that doesn't exist yet, or is empty, is
+  /// made `size` bytes long, all zeros; an existing file is mapped
+  /// whole.  Returns NULL on failure, and the number of bytes mapped
+  /// in `out_size` otherwise.
+  static inline void *MapFile(const char *path, std::size_t size,
+                              std::size_t *out_size);
+  static inline void UnmapFile(void *address, std::size_t size);
+
+  /// Takes an exclusive lock on the file at `path`, creating the file
+  /// if needed, without waiting for it.  Returns -1 if someone else
+  /// holds the lock (another process, or another LockFile in this
+  /// one) or the file can't be opened, and a handle to pass to
+  /// UnlockFile otherwise.  The lock goes away with the process.
+  static inline int LockFile(const char *path);
+  static inline void UnlockFile(int lock);
+
+  /// Writes a file mapping's dirty pages back to the file, so that
+  /// they survive the machine going down and not just the process.
+  static inline void SyncFile(void *address, std::size_t size);
 
-  template<typename T>
-  static void inline WaitOnMemory(Atomic<T> location, T current_value);
+  /// Maps the POSIX shared memory object `name` (which starts with a
+  /// slash) into memory.  With `create` the object must not exist yet,
+  /// and is made `size` bytes long, all zeros; otherwise it must, and
+  /// is mapped whole.  Returns NULL on failure, and the number of
+  /// bytes mapped in `out_size` otherwise.  Unmap with UnmapFile.
+  static inline void *MapSharedMemory(const char *name, std::size_t size,
+                                      bool create, std::size_t *out_size);
 
-  template<typename T>
-  static void inline WakeWaiters(Atomic<T> location, int num_waiters);
+  /// Removes `name`.  Whoever has it mapped keeps the memory till they
+  /// unmap it.
+  static inline void UnlinkSharedMemory(const char *name);
 };
 
 };
@@ -0,0 +1,108 @@
+#ifndef __EELISH_SHARDED_STACK__HPP
+#error "sharded-stack-inl.hpp can only be included from within \
+        sharded-stack.hpp"
+#endif
+
+namespace eelish {
+
+template<typename T, std::size_t Size, std::size_t Shards, typename Backoff>
+ShardedStack<T, Size, Shards, Backoff>::ShardedStack() {
+  assert_static(Size % Shards == 0);
+}
+
+template<typename T, std::size_t Size, std::size_t Shards, typename Backoff>
+std::size_t ShardedStack<T, Size, Shards, Backoff>::home_shard() {
+  static Atomic<Word> next_thread_number;
+  static __thread Word thread_number = ~static_cast<Word>(0);
+
+  if (unlikely(thread_number == ~static_cast<Word>(0))) {
+    thread_number = next_thread_number.fetch_add(1);
+  }
+  return thread_number % Shards;
+}
+
+template<typename T, std::size_t Size, std::size_t Shards, typename Backoff>
+std::size_t ShardedStack<T, Size, Shards, Backoff>::push_back(T *value) {
+  std::size_t home = home_shard();
+
+  for (std::size_t i = 0; i < Shards; i++) {
+    std::size_t shard = (home + i) % Shards;
+    std::size_t index = shards_[shard].vector.push_back(value);
+    if (index != static_cast<std::size_t>(-1)) {
+      return shard * kShardSize + index;
+    }
+  }
+
+  return -1;
+}
+
+template<typename T, std::size_t Size, std::size_t Shards, typename Backoff>
+T *ShardedStack<T, Size, Shards, Backoff>::pop_back(std::size_t *out_index) {
+  std::size_t home = home_shard();
+  std::size_t index;
+  T *value = shards_[home].vector.pop_back(&index);
+  if (!is_out_of_range(value)) {
+    if (out_index != NULL) *out_index = home * kShardSize + index;
+    return value;
+  }
+
+  // Stealing: we don't wait on another thread's shard.  Its tail being
+  // busy means its owner is using it, so we move on to the next one.
+  for (std::size_t i = 1; i < Shards; i++) {
+    std::size_t shard = (home + i) % Shards;
+    if (!shards_[shard].vector.try_pop_back(&value, &index)) continue;
+    if (!is_out_of_range(value)) {
+      if (out_index != NULL) *out_index = shard * kShardSize + index;
+      return value;
+    }
+  }
+
+  return reinterpret_cast<T *>(kOutOfRange);
+}
+
+template<typename T, std::size_t Size, std::size_t Shards, typename Backoff>
+std::size_t ShardedStack<T, Size, Shards, Backoff>::push_back_n(
+    T **values, std::size_t n) {
+  std::size_t home = home_shard();
+  std::size_t pushed = 0;
+
+  for (std::size_t i = 0; i < Shards && pushed < n; i++) {
+    std::size_t shard = (home + i) % Shards;
+    pushed += shards_[shard].vector.push_back_n(values + pushed, n - pushed);
+  }
+
+  return pushed;
+}
+
+template<typename T, std::size_t Size, std::size_t Shards, typename Backoff>
+std::size_t ShardedStack<T, Size, Shards, Backoff>::pop_back_n(
+    T **out, std::size_t max) {
+  std::size_t home = home_shard();
+  std::size_t popped = shards_[home].vector.pop_back_n(out, max);
+
+  // As in pop_back, we steal without waiting on other threads' shards.
+  for (std::size_t i = 1; i < Shards && popped < max; i++) {
+    std::size_t shard = (home + i) % Shards;
+    popped += shards_[shard].vector.try_pop_back_n(out + popped,
+                                                   max - popped);
+  }
+
+  return popped;
+}
+
+template<typename T, std::size_t Size, std::size_t Shards, typename Backoff>
+T *ShardedStack<T, Size, Shards, Backoff>::get(std::size_t index) {
+  if (index >= Size) return reinterpret_cast<T *>(kOutOfRange);
+  return shards_[index / kShardSize].vector.get(index % kShardSize);
+}
+
+template<typename T, std::size_t Size, std::size_t Shards, typename Backoff>
+std::size_t ShardedStack<T, Size, Shards, Backoff>::length() const {
+  std::size_t length = 0;
+  for (std::size_t i = 0; i < Shards; i++) {
+    length += shards_[i].vector.length();
+  }
+  return length;
+}
+
+}
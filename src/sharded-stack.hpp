@@ -0,0 +1,98 @@
+#ifndef __EELISH_SHARDED_STACK__HPP
+#define __EELISH_SHARDED_STACK__HPP
+
+#include "fixed-vector.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// A stack of `T *` split into `Shards` FixedVectors of `Size /
+/// Shards` slots each.
+///
+/// Every thread is handed a shard of its own (threads are numbered as
+/// they first use a ShardedStack of a given type, and thread `n` uses
+/// shard `n % Shards`), and pushes and pops go to that shard.
+/// Threads on different shards never touch the same length_, so they
+/// don't fight over its cache line the way they would on a single
+/// FixedVector.  A push finding its shard full tries the other shards
+/// in turn, and so does a pop finding its shard empty -- it steals
+/// from another thread's shard, skipping shards whose tail is busy
+/// rather than waiting on them.  A push fails only if every shard is
+/// full, and a pop only if every shard it looked at was empty or
+/// busy.
+///
+/// The price is a much weaker order: each shard is a FixedVector and
+/// keeps its guarantees, but there is no global LIFO order across
+/// shards.  A pop returns the latest value pushed by a thread on its
+/// own shard, not the latest value pushed overall, and may come back
+/// empty-handed while another shard is being filled.
+///
+/// Indices are global: slot `i` of shard `s` is index `s * (Size /
+/// Shards) + i`.  Unlike a FixedVector the occupied indices need not
+/// be contiguous, and length() (the sum of the shard lengths) is only
+/// exact when nothing else is running.
+///
+/// `Size` must be a multiple of `Shards`.
+template<typename T, std::size_t Size, std::size_t Shards = 16,
+         typename Backoff = SleepBackoff>
+class ShardedStack {
+ public:
+  ShardedStack();
+
+  /// Returns the index the value was pushed at, or -1 if every shard
+  /// is full.
+  std::size_t push_back(T *value);
+
+  /// Returns kOutOfRange if every shard was empty (or, other than
+  /// ours, busy) when we looked at it.
+  T *pop_back(std::size_t *out_index);
+
+  /// Batched operations use the pushing or popping thread's shard
+  /// first and spill over to (or steal from, skipping busy shards)
+  /// the others.
+  std::size_t push_back_n(T **values, std::size_t n);
+  std::size_t pop_back_n(T **out, std::size_t max);
+
+  T *get(std::size_t index);
+  std::size_t length() const;
+
+  /// See FixedVector.
+  inline T *get(std::size_t index, const EpochGuard &) { return get(index); }
+
+  inline T *retire_pop_back(std::size_t *out_index, const EpochGuard &) {
+    T *value = pop_back(out_index);
+    if (!is_out_of_range(value)) Epoch::Retire(value);
+    return value;
+  }
+
+  inline static bool is_inconsistent(T *value) {
+    return ShardVector::is_inconsistent(value);
+  }
+
+  inline static bool is_out_of_range(T *value) {
+    return ShardVector::is_out_of_range(value);
+  }
+
+ private:
+  static const std::size_t kShardSize = Size / Shards;
+  typedef FixedVector<T, kShardSize, Backoff> ShardVector;
+
+  /// Shards start on cache lines of their own, so that the tail of
+  /// one shard doesn't share a line with the length_ of the next.
+  struct Shard {
+    ShardVector vector;
+  } __attribute__((aligned(kCacheLineSize)));
+
+  /// The shard the calling thread pushes to and pops from first.
+  inline static std::size_t home_shard();
+
+  Shard shards_[Shards];
+
+  static const intptr_t kOutOfRange = -2;
+};
+
+}
+
+#include "sharded-stack-inl.hpp"
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef __EELISH_SHARED_FIXED_VECTOR__HPP
+#error "shared-fixed-vector-inl.hpp can only be included from within \
+        shared-fixed-vector.hpp"
+#endif
+
+namespace eelish {
+
+template<typename T, typename Backoff>
+std::size_t SharedFixedVector<T, Backoff>::ArenaOffset(std::size_t capacity) {
+  std::size_t end = sizeof(Header) + capacity * sizeof(Atomic<Word>);
+  return (end + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+}
+
+template<typename T, typename Backoff>
+std::size_t SharedFixedVector<T, Backoff>::SegmentSize(
+    std::size_t capacity, std::size_t arena_size) {
+  return ArenaOffset(capacity) + arena_size * sizeof(T);
+}
+
+template<typename T, typename Backoff>
+SharedFixedVector<T, Backoff> *SharedFixedVector<T, Backoff>::Create(
+    const std::string &name, std::size_t capacity, std::size_t arena_size) {
+  std::size_t size = SegmentSize(capacity, arena_size);
+  std::size_t mapped_size;
+  void *memory = Platform::MapSharedMemory(name.c_str(), size, true,
+                                           &mapped_size);
+  if (memory == NULL) return NULL;
+
+  // The segment starts out all zeros, which makes every slot unwritten
+  // and the length 0.  The magic goes in last, so that an Attach that
+  // sees it sees the rest of the header too.
+  Header *header = reinterpret_cast<Header *>(memory);
+  header->version = kVersion;
+  header->element_size = sizeof(T);
+  header->capacity = capacity;
+  header->arena_size = arena_size;
+  memory_fence();
+  header->magic = kMagic;
+
+  return new SharedFixedVector(header, mapped_size);
+}
+
+template<typename T, typename Backoff>
+SharedFixedVector<T, Backoff> *SharedFixedVector<T, Backoff>::Attach(
+    const std::string &name) {
+  std::size_t mapped_size;
+  void *memory = Platform::MapSharedMemory(name.c_str(), 0, false,
+                                           &mapped_size);
+  if (memory == NULL) return NULL;
+
+  Header *header = reinterpret_cast<Header *>(memory);
+  bool valid = mapped_size >= sizeof(Header) && header->magic == kMagic;
+  memory_fence();
+  valid = valid && header->version == kVersion &&
+      header->element_size == sizeof(T) &&
+      mapped_size == SegmentSize(header->capacity, header->arena_size);
+  if (!valid) {
+    Platform::UnmapFile(memory, mapped_size);
+    return NULL;
+  }
+
+  return new SharedFixedVector(header, mapped_size);
+}
+
+template<typename T, typename Backoff>
+void SharedFixedVector<T, Backoff>::Unlink(const std::string &name) {
+  Platform::UnlinkSharedMemory(name.c_str());
+}
+
+template<typename T, typename Backoff>
+SharedFixedVector<T, Backoff>::SharedFixedVector(Header *header,
+                                                 std::size_t mapped_size) :
+    header_(header),
+    mapped_size_(mapped_size),
+    arena_(reinterpret_cast<T *>(reinterpret_cast<char *>(header) +
+                                 ArenaOffset(header->capacity))),
+    vector_(&header->length, reinterpret_cast<Atomic<Word> *>(header + 1),
+            header->capacity) { }
+
+template<typename T, typename Backoff>
+SharedFixedVector<T, Backoff>::~SharedFixedVector() {
+  Platform::UnmapFile(header_, mapped_size_);
+}
+
+}
@@ -0,0 +1,114 @@
+#ifndef __EELISH_SHARED_FIXED_VECTOR__HPP
+#define __EELISH_SHARED_FIXED_VECTOR__HPP
+
+#include <string>
+
+#include "atomics.hpp"
+#include "backoff.hpp"
+#include "mapped-word-vector.hpp"
+#include "platform.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// A FixedVector of `T *` in POSIX shared memory, which any number of
+/// processes can attach to and push to and pop from concurrently.
+///
+/// Every process maps the segment at an address of its own, so a
+/// pointer one process pushes means nothing to the next.  The segment
+/// therefore has an arena of `T`s after the vector, and the vector
+/// (a MappedWordVector) holds indices into it: push_back takes a
+/// pointer into the caller's mapping of the arena, and pop_back and
+/// get hand one back into theirs.  `T` must be trivially copyable, and
+/// can't hold pointers either, for the same reason.
+///
+/// What the arena is for is up to the processes; typically whoever
+/// creates the segment pushes all of it, and the vector is then a
+/// free list the processes trade items through.
+///
+/// A process that dies in the middle of a push or pop leaves the
+/// vector wedged, just like a thread that dies would; unlike
+/// PersistentFixedVector there is no recovery.
+template<typename T, typename Backoff = SleepBackoff>
+class SharedFixedVector {
+ public:
+  /// Creates the segment `name` (see Platform::MapSharedMemory) with an
+  /// empty vector of `capacity` and an arena of `arena_size` zeroed
+  /// `T`s.  Returns NULL if `name` already exists or can't be created.
+  static SharedFixedVector *Create(const std::string &name,
+                                   std::size_t capacity,
+                                   std::size_t arena_size);
+
+  /// Attaches to the segment `name`.  Returns NULL if there is no such
+  /// segment, if it isn't a vector of `T`, or if its creator hasn't
+  /// finished creating it yet.
+  static SharedFixedVector *Attach(const std::string &name);
+
+  /// Removes the segment `name`; it is gone once every process that
+  /// has it attached has destroyed its SharedFixedVector.
+  static void Unlink(const std::string &name);
+
+  /// Unmaps the segment, which is left as it is.
+  ~SharedFixedVector();
+
+  /// Returns the index at which `item` is inserted, or -1 if the vector
+  /// is full.  `item` must point into arena().
+  inline std::size_t push_back(T *item) {
+    return vector_.push_back(static_cast<Word>(item - arena_));
+  }
+
+  /// Returns false if the vector is empty.  `out_index` may be NULL.
+  inline bool pop_back(T **out_item, std::size_t *out_index) {
+    Word offset;
+    if (!vector_.pop_back(&offset, out_index)) return false;
+    *out_item = arena_ + offset;
+    return true;
+  }
+
+  /// Returns false if there is no item at `index`, or if the item
+  /// there is still being pushed or being popped.
+  inline bool get(std::size_t index, T **out_item) {
+    Word offset;
+    if (!vector_.get(index, &offset)) return false;
+    *out_item = arena_ + offset;
+    return true;
+  }
+
+  T *arena() const { return arena_; }
+  std::size_t arena_size() const { return header_->arena_size; }
+
+  std::size_t length() const { return vector_.length(); }
+  std::size_t capacity() const { return vector_.capacity(); }
+
+ private:
+  struct Header {
+    Word magic;
+    Word version;
+    Word element_size;
+    Word capacity;
+    Word arena_size;
+
+    Atomic<Word> length;
+  } __attribute__((aligned(kCacheLineSize)));
+
+  /// The bytes a segment takes, and where in it the arena starts.
+  static std::size_t ArenaOffset(std::size_t capacity);
+  static std::size_t SegmentSize(std::size_t capacity,
+                                 std::size_t arena_size);
+
+  SharedFixedVector(Header *header, std::size_t mapped_size);
+
+  Header *header_;
+  std::size_t mapped_size_;
+  T *arena_;
+  MappedWordVector<Backoff> vector_;
+
+  static const Word kMagic = 0x454c4953485346ULL;   // "ELISHSF"
+  static const Word kVersion = 1;
+};
+
+}
+
+#include "shared-fixed-vector-inl.hpp"
+
+#endif
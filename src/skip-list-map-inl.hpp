@@ -0,0 +1,256 @@
+#ifndef __EELISH_SKIP_LIST_MAP__HPP
+#error "skip-list-map-inl.hpp can only be included from within \
+        skip-list-map.hpp"
+#endif
+
+#include <new>
+
+namespace eelish {
+
+template<typename K, typename V, typename Compare>
+SkipListMap<K, V, Compare>::SkipListMap() {
+  // The head never has its key looked at, so we don't construct one.
+  void *memory = operator new(sizeof(Node) +
+                              (kMaxHeight - 1) * sizeof(Atomic<Node *>));
+  head_ = static_cast<Node *>(memory);
+  head_->value = NULL;
+  head_->height = kMaxHeight;
+  head_->next_allocated = NULL;
+  for (int i = 0; i < kMaxHeight; i++) {
+    head_->next[i].raw_store(NULL);
+  }
+
+  allocated_.raw_store(NULL);
+}
+
+template<typename K, typename V, typename Compare>
+SkipListMap<K, V, Compare>::~SkipListMap() {
+  Node *node = allocated_.raw_load();
+  while (node != NULL) {
+    Node *next = node->next_allocated;
+    free_node(node);
+    node = next;
+  }
+
+  operator delete(head_);
+}
+
+template<typename K, typename V, typename Compare>
+typename SkipListMap<K, V, Compare>::Node *
+SkipListMap<K, V, Compare>::allocate_node(const K &key, V *value,
+                                          int height) {
+  void *memory = operator new(sizeof(Node) +
+                              (height - 1) * sizeof(Atomic<Node *>));
+  Node *node = static_cast<Node *>(memory);
+  new (&node->key) K(key);
+  node->value = value;
+  node->height = height;
+  return node;
+}
+
+template<typename K, typename V, typename Compare>
+void SkipListMap<K, V, Compare>::free_node(Node *node) {
+  node->key.~K();
+  operator delete(node);
+}
+
+template<typename K, typename V, typename Compare>
+int SkipListMap<K, V, Compare>::random_height() {
+  // Every thread gets its own generator, seeded off the address of
+  // its copy of `state`.
+  static __thread uint64_t state = 0;
+  if (unlikely(state == 0)) {
+    state = (reinterpret_cast<Word>(&state) * 0x9E3779B97F4A7C15ULL) | 1;
+  }
+
+  // Each level is half as likely as the one below it.
+  uint64_t bits = XorShiftRandom::Step(&state);
+  int height = 1 + __builtin_ctzll(~bits);
+  return height < kMaxHeight ? height : kMaxHeight;
+}
+
+template<typename K, typename V, typename Compare>
+bool SkipListMap<K, V, Compare>::find_position(const K &key, Node **preds,
+                                               Node **succs) {
+ retry:
+  Node *pred = head_;
+  Node *current = NULL;
+
+  for (int level = kMaxHeight - 1; level >= 0; level--) {
+    current = unmarked(pred->next[level].acquire_load());
+
+    while (current != NULL) {
+      Node *successor = current->next[level].acquire_load();
+
+      // `current` is being erased, unlink it from this level.
+      while (is_marked(successor)) {
+        if (!pred->next[level].boolean_cas(current, unmarked(successor))) {
+          goto retry;
+        }
+        current = unmarked(successor);
+        if (current == NULL) break;
+        successor = current->next[level].acquire_load();
+      }
+
+      if (current == NULL || !less(current->key, key)) break;
+
+      pred = current;
+      current = unmarked(successor);
+    }
+
+    preds[level] = pred;
+    succs[level] = current;
+  }
+
+  return current != NULL && equal(current->key, key);
+}
+
+template<typename K, typename V, typename Compare>
+typename SkipListMap<K, V, Compare>::Node *
+SkipListMap<K, V, Compare>::find_node(const K &key) {
+  Node *pred = head_;
+  Node *current = NULL;
+
+  for (int level = kMaxHeight - 1; level >= 0; level--) {
+    current = unmarked(pred->next[level].acquire_load());
+
+    while (current != NULL) {
+      Node *successor = current->next[level].acquire_load();
+
+      // Skip over nodes being erased.
+      while (is_marked(successor)) {
+        current = unmarked(successor);
+        if (current == NULL) break;
+        successor = current->next[level].acquire_load();
+      }
+
+      if (current == NULL || !less(current->key, key)) break;
+
+      pred = current;
+      current = unmarked(successor);
+    }
+  }
+
+  return current;
+}
+
+template<typename K, typename V, typename Compare>
+bool SkipListMap<K, V, Compare>::insert(const K &key, V *value) {
+  Node *preds[kMaxHeight];
+  Node *succs[kMaxHeight];
+  int height = random_height();
+  Node *node = NULL;
+
+  while (true) {
+    if (find_position(key, preds, succs)) {
+      if (node != NULL) free_node(node);
+      return false;
+    }
+
+    if (node == NULL) node = allocate_node(key, value, height);
+    for (int level = 0; level < height; level++) {
+      node->next[level].raw_store(succs[level]);
+    }
+
+    // Linking the bottom level is what inserts the node.
+    if (preds[0]->next[0].boolean_cas(succs[0], node)) break;
+  }
+
+  // From here on the node is reachable, remember to free it.
+  Node *allocated;
+  do {
+    allocated = allocated_.nobarrier_load();
+    node->next_allocated = allocated;
+  } while (!allocated_.boolean_cas(allocated, node));
+
+  for (int level = 1; level < height; level++) {
+    while (true) {
+      Node *next = node->next[level].acquire_load();
+
+      // Somebody is erasing the node already, don't bother linking it
+      // any further.
+      if (is_marked(next)) return true;
+
+      // Our successor on this level may have changed since we looked.
+      if (next != succs[level] &&
+          !node->next[level].boolean_cas(next, succs[level])) {
+        continue;
+      }
+
+      if (preds[level]->next[level].boolean_cas(succs[level], node)) break;
+      find_position(key, preds, succs);
+    }
+  }
+
+  return true;
+}
+
+template<typename K, typename V, typename Compare>
+V *SkipListMap<K, V, Compare>::erase(const K &key) {
+  Node *preds[kMaxHeight];
+  Node *succs[kMaxHeight];
+
+  if (!find_position(key, preds, succs)) {
+    return reinterpret_cast<V *>(kNotFound);
+  }
+
+  Node *node = succs[0];
+
+  // Mark the upper levels first, so that nobody links the node into
+  // them once it is gone from the bottom level.
+  for (int level = node->height - 1; level > 0; level--) {
+    Node *ignored;
+    while (!node->next[level].cas_prime(&ignored) &&
+           !is_marked(node->next[level].acquire_load())) { }
+  }
+
+  while (true) {
+    Node *ignored;
+    if (node->next[0].cas_prime(&ignored)) {
+      // We erased it.  Unlink it (find_position does that for us).
+      find_position(key, preds, succs);
+      return node->value;
+    }
+
+    // Someone else got there first.
+    if (is_marked(node->next[0].acquire_load())) {
+      return reinterpret_cast<V *>(kNotFound);
+    }
+  }
+}
+
+template<typename K, typename V, typename Compare>
+V *SkipListMap<K, V, Compare>::find(const K &key) {
+  Node *node = find_node(key);
+  if (node == NULL || !equal(node->key, key)) {
+    return reinterpret_cast<V *>(kNotFound);
+  }
+  return node->value;
+}
+
+template<typename K, typename V, typename Compare>
+typename SkipListMap<K, V, Compare>::Iterator
+SkipListMap<K, V, Compare>::lower_bound(const K &key) {
+  return Iterator(find_node(key));
+}
+
+template<typename K, typename V, typename Compare>
+typename SkipListMap<K, V, Compare>::Iterator
+SkipListMap<K, V, Compare>::begin() {
+  Iterator iterator(head_);
+  iterator.next();
+  return iterator;
+}
+
+template<typename K, typename V, typename Compare>
+void SkipListMap<K, V, Compare>::Iterator::next() {
+  Node *node = unmarked(node_->next[0].acquire_load());
+  while (node != NULL) {
+    Node *successor = node->next[0].acquire_load();
+    if (!is_marked(successor)) break;
+    node = unmarked(successor);
+  }
+  node_ = node;
+}
+
+}
@@ -0,0 +1,152 @@
+#ifndef __EELISH_SKIP_LIST_MAP__HPP
+#define __EELISH_SKIP_LIST_MAP__HPP
+
+#include <functional>
+
+#include "atomics.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// A lock-free ordered map from `K` to `V *`, implemented as a skip
+/// list.
+///
+/// This is the lock-free skip list from Herlihy and Shavit's "The Art
+/// of Multiprocessor Programming", with the usual fix for linking the
+/// upper levels of a node that is being erased concurrently.  A node
+/// is erased by marking its next pointers, top level first, with the
+/// low bit Atomic<T>::cas_prime sets; marking the bottom level is what
+/// logically removes the node.  Traversals skip marked nodes and
+/// modifications unlink them as they go past.
+///
+/// insert, erase and find are linearizable: insert at the CAS that
+/// links the node into the bottom level, erase at the CAS that marks
+/// the bottom level and find at the load that finds the node
+/// unmarked.
+///
+/// Nodes are never freed while the map is alive, they are only freed
+/// when the map itself is destroyed.  That is what makes it safe to
+/// hold on to an Iterator while other threads modify the map.  The
+/// flip side is that memory use grows with the number of inserts, not
+/// the number of keys in the map.
+///
+/// Iterators are weakly consistent: they never return an element
+/// twice, return elements in key order and return every element that
+/// is in the map for as long as the iteration lasts.  Elements
+/// inserted or erased during the iteration may or may not be seen.
+///
+/// `V *` must not collide with kNotFound.
+template<typename K, typename V, typename Compare = std::less<K> >
+class SkipListMap {
+  struct Node;
+
+ public:
+  class Iterator {
+   public:
+    inline Iterator() : node_(NULL) { }
+
+    inline bool is_end() const { return node_ == NULL; }
+    inline const K &key() const { return node_->key; }
+    inline V *value() const { return node_->value; }
+
+    /// Moves to the next element that isn't erased.
+    inline void next();
+
+    inline bool operator==(const Iterator &other) const {
+      return node_ == other.node_;
+    }
+
+    inline bool operator!=(const Iterator &other) const {
+      return node_ != other.node_;
+    }
+
+   private:
+    explicit inline Iterator(Node *node) : node_(node) { }
+
+    Node *node_;
+    friend class SkipListMap;
+  };
+
+  SkipListMap();
+  ~SkipListMap();
+
+  /// Maps `key` to `value` unless `key` is in the map already.
+  /// Returns true if `key` was inserted.
+  bool insert(const K &key, V *value);
+
+  /// Removes `key` from the map.  Returns the value it was mapped to,
+  /// or kNotFound if there was none.
+  V *erase(const K &key);
+
+  /// Returns the value `key` is mapped to, or kNotFound (check using
+  /// is_not_found).
+  V *find(const K &key);
+
+  /// Returns an iterator to the first element whose key is not less
+  /// than `key`.
+  Iterator lower_bound(const K &key);
+
+  Iterator begin();
+  inline Iterator end() { return Iterator(); }
+
+  inline static bool is_not_found(V *value) {
+    return reinterpret_cast<Word>(value) == kNotFound;
+  }
+
+  static const int kMaxHeight = 24;
+
+ private:
+  /// Nodes are allocated with as many next pointers as they are
+  /// high.  A NULL next pointer marks the end of a level.
+  struct Node {
+    K key;
+    V *value;
+    int height;
+
+    /// All nodes ever allocated, so that the destructor can free them.
+    Node *next_allocated;
+
+    Atomic<Node *> next[1];
+  };
+
+  Node *allocate_node(const K &key, V *value, int height);
+  void free_node(Node *node);
+
+  /// Fills `preds` and `succs` with the nodes just before and at (or
+  /// after) `key` on every level, unlinking marked nodes on the way.
+  /// Returns true if `succs[0]` holds `key`.
+  bool find_position(const K &key, Node **preds, Node **succs);
+
+  /// Returns the first unmarked node on the bottom level whose key is
+  /// not less than `key`, without unlinking anything.
+  Node *find_node(const K &key);
+
+  inline static bool is_marked(Node *pointer) {
+    return Atomic<Node *>::is_primed(pointer);
+  }
+
+  inline static Node *unmarked(Node *pointer) {
+    return reinterpret_cast<Node *>(reinterpret_cast<Word>(pointer) &
+                                    ~static_cast<Word>(1));
+  }
+
+  inline bool less(const K &a, const K &b) const { return compare_(a, b); }
+
+  inline bool equal(const K &a, const K &b) const {
+    return !compare_(a, b) && !compare_(b, a);
+  }
+
+  static int random_height();
+
+  Node *head_;
+  Atomic<Node *> allocated_;
+  Compare compare_;
+
+  static const Word kNotFound = ~static_cast<Word>(0);
+};
+
+}
+
+#include "skip-list-map-inl.hpp"
+
+#endif
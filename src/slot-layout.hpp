@@ -0,0 +1,71 @@
+#ifndef __EELISH_SLOT_LAYOUT__HPP
+#define __EELISH_SLOT_LAYOUT__HPP
+
+#include <cstddef>
+
+#include "atomics.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+// How a FixedVector lays out its length and slots.  A layout has
+//
+//   static const std::size_t kLengthAlignment;
+//   static std::size_t Slot(std::size_t index, std::size_t capacity);
+//
+// The length, and the fields after it, are aligned to
+// kLengthAlignment; at kCacheLineSize the length gets a line of its
+// own.  Slot maps an index to where its slot is in the buffer, and
+// must map [0, capacity) onto itself.  Every access goes through it,
+// so the mapping is invisible to users of the vector.
+
+/// The length shares a line with the vector's other fields, and
+/// consecutive indices share lines.  Smallest, and best for a vector
+/// that only one or two threads push to.
+struct PackedLayout {
+  static const std::size_t kLengthAlignment = sizeof(Word);
+
+  static inline std::size_t Slot(std::size_t index, std::size_t) {
+    return index;
+  }
+};
+
+/// The length gets a line of its own, so that the fields every
+/// operation reads (where the buffer is, its capacity) aren't
+/// invalidated by every push and pop.
+struct PaddedLayout {
+  static const std::size_t kLengthAlignment = kCacheLineSize;
+
+  static inline std::size_t Slot(std::size_t index, std::size_t) {
+    return index;
+  }
+};
+
+/// PaddedLayout, with the slots of every kSlotsPerLine consecutive
+/// indices on kSlotsPerLine different lines, so that threads pushing
+/// to and popping from neighbouring indices don't fight over a line.
+/// Within each aligned block of kSlotsPerLine lines, index
+/// `line * kSlotsPerLine + column` goes to `column * kSlotsPerLine +
+/// line`: a transpose, which is its own inverse.  The indices of a
+/// partial block at the end of the vector stay where they are.
+///
+/// pop_back_n and push_back_n touch a line per value instead of a
+/// line per kSlotsPerLine values.
+struct ScatteredLayout {
+  static const std::size_t kLengthAlignment = kCacheLineSize;
+  static const std::size_t kSlotsPerLine = kCacheLineSize / sizeof(Word);
+
+  static inline std::size_t Slot(std::size_t index, std::size_t capacity) {
+    const std::size_t kBlockSize = kSlotsPerLine * kSlotsPerLine;
+    std::size_t block = index - index % kBlockSize;
+    if (block + kBlockSize > capacity) return index;
+
+    std::size_t line = (index % kBlockSize) / kSlotsPerLine;
+    std::size_t column = index % kSlotsPerLine;
+    return block + column * kSlotsPerLine + line;
+  }
+};
+
+}
+
+#endif
@@ -0,0 +1,401 @@
+#include "tests.hpp"
+#include "bounded-queue.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+
+#include "locks.hpp"
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const int kQueueSize = 1024;
+const int kItemCount = 2 * 1024 * 1024;
+const int kLatencyItemCount = 64 * 1024;
+const int kMaxThreads = 128;
+
+// We will compare the performance of BoundedQueue with a std::deque
+// behind a lock, which is what we'd use otherwise.
+
+template<typename T, size_t Size>
+class NaiveQueue {
+ public:
+  bool try_enqueue(T *value) {
+    MutexLocker<> lock(&mutex_);
+    if (deque_.size() == Size) return false;
+    deque_.push_back(value);
+    return true;
+  }
+
+  bool try_dequeue(T **out_value) {
+    MutexLocker<> lock(&mutex_);
+    if (deque_.empty()) return false;
+    *out_value = deque_.front();
+    deque_.pop_front();
+    return true;
+  }
+
+  void enqueue(T *value) {
+    while (!try_enqueue(value)) Platform::Yield();
+  }
+
+  T *dequeue() {
+    T *value;
+    while (!try_dequeue(&value)) Platform::Yield();
+    return value;
+  }
+
+  size_t size() {
+    MutexLocker<> lock(&mutex_);
+    return deque_.size();
+  }
+
+ private:
+  std::deque<T *> deque_;
+  Mutex mutex_;
+};
+
+// BoundedQueue with a backoff policy that parks, which the default
+// doesn't.
+
+template<typename T, size_t Size>
+class AdaptiveBoundedQueue : public BoundedQueue<T, Size, AdaptiveBackoff> {
+};
+
+
+template<template<typename T, size_t S> class Queue>
+struct QueueNamePrefix;
+
+template<>
+struct QueueNamePrefix<BoundedQueue> {
+  static string prefix() { return "bounded-queue-"; }
+};
+
+template<>
+struct QueueNamePrefix<AdaptiveBoundedQueue> {
+  static string prefix() { return "bounded-queue-adaptive-"; }
+};
+
+template<>
+struct QueueNamePrefix<NaiveQueue> {
+  static string prefix() { return "naive-queue-"; }
+};
+
+
+/// Splits the threads into producers and consumers, the first half
+/// (rounded up) producing.  A lone thread does both.
+template<template<typename T, size_t S> class Queue>
+class QueueTest : public ThreadedTest {
+ public:
+  explicit QueueTest(const string &subname) :
+      ThreadedTest(QueueNamePrefix<Queue>::prefix() + subname) {
+  }
+
+ protected:
+  typedef Queue<long, kQueueSize> QueueType;
+
+  virtual void synch_init() {
+    queue_ = new QueueType;
+    next_thread_id_.raw_store(0);
+  }
+
+  virtual void synch_destroy() {
+    delete queue_;
+  }
+
+  int thread_id() {
+    return static_cast<int>(next_thread_id_.fetch_add(1));
+  }
+
+  int producer_count() const {
+    return (ThreadedTest::get_thread_count() + 1) / 2;
+  }
+
+  int consumer_count() const {
+    return ThreadedTest::get_thread_count() / 2;
+  }
+
+  QueueType *queue_;
+  Atomic<Word> next_thread_id_;
+};
+
+
+/// Producers enqueue their share of kItemCount items, consumers
+/// dequeue them, both using the blocking operations.  Items carry the
+/// producer that sent them and a per-producer sequence number: every
+/// consumer must see each producer's items in order, and all items
+/// must arrive.
+template<template<typename T, size_t S> class Queue>
+class ThroughputTest : public QueueTest<Queue> {
+ public:
+  ThroughputTest() : QueueTest<Queue>("throughput") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int id = QueueTest<Queue>::thread_id();
+    int producers = QueueTest<Queue>::producer_count();
+    int consumers = QueueTest<Queue>::consumer_count();
+    int per_producer = kItemCount / producers;
+
+    if (consumers == 0) {
+      // We're alone, so we had better not block.
+      int last = -1;
+      for (int i = 0; i < per_producer; i++) {
+        QueueTest<Queue>::queue_->enqueue(encode(0, i));
+        long *value = QueueTest<Queue>::queue_->dequeue();
+        check_i(sequence_of(value), ==, last + 1, return false);
+        last = sequence_of(value);
+        sum_.fetch_add(last);
+      }
+      return true;
+    }
+
+    if (id < producers) {
+      for (int i = 0; i < per_producer; i++) {
+        QueueTest<Queue>::queue_->enqueue(encode(id, i));
+      }
+      return true;
+    }
+
+    // Consumers split the items between them, the first one taking
+    // what doesn't divide evenly.
+    int total = per_producer * producers;
+    int consumer = id - producers;
+    int to_consume = total / consumers;
+    if (consumer == 0) to_consume += total % consumers;
+
+    int last[kMaxThreads];
+    fill(last, last + producers, -1);
+    Word sum = 0;
+
+    for (int i = 0; i < to_consume; i++) {
+      long *value = QueueTest<Queue>::queue_->dequeue();
+      int producer = producer_of(value);
+      check_i(producer, <, producers, return false);
+      check_i(sequence_of(value), >, last[producer], return false);
+      last[producer] = sequence_of(value);
+      sum += sequence_of(value);
+    }
+
+    sum_.fetch_add(sum);
+    return true;
+  }
+
+  static long *encode(int producer, int sequence) {
+    return to_pointer(sequence * kMaxThreads + producer);
+  }
+
+  static int producer_of(long *value) {
+    return to_integer(value) % kMaxThreads;
+  }
+
+  static int sequence_of(long *value) {
+    return to_integer(value) / kMaxThreads;
+  }
+
+  virtual void synch_init() {
+    QueueTest<Queue>::synch_init();
+    sum_.raw_store(0);
+  }
+
+  virtual bool synch_verify() {
+    Word producers = QueueTest<Queue>::producer_count();
+    Word per_producer = kItemCount / producers;
+    Word expected = producers * (per_producer * (per_producer - 1) / 2);
+
+    check_i(sum_.raw_load(), ==, expected, return false);
+    check_i(QueueTest<Queue>::queue_->size(), ==, 0, return false);
+    return true;
+  }
+
+  Atomic<Word> sum_;
+};
+
+
+/// Measures how long an item spends between the start of its enqueue
+/// and the end of its dequeue, using the non-blocking operations.
+/// Prints the mean and the maximum.
+template<template<typename T, size_t S> class Queue>
+class LatencyTest : public QueueTest<Queue> {
+ public:
+  LatencyTest() : QueueTest<Queue>("latency") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int id = QueueTest<Queue>::thread_id();
+    int producers = QueueTest<Queue>::producer_count();
+    int consumers = QueueTest<Queue>::consumer_count();
+
+    if (consumers == 0) {
+      for (int i = 0; i < kLatencyItemCount; i++) {
+        if (!produce(i)) return false;
+        if (!consume()) return false;
+      }
+      return true;
+    }
+
+    if (id < producers) {
+      for (int i = id; i < kLatencyItemCount; i += producers) {
+        if (!produce(i)) return false;
+      }
+      return true;
+    }
+
+    while (consumed_.nobarrier_load() < kLatencyItemCount) {
+      if (!consume()) return false;
+    }
+    return true;
+  }
+
+  bool produce(int item) {
+    sent_at_[item] = Platform::CurrentTimeInUSec();
+    while (!QueueTest<Queue>::queue_->try_enqueue(to_pointer(item))) {
+      Platform::Yield();
+    }
+    return true;
+  }
+
+  bool consume() {
+    long *value;
+    if (!QueueTest<Queue>::queue_->try_dequeue(&value)) {
+      Platform::Yield();
+      return true;
+    }
+
+    int item = to_integer(value);
+    check_i(item, <, kLatencyItemCount, return false);
+
+    Word latency = Platform::CurrentTimeInUSec() - sent_at_[item];
+    total_latency_.fetch_add(latency);
+    Word max = max_latency_.nobarrier_load();
+    while (latency > max && !max_latency_.boolean_cas(max, latency)) {
+      max = max_latency_.nobarrier_load();
+    }
+
+    consumed_.fetch_add(1);
+    return true;
+  }
+
+  virtual void synch_init() {
+    QueueTest<Queue>::synch_init();
+    sent_at_ = new long[kLatencyItemCount];
+    consumed_.raw_store(0);
+    total_latency_.raw_store(0);
+    max_latency_.raw_store(0);
+  }
+
+  virtual void synch_destroy() {
+    delete[] sent_at_;
+    QueueTest<Queue>::synch_destroy();
+  }
+
+  virtual bool synch_verify() {
+    check_i(consumed_.raw_load(), ==, kLatencyItemCount, return false);
+    ThreadedTest::output("mean latency %.2f us, max %lu us\n",
+                         static_cast<double>(total_latency_.raw_load()) /
+                         kLatencyItemCount,
+                         max_latency_.raw_load());
+    return true;
+  }
+
+  long *sent_at_;
+  Atomic<Word> consumed_;
+  Atomic<Word> total_latency_;
+  Atomic<Word> max_latency_;
+};
+
+
+struct TestConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  bool quiet;
+  bool throughput;
+  bool latency;
+  string test_type;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["quiet"].type = CommandLine::BOOL;
+    arg_info["quiet"].boolean = false;
+
+    arg_info["throughput"].type = CommandLine::BOOL;
+    arg_info["throughput"].boolean = true;
+
+    arg_info["latency"].type = CommandLine::BOOL;
+    arg_info["latency"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        min(kMaxThreads, CpuTopology::Get().default_thread_count());
+
+    arg_info["test-type"].type = CommandLine::STRING;
+    arg_info["test-type"].string = "real";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    quiet = arg_info["quiet"].boolean;
+    throughput = arg_info["throughput"].boolean;
+    latency = arg_info["latency"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+    test_type = arg_info["test-type"].string;
+  }
+};
+
+template<template<typename T, size_t S> class Queue>
+bool run_with_thread_count(TestConfig *config, int thread_count) {
+  bool quiet = config->quiet;
+  bool result = true;
+
+  if (config->throughput) {
+    result &= ThroughputTest<Queue>().execute(quiet, thread_count);
+  }
+  if (config->latency) {
+    result &= LatencyTest<Queue>().execute(quiet, thread_count);
+  }
+
+  return result;
+}
+
+
+template<template<typename T, size_t S> class Queue>
+bool run_tests_on_container(TestConfig *config) {
+  for (int i = config->thread_count_lower;
+       i <= config->thread_count_upper;
+       i++) {
+    if (!run_with_thread_count<Queue>(config, i)) return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+  TestConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  bool success = true;
+  if (config.test_type == "real") {
+    success = run_tests_on_container<BoundedQueue>(&config);
+  } else if (config.test_type == "real-adaptive") {
+    success = run_tests_on_container<AdaptiveBoundedQueue>(&config);
+  } else if (config.test_type == "fake") {
+    success = run_tests_on_container<NaiveQueue>(&config);
+  } else {
+    cerr << "unknown test type `" << config.test_type << "`" << endl;
+  }
+
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
+  if (!success) return 1;
+  return 0;
+}
@@ -0,0 +1,382 @@
+#include "tests.hpp"
+#include "concurrent-hash-map.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <unordered_map>
+
+#include "locks.hpp"
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const int kCapacity = 256 * 1024;
+const int kKeyCount = 64 * 1024;
+const int kOperationCount = 4 * 1024 * 1024;
+
+long *key_for(int i) { return to_pointer(i + 1); }
+long *value_for(int i) { return to_pointer(kKeyCount + i); }
+
+// We will compare the performance of ConcurrentHashMap with a
+// std::unordered_map behind a lock.
+
+template<typename K, typename V, size_t Capacity>
+class NaiveHashMap {
+ public:
+  V *get(K *key) {
+    MutexLocker<> lock(&mutex_);
+    typename unordered_map<K *, V *>::iterator i = map_.find(key);
+    if (i == map_.end()) return reinterpret_cast<V *>(kNotFound);
+    return i->second;
+  }
+
+  bool insert(K *key, V *value) {
+    MutexLocker<> lock(&mutex_);
+    if (map_.size() == Capacity) return false;
+    return map_.insert(make_pair(key, value)).second;
+  }
+
+  V *erase(K *key) {
+    MutexLocker<> lock(&mutex_);
+    typename unordered_map<K *, V *>::iterator i = map_.find(key);
+    if (i == map_.end()) return reinterpret_cast<V *>(kNotFound);
+    V *value = i->second;
+    map_.erase(i);
+    return value;
+  }
+
+  inline static bool is_not_found(V *value) {
+    return reinterpret_cast<Word>(value) == kNotFound;
+  }
+
+ private:
+  unordered_map<K *, V *> map_;
+  Mutex mutex_;
+
+  static const Word kNotFound = ~static_cast<Word>(0);
+};
+
+
+template<template<typename K, typename V, size_t C> class Map>
+struct MapNamePrefix;
+
+template<>
+struct MapNamePrefix<ConcurrentHashMap> {
+  static string prefix() { return "concurrent-hash-map-"; }
+};
+
+template<>
+struct MapNamePrefix<NaiveHashMap> {
+  static string prefix() { return "naive-hash-map-"; }
+};
+
+
+template<template<typename K, typename V, size_t C> class Map>
+class HashMapTest : public ThreadedTest {
+ public:
+  explicit HashMapTest(const string &subname) :
+    ThreadedTest(MapNamePrefix<Map>::prefix() + subname) {
+  }
+
+ protected:
+  typedef Map<long, long, kCapacity> MapType;
+
+  virtual void synch_init() {
+    map_ = new MapType;
+    next_thread_id_.raw_store(0);
+  }
+
+  virtual void synch_destroy() {
+    delete map_;
+  }
+
+  /// Gives each thread a distinct id in [0, thread count).
+  int thread_id() {
+    return static_cast<int>(next_thread_id_.fetch_add(1));
+  }
+
+  /// Any value we find for a key must be the one we map it to.
+  bool check_value(int key, long *value) {
+    if (MapType::is_not_found(value)) return true;
+    check_i(to_integer(value), ==, to_integer(value_for(key)),
+            return false);
+    return true;
+  }
+
+  MapType *map_;
+  Atomic<Word> next_thread_id_;
+};
+
+
+/// Threads insert disjoint ranges of keys and read them back.
+template<template<typename K, typename V, size_t C> class Map>
+class InsertGetTest : public HashMapTest<Map> {
+ public:
+  InsertGetTest() : HashMapTest<Map>("insert-get") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int per_thread_keys = kKeyCount / thread_count;
+    int begin = HashMapTest<Map>::thread_id() * per_thread_keys;
+
+    for (int i = begin; i < begin + per_thread_keys; i++) {
+      check_i(HashMapTest<Map>::map_->insert(key_for(i), value_for(i)), ==,
+              true, return false);
+    }
+
+    for (int i = begin; i < begin + per_thread_keys; i++) {
+      long *value = HashMapTest<Map>::map_->get(key_for(i));
+      check_i(to_integer(value), ==, to_integer(value_for(i)),
+              return false);
+    }
+
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int key_count = (kKeyCount / thread_count) * thread_count;
+
+    for (int i = 0; i < key_count; i++) {
+      long *value = HashMapTest<Map>::map_->get(key_for(i));
+      check_i(to_integer(value), ==, to_integer(value_for(i)),
+              return false);
+    }
+
+    return true;
+  }
+};
+
+
+/// All threads race to insert and erase the same keys.  Every
+/// successful insert but the ones whose keys are still in the map at
+/// the end must be matched by exactly one successful erase.
+template<template<typename K, typename V, size_t C> class Map>
+class InsertEraseTest : public HashMapTest<Map> {
+ public:
+  InsertEraseTest() : HashMapTest<Map>("insert-erase") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int start = HashMapTest<Map>::thread_id() * kStride;
+    Word inserts = 0;
+    Word erases = 0;
+
+    for (int i = 0; i < kKeyCount; i++) {
+      int key = (start + i) % kKeyCount;
+      if (HashMapTest<Map>::map_->insert(key_for(key), value_for(key))) {
+        inserts++;
+      }
+
+      int erase_key = (key + kKeyCount / 2) % kKeyCount;
+      long *value = HashMapTest<Map>::map_->erase(key_for(erase_key));
+      if (!Map<long, long, kCapacity>::is_not_found(value)) {
+        if (!HashMapTest<Map>::check_value(erase_key, value)) return false;
+        erases++;
+      }
+    }
+
+    successful_inserts_.fetch_add(inserts);
+    successful_erases_.fetch_add(erases);
+    return true;
+  }
+
+  virtual void synch_init() {
+    HashMapTest<Map>::synch_init();
+    successful_inserts_.raw_store(0);
+    successful_erases_.raw_store(0);
+  }
+
+  virtual bool synch_verify() {
+    Word present = 0;
+    for (int i = 0; i < kKeyCount; i++) {
+      long *value = HashMapTest<Map>::map_->get(key_for(i));
+      if (!HashMapTest<Map>::check_value(i, value)) return false;
+      if (!Map<long, long, kCapacity>::is_not_found(value)) present++;
+    }
+
+    check_i(successful_inserts_.raw_load() - successful_erases_.raw_load(),
+            ==, present, return false);
+    return true;
+  }
+
+  static const int kStride = 997;
+  Atomic<Word> successful_inserts_;
+  Atomic<Word> successful_erases_;
+};
+
+
+/// Runs a random mix of operations over a map that starts out half
+/// full.  Used to measure throughput of read-mostly, write-heavy and
+/// mixed workloads.
+template<template<typename K, typename V, size_t C> class Map>
+class WorkloadTest : public HashMapTest<Map> {
+ public:
+  WorkloadTest(const string &name, int get_percent, int insert_percent) :
+      HashMapTest<Map>(name),
+      get_percent_(get_percent),
+      insert_percent_(insert_percent) { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int iterations = kOperationCount / thread_count;
+    XorShiftRandom random(reinterpret_cast<Word>(&iterations));
+
+    for (int i = 0; i < iterations; i++) {
+      Word choice = random.next();
+      int key = static_cast<int>((choice >> 32) % kKeyCount);
+      int operation = static_cast<int>((choice >> 8) % 100);
+
+      if (operation < get_percent_) {
+        long *value = HashMapTest<Map>::map_->get(key_for(key));
+        if (!HashMapTest<Map>::check_value(key, value)) return false;
+      } else if (operation < get_percent_ + insert_percent_) {
+        HashMapTest<Map>::map_->insert(key_for(key), value_for(key));
+      } else {
+        long *value = HashMapTest<Map>::map_->erase(key_for(key));
+        if (!HashMapTest<Map>::check_value(key, value)) return false;
+      }
+    }
+
+    return true;
+  }
+
+  virtual void synch_init() {
+    HashMapTest<Map>::synch_init();
+    for (int i = 0; i < kKeyCount; i += 2) {
+      HashMapTest<Map>::map_->insert(key_for(i), value_for(i));
+    }
+  }
+
+  virtual bool synch_verify() {
+    for (int i = 0; i < kKeyCount; i++) {
+      long *value = HashMapTest<Map>::map_->get(key_for(i));
+      if (!HashMapTest<Map>::check_value(i, value)) return false;
+    }
+    return true;
+  }
+
+  int get_percent_;
+  int insert_percent_;
+};
+
+
+struct TestConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  bool quiet;
+  bool insert_get;
+  bool insert_erase;
+  bool read_mostly;
+  bool write_heavy;
+  bool mixed;
+  string test_type;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["quiet"].type = CommandLine::BOOL;
+    arg_info["quiet"].boolean = false;
+
+    arg_info["insert-get"].type = CommandLine::BOOL;
+    arg_info["insert-get"].boolean = true;
+
+    arg_info["insert-erase"].type = CommandLine::BOOL;
+    arg_info["insert-erase"].boolean = true;
+
+    arg_info["read-mostly"].type = CommandLine::BOOL;
+    arg_info["read-mostly"].boolean = true;
+
+    arg_info["write-heavy"].type = CommandLine::BOOL;
+    arg_info["write-heavy"].boolean = true;
+
+    arg_info["mixed"].type = CommandLine::BOOL;
+    arg_info["mixed"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        CpuTopology::Get().default_thread_count();
+
+    arg_info["test-type"].type = CommandLine::STRING;
+    arg_info["test-type"].string = "real";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    quiet = arg_info["quiet"].boolean;
+    insert_get = arg_info["insert-get"].boolean;
+    insert_erase = arg_info["insert-erase"].boolean;
+    read_mostly = arg_info["read-mostly"].boolean;
+    write_heavy = arg_info["write-heavy"].boolean;
+    mixed = arg_info["mixed"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+    test_type = arg_info["test-type"].string;
+  }
+};
+
+template<template<typename K, typename V, size_t C> class Map>
+bool run_with_thread_count(TestConfig *config, int thread_count) {
+  bool quiet = config->quiet;
+  bool result = true;
+
+  if (config->insert_get) {
+    result &= InsertGetTest<Map>().execute(quiet, thread_count);
+  }
+  if (config->insert_erase) {
+    result &= InsertEraseTest<Map>().execute(quiet, thread_count);
+  }
+  if (config->read_mostly) {
+    result &= WorkloadTest<Map>("read-mostly", 90, 5).execute(quiet,
+                                                              thread_count);
+  }
+  if (config->write_heavy) {
+    result &= WorkloadTest<Map>("write-heavy", 10, 45).execute(quiet,
+                                                               thread_count);
+  }
+  if (config->mixed) {
+    result &= WorkloadTest<Map>("mixed", 50, 25).execute(quiet,
+                                                         thread_count);
+  }
+
+  return result;
+}
+
+
+template<template<typename K, typename V, size_t C> class Map>
+bool run_tests_on_container(TestConfig *config) {
+  for (int i = config->thread_count_lower;
+       i <= config->thread_count_upper;
+       i++) {
+    if (!run_with_thread_count<Map>(config, i)) return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+  TestConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  bool success = true;
+  if (config.test_type == "real") {
+    success = run_tests_on_container<ConcurrentHashMap>(&config);
+  } else if (config.test_type == "fake") {
+    success = run_tests_on_container<NaiveHashMap>(&config);
+  } else {
+    cerr << "unknown test type `" << config.test_type << "`" << endl;
+  }
+
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
+  if (!success) return 1;
+  return 0;
+}
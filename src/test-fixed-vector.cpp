@@ -1,97 +1,33 @@
 #include "tests.hpp"
+#include "epoch.hpp"
 #include "fixed-vector.hpp"
+#include "fixed-vector-variants.hpp"
 
 #include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <map>
+#include <vector>
 
 #include "locks.hpp"
+#include "topology.hpp"
 
 using namespace eelish;
 using namespace std;
 
 namespace {
 
-/// Instead of malloc'ing all the time, we simply cast integers to
-/// pointers.  FixedVector assumes things about how a pointer looks,
-/// so we need to shuffle some bits around.
-long *to_pointer(int value) {
-  intptr_t large_value = static_cast<intptr_t>(value);
-  return reinterpret_cast<long *>(large_value << 2);
-}
-
-int to_integer(long *pointer) {
-  intptr_t integral_value = reinterpret_cast<intptr_t>(pointer);
-  return static_cast<int>(integral_value >> 2);
-}
-
 const int kVectorSize = 4 * 1024 * 1024;
 const int kSampleValue = 4242;
 
-// We will compare the performance of FixedVector with a naive locked
-// implementation.
-
-template<typename T, size_t Size>
-class NaiveFixedVector {
- public:
-  NaiveFixedVector() : length_(0) { }
-
-  size_t push_back(T *value) {
-    assert(length_ < Size);
-    MutexLocker lock(&mutex_);
-    buffer_[length_] = value;
-    return length_++;
-  }
-
-  T *pop_back(size_t *out_index) {
-    MutexLocker lock(&mutex_);
-    assert(length_ > 0);
-    T *value = buffer_[--length_];
-    if (out_index != NULL) *out_index = length_;
-    return value;
-  }
-
-  T *get(size_t index) {
-    MutexLocker lock(&mutex_);
-    if (index < length_) {
-      return buffer_[index];
-    } else {
-      return reinterpret_cast<T *>(kOutOfRange);
-    }
-  }
-
-  size_t length() const { return length_; }
-
-  inline static bool is_consistent(T *) { return true; }
-  inline static bool is_out_of_range(T *value) {
-    return (reinterpret_cast<intptr_t>(value) & (~kBitMask)) ==
-        (kOutOfRange & (~kBitMask));
-  }
-
- private:
-  size_t length_;
-  T *buffer_[Size];
-  Mutex mutex_;
-
-  static const intptr_t kOutOfRange = -2;
-  static const intptr_t kBitMask = 3;
-};
-
-
-template<template<typename T, size_t S> class Vec>
-struct VectorNamePrefix;
-
-template<>
-struct VectorNamePrefix<FixedVector> {
-  static string prefix() { return "fixed-vector-"; }
-};
-
-template<>
-struct VectorNamePrefix<NaiveFixedVector> {
-  static string prefix() { return "naive-vector-"; }
+// Operations whose latencies are sampled, see OperationLatencies.
+enum Operation {
+  kPush,
+  kPop,
+  kGet
 };
 
+const char *const kOperationNames[] = { "push", "pop", "get", NULL };
 
 template<template<typename T, size_t S> class Vec>
 class FixedVectorTest : public ThreadedTest {
@@ -106,6 +42,9 @@ class FixedVectorTest : public ThreadedTest {
   }
 
   virtual void synch_destroy() {
+    if (ContentionStatsOf<Vec>::kCounted) {
+      ThreadedTest::report_contention(ContentionStatsOf<Vec>::Get(vector_));
+    }
     delete vector_;
   }
 
@@ -124,6 +63,22 @@ class FixedVectorTest : public ThreadedTest {
       ;
   }
 
+  void definite_push_n(long **values, size_t n) {
+    while (n != 0) {
+      size_t pushed = vector_->push_back_n(values, n);
+      values += pushed;
+      n -= pushed;
+    }
+  }
+
+  void definite_pop_n(long **out, size_t n) {
+    while (n != 0) {
+      size_t popped = vector_->pop_back_n(out, n);
+      out += popped;
+      n -= popped;
+    }
+  }
+
   Vec<long, kVectorSize> *vector_;
 };
 
@@ -169,36 +124,225 @@ class PushOnlyTest : public FixedVectorTest<Vec> {
 };
 
 
+/// Every thread keeps pushing a little beyond its share of the
+/// vector.  Exactly kVectorSize of the pushes should succeed.
+template<template<typename T, size_t S> class Vec>
+class PushOverflowTest : public FixedVectorTest<Vec> {
+ public:
+  PushOverflowTest() : FixedVectorTest<Vec>("push-overflow") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int iterations = kVectorSize / thread_count + kExtraPushes;
+
+    int successful = 0;
+    for (int i = 0; i < iterations; i++) {
+      size_t index =
+          FixedVectorTest<Vec>::vector_->push_back(to_pointer(kSampleValue));
+      if (index != static_cast<size_t>(-1)) {
+        check_i(index, <, kVectorSize, return false);
+        successful++;
+      }
+    }
+
+    successful_pushes_.fetch_add(successful);
+    return true;
+  }
+
+  virtual void synch_init() {
+    FixedVectorTest<Vec>::synch_init();
+    successful_pushes_.raw_store(0);
+  }
+
+  virtual bool synch_verify() {
+    check_i(successful_pushes_.raw_load(), ==, kVectorSize, return false);
+    check_i(FixedVectorTest<Vec>::vector_->length(), ==, kVectorSize,
+            return false);
+
+    for (size_t i = 0; i < kVectorSize; i++) {
+      check_i(FixedVectorTest<Vec>::vector_->get(i), ==,
+              to_pointer(kSampleValue), return false);
+    }
+
+    return true;
+  }
+
+  Atomic<Word> successful_pushes_;
+  static const int kExtraPushes = 1024;
+};
+
+
 template<template<typename T, size_t S> class Vec>
 class PushPopTest : public FixedVectorTest<Vec> {
  public:
-  PushPopTest() : FixedVectorTest<Vec>("push-pop") { }
+  explicit PushPopTest(int latency_sample_period) :
+      FixedVectorTest<Vec>("push-pop"),
+      latency_sample_period_(latency_sample_period) { }
 
  protected:
   virtual bool threaded_test() {
     int thread_count = ThreadedTest::get_thread_count();
     int per_thread_slots = kVectorSize  / thread_count;
     int iterations = per_thread_slots / kContiguity;
+    OperationLatencies latencies(latency_sample_period_);
 
     for (int i = 0; i < iterations; i++) {
       for (int j = 0; j <  kContiguity; j++) {
-        FixedVectorTest<Vec>::definite_push(kSampleValue);
+        time_sampled(latencies, kPush,
+                     FixedVectorTest<Vec>::definite_push(kSampleValue));
       }
       for (int j = 0; j < kContiguity; j++) {
-        int popped_value = FixedVectorTest<Vec>::definite_pop();
+        int popped_value;
+        time_sampled(latencies, kPop,
+                     popped_value = FixedVectorTest<Vec>::definite_pop());
         check_i(popped_value, ==, kSampleValue, return false);
       }
     }
 
+    if (latency_sample_period_ != 0) {
+      ThreadedTest::add_thread_latencies(latencies);
+    }
     return true;
   }
 
   virtual bool synch_verify() {
     check_i(FixedVectorTest<Vec>::vector_->length(), ==, 0, return false);
+    if (latency_sample_period_ != 0) {
+      ThreadedTest::report_latencies(kOperationNames);
+    }
     return true;
   }
 
   static const int kContiguity = 8;
+  int latency_sample_period_;
+};
+
+
+/// Same as PushPopTest, but pushes and pops kContiguity elements at a
+/// time with push_back_n and pop_back_n.  Every value pushed is
+/// distinct, and values pushed by one push_back_n are consecutive, so
+/// that we can check that each value comes back exactly once and that
+/// a pop_back_n returns the values of a batch in reverse.
+template<template<typename T, size_t S> class Vec>
+class BatchedPushPopTest : public FixedVectorTest<Vec> {
+ public:
+  BatchedPushPopTest() : FixedVectorTest<Vec>("batched-push-pop") { }
+
+ protected:
+  virtual void synch_init() {
+    FixedVectorTest<Vec>::synch_init();
+    next_thread_id_.raw_store(0);
+    seen_.assign(value_count() + 1, 0);
+  }
+
+  virtual bool threaded_test() {
+    int thread = static_cast<int>(next_thread_id_.fetch_add(1));
+    int iterations = per_thread_iterations();
+
+    vector<int> popped;
+    popped.reserve(iterations * kContiguity);
+
+    for (int i = 0; i < iterations; i++) {
+      int first = (thread * iterations + i) * kContiguity + 1;
+      long *values[kContiguity];
+      for (int j = 0; j < kContiguity; j++) {
+        values[j] = to_pointer(first + j);
+      }
+      FixedVectorTest<Vec>::definite_push_n(values, kContiguity);
+
+      // A pop_back_n may come back with fewer values than asked for,
+      // and with values of other threads' batches.
+      size_t remaining = kContiguity;
+      while (remaining != 0) {
+        long *out[kContiguity];
+        size_t count = FixedVectorTest<Vec>::vector_->pop_back_n(out,
+                                                                 remaining);
+        for (size_t k = 0; k < count; k++) {
+          int value = to_integer(out[k]);
+          check_i(value, >=, 1, return false);
+          check_i(value, <=, value_count(), return false);
+          if (k != 0 && batch_of(value) == batch_of(popped.back())) {
+            check_i(value, ==, popped.back() - 1, return false);
+          }
+          popped.push_back(value);
+        }
+        remaining -= count;
+      }
+    }
+
+    MutexLocker<> lock(&seen_mutex_);
+    for (size_t i = 0; i < popped.size(); i++) seen_[popped[i]]++;
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    check_i(FixedVectorTest<Vec>::vector_->length(), ==, 0, return false);
+    for (int value = 1; value <= value_count(); value++) {
+      check_i(static_cast<int>(seen_[value]), ==, 1, return false);
+    }
+    return true;
+  }
+
+  int per_thread_iterations() const {
+    return kVectorSize / ThreadedTest::get_thread_count() / kContiguity;
+  }
+
+  int value_count() const {
+    return per_thread_iterations() * ThreadedTest::get_thread_count() *
+        kContiguity;
+  }
+
+  static int batch_of(int value) { return (value - 1) / kContiguity; }
+
+  static const int kContiguity = 8;
+
+  Atomic<Word> next_thread_id_;
+  vector<unsigned char> seen_;
+  Mutex seen_mutex_;
+};
+
+
+/// push_back_n and pop_back_n at the ends of the vector, on one thread:
+/// a push_back_n that doesn't fit pushes what does, and a pop_back_n
+/// asking for more than there is pops everything.
+template<template<typename T, size_t S> class Vec>
+class BatchedBoundaryTest : public FixedVectorTest<Vec> {
+ public:
+  BatchedBoundaryTest() : FixedVectorTest<Vec>("batched-boundary") { }
+
+ protected:
+  virtual bool threaded_test() {
+    Vec<long, kVectorSize> *tested = FixedVectorTest<Vec>::vector_;
+    vector<long *> values(kVectorSize + kOverflow);
+    for (size_t i = 0; i < values.size(); i++) {
+      values[i] = to_pointer(static_cast<int>(i) + 1);
+    }
+
+    size_t first = kVectorSize - kOverflow;
+    check_i(tested->push_back_n(&values[0], first), ==, first,
+            return false);
+    check_i(tested->push_back_n(&values[first], 2 * kOverflow), ==,
+            static_cast<size_t>(kOverflow), return false);
+    check_i(tested->length(), ==, kVectorSize, return false);
+    check_i(tested->push_back_n(&values[kVectorSize], 1), ==, 0,
+            return false);
+    for (size_t i = 0; i < kVectorSize; i++) {
+      check_i(tested->get(i), ==, values[i], return false);
+    }
+
+    vector<long *> out(kVectorSize + kOverflow);
+    check_i(tested->pop_back_n(&out[0], out.size()), ==, kVectorSize,
+            return false);
+    for (size_t i = 0; i < kVectorSize; i++) {
+      check_i(out[i], ==, values[kVectorSize - 1 - i], return false);
+    }
+    check_i(tested->length(), ==, 0, return false);
+    check_i(tested->pop_back_n(&out[0], 1), ==, 0, return false);
+    return true;
+  }
+
+  static const int kOverflow = 4;
 };
 
 
@@ -260,7 +404,7 @@ class PushPopGetTest : public FixedVectorTest<Vec> {
   }
 
   void update_global_histogram(int *local_hist) {
-    MutexLocker lock(&histogram_mutex_);
+    MutexLocker<> lock(&histogram_mutex_);
     for (int i = 0; i < kLimit; i++) {
       histogram_[i] += local_hist[i];
     }
@@ -297,13 +441,244 @@ class PushPopGetTest : public FixedVectorTest<Vec> {
   Mutex histogram_mutex_;
 };
 
+/// A value that actually lives on the heap, unlike the integers
+/// to_pointer makes up.  Destroying it scribbles over it, so reading
+/// a value that has been freed shows up as a failed check (most of
+/// the time -- the memory may have been reused already).
+class HeapObject {
+ public:
+  explicit HeapObject(int value) {
+    fill(payload_, payload_ + kPayloadWords, value);
+    live_.fetch_add(1);
+  }
+
+  ~HeapObject() {
+    fill(payload_, payload_ + kPayloadWords, kDead);
+    live_.fetch_add(-1);
+  }
+
+  bool is_valid() const {
+    for (int i = 1; i < kPayloadWords; i++) {
+      if (payload_[i] != payload_[0]) return false;
+    }
+    return payload_[0] != kDead;
+  }
+
+  static Word live() { return live_.nobarrier_load(); }
+
+ private:
+  static const int kPayloadWords = 4;
+  static const long kDead = -1;
+  volatile long payload_[kPayloadWords];
+  static Atomic<Word> live_;
+};
+
+Atomic<Word> HeapObject::live_;
+
+
+/// Pushes, reads and pops heap allocated values.  With `reclaim` set
+/// reads happen under an EpochGuard and popped values are retired,
+/// otherwise nothing gets freed till the test is over; the difference
+/// is what epoch based reclamation costs.
+template<template<typename T, size_t S> class Vec>
+class HeapPushPopGetTest : public ThreadedTest {
+ public:
+  HeapPushPopGetTest(bool reclaim, int latency_sample_period) :
+      ThreadedTest(VectorNamePrefix<Vec>::prefix() +
+                   (reclaim ? "heap-push-pop-get" :
+                    "heap-push-pop-get-leak")),
+      reclaim_(reclaim),
+      latency_sample_period_(latency_sample_period) { }
+
+ protected:
+  typedef Vec<HeapObject, kVectorSize> VectorType;
+
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int iterations = kHeapOperations / thread_count / kContiguity;
+    XorShiftRandom random(reinterpret_cast<Word>(&iterations));
+    vector<HeapObject *> popped;
+    OperationLatencies latencies(latency_sample_period_);
+
+    for (int i = 0; i < iterations; i++) {
+      for (int j = 0; j < kContiguity; j++) {
+        HeapObject *object = new HeapObject(j);
+        time_sampled(latencies, kPush, definite_push(object));
+      }
+
+      // With reclaim_ set, the latency of a read includes taking the
+      // guard it needs.
+      for (int j = 0; j < kContiguity; j++) {
+        size_t index = random.next() % (vector_->length() + 1);
+        if (reclaim_) {
+          bool valid;
+          time_sampled(latencies, kGet,
+                       EpochGuard guard;
+                       valid = check_object(vector_->get(index, guard)));
+          if (!valid) return false;
+        } else {
+          HeapObject *object;
+          time_sampled(latencies, kGet, object = vector_->get(index));
+          if (!check_object(object)) return false;
+        }
+      }
+
+      for (int j = 0; j < kContiguity; j++) {
+        if (reclaim_) {
+          bool valid;
+          time_sampled(latencies, kPop,
+                       EpochGuard guard;
+                       valid = check_object(definite_retire_pop(guard)));
+          if (!valid) return false;
+        } else {
+          HeapObject *object;
+          time_sampled(latencies, kPop, object = definite_pop());
+          if (!check_object(object)) return false;
+          popped.push_back(object);
+        }
+      }
+    }
+
+    if (latency_sample_period_ != 0) add_thread_latencies(latencies);
+
+    MutexLocker<> lock(&popped_mutex_);
+    popped_.insert(popped_.end(), popped.begin(), popped.end());
+    return true;
+  }
+
+  void definite_push(HeapObject *object) {
+    while (vector_->push_back(object) == static_cast<size_t>(-1))
+      ;
+  }
+
+  HeapObject *definite_pop() {
+    HeapObject *object;
+    do {
+      object = vector_->pop_back(NULL);
+    } while (VectorType::is_out_of_range(object));
+    return object;
+  }
+
+  HeapObject *definite_retire_pop(const EpochGuard &guard) {
+    HeapObject *object;
+    do {
+      object = vector_->retire_pop_back(NULL, guard);
+    } while (VectorType::is_out_of_range(object));
+    return object;
+  }
+
+  bool check_object(HeapObject *object) {
+    if (VectorType::is_out_of_range(object)) return true;
+    check_i(object->is_valid(), ==, true, return false);
+    return true;
+  }
+
+  virtual void synch_init() {
+    vector_ = new VectorType;
+    popped_.clear();
+  }
+
+  virtual bool synch_verify() {
+    check_i(vector_->length(), ==, 0, return false);
+
+    // Nobody is holding a guard any more.
+    Epoch::CollectAll();
+    for (size_t i = 0; i < popped_.size(); i++) delete popped_[i];
+    popped_.clear();
+
+    check_i(HeapObject::live(), ==, 0, return false);
+
+    if (latency_sample_period_ != 0) report_latencies(kOperationNames);
+    return true;
+  }
+
+  virtual void synch_destroy() {
+    if (ContentionStatsOf<Vec>::kCounted) {
+      report_contention(ContentionStatsOf<Vec>::Get(vector_));
+    }
+    delete vector_;
+  }
+
+  static const int kHeapOperations = 1024 * 1024;
+  static const int kContiguity = 8;
+  bool reclaim_;
+  int latency_sample_period_;
+  VectorType *vector_;
+  vector<HeapObject *> popped_;
+  Mutex popped_mutex_;
+};
+
+
+/// One thread pushes and pops increasing values at index 0 while the
+/// others get index 0.  A popped slot keeps its value till the next
+/// push stores over it, after bumping the length; a get in between
+/// must not return the popped value.  Readers check that whatever
+/// they get is newer than the last value popped before they looked.
+template<template<typename T, size_t S> class Vec>
+class StaleGetTest : public FixedVectorTest<Vec> {
+ public:
+  StaleGetTest() : FixedVectorTest<Vec>("stale-get") { }
+
+ protected:
+  virtual void synch_init() {
+    FixedVectorTest<Vec>::synch_init();
+    next_thread_id_.raw_store(0);
+    last_popped_.raw_store(0);
+    done_.raw_store(0);
+  }
+
+  virtual bool threaded_test() {
+    if (next_thread_id_.fetch_add(1) == 0) {
+      bool result = write();
+      done_.store(1, kRelease);
+      return result;
+    }
+    return read();
+  }
+
+  bool write() {
+    for (int i = 1; i <= kRounds; i++) {
+      FixedVectorTest<Vec>::definite_push(i);
+      check_i(FixedVectorTest<Vec>::definite_pop(), ==, i, return false);
+      last_popped_.store(i, kRelease);
+    }
+    return true;
+  }
+
+  bool read() {
+    while (done_.acquire_load() == 0) {
+      Word popped = last_popped_.acquire_load();
+      long *value = FixedVectorTest<Vec>::vector_->get(0);
+      if (FixedVector<long, kVectorSize>::is_out_of_range(value)) continue;
+      check_i(static_cast<Word>(to_integer(value)), >, popped,
+              return false);
+    }
+    return true;
+  }
+
+ private:
+  static const int kRounds = 512 * 1024;
+
+  Atomic<Word> next_thread_id_;
+  Atomic<Word> last_popped_;
+  Atomic<Word> done_;
+};
+
+
 struct TestConfig {
   int thread_count_lower;
   int thread_count_upper;
   bool quiet;
   bool push_only;
+  bool push_overflow;
   bool push_pop;
+  bool batched_push_pop;
+  bool batched_boundary;
   bool push_pop_get;
+  bool stale_get;
+  bool heap_push_pop_get;
+  bool heap_push_pop_get_leak;
+  int latency_sample_period;
   string test_type;
 
   void read_config(int argc, char **argv) {
@@ -314,17 +689,41 @@ struct TestConfig {
     arg_info["push-only"].type = CommandLine::BOOL;
     arg_info["push-only"].boolean = true;
 
+    arg_info["push-overflow"].type = CommandLine::BOOL;
+    arg_info["push-overflow"].boolean = true;
+
     arg_info["push-pop"].type = CommandLine::BOOL;
     arg_info["push-pop"].boolean = true;
 
+    arg_info["batched-push-pop"].type = CommandLine::BOOL;
+    arg_info["batched-push-pop"].boolean = true;
+
+    arg_info["batched-boundary"].type = CommandLine::BOOL;
+    arg_info["batched-boundary"].boolean = true;
+
     arg_info["push-pop-get"].type = CommandLine::BOOL;
     arg_info["push-pop-get"].boolean = true;
 
+    arg_info["stale-get"].type = CommandLine::BOOL;
+    arg_info["stale-get"].boolean = true;
+
+    arg_info["heap-push-pop-get"].type = CommandLine::BOOL;
+    arg_info["heap-push-pop-get"].boolean = true;
+
+    arg_info["heap-push-pop-get-leak"].type = CommandLine::BOOL;
+    arg_info["heap-push-pop-get-leak"].boolean = true;
+
+    // Time one in every so many pushes, pops and gets in the push-pop
+    // and heap-push-pop-get tests, and print latency percentiles.
+    arg_info["latency-sample-period"].type = CommandLine::INTEGER;
+    arg_info["latency-sample-period"].integer = 0;
+
     arg_info["thread-count-lower"].type = CommandLine::INTEGER;
     arg_info["thread-count-lower"].integer = 1;
 
     arg_info["thread-count-upper"].type = CommandLine::INTEGER;
-    arg_info["thread-count-upper"].integer = 128;
+    arg_info["thread-count-upper"].integer =
+        CpuTopology::Get().default_thread_count();
 
     arg_info["test-type"].type = CommandLine::STRING;
     arg_info["test-type"].string = "real";
@@ -333,8 +732,15 @@ struct TestConfig {
 
     quiet = arg_info["quiet"].boolean;
     push_only = arg_info["push-only"].boolean;
+    push_overflow = arg_info["push-overflow"].boolean;
     push_pop = arg_info["push-pop"].boolean;
+    batched_push_pop = arg_info["batched-push-pop"].boolean;
+    batched_boundary = arg_info["batched-boundary"].boolean;
     push_pop_get = arg_info["push-pop-get"].boolean;
+    stale_get = arg_info["stale-get"].boolean;
+    heap_push_pop_get = arg_info["heap-push-pop-get"].boolean;
+    heap_push_pop_get_leak = arg_info["heap-push-pop-get-leak"].boolean;
+    latency_sample_period = arg_info["latency-sample-period"].integer;
 
     thread_count_lower = arg_info["thread-count-lower"].integer;
     thread_count_upper = arg_info["thread-count-upper"].integer;
@@ -346,16 +752,38 @@ template<template<typename T, size_t Size> class Vec>
 bool run_with_thread_count(TestConfig *config, int thread_count) {
   bool quiet = config->quiet;
   bool result = true;
+  bool contiguous = HasContiguousIndices<Vec>::value;
+  int sample_period = config->latency_sample_period;
 
-  if (config->push_only) {
+  if (config->push_only && contiguous) {
     result &= PushOnlyTest<Vec>().execute(quiet, thread_count);
   }
+  if (config->push_overflow && contiguous) {
+    result &= PushOverflowTest<Vec>().execute(quiet, thread_count);
+  }
   if (config->push_pop) {
-    result &= PushPopTest<Vec>().execute(quiet, thread_count);
+    result &= PushPopTest<Vec>(sample_period).execute(quiet, thread_count);
   }
-  if (config->push_pop_get) {
+  if (config->batched_push_pop) {
+    result &= BatchedPushPopTest<Vec>().execute(quiet, thread_count);
+  }
+  if (config->batched_boundary && contiguous && thread_count == 1) {
+    result &= BatchedBoundaryTest<Vec>().execute(quiet, thread_count);
+  }
+  if (config->push_pop_get && contiguous) {
     PushPopGetTest<Vec>().execute(quiet, thread_count);
   }
+  if (config->stale_get && contiguous) {
+    result &= StaleGetTest<Vec>().execute(quiet, thread_count);
+  }
+  if (config->heap_push_pop_get) {
+    result &= HeapPushPopGetTest<Vec>(true, sample_period).execute(
+        quiet, thread_count);
+  }
+  if (config->heap_push_pop_get_leak) {
+    result &= HeapPushPopGetTest<Vec>(false, sample_period).execute(
+        quiet, thread_count);
+  }
 
   return result;
 }
@@ -377,21 +805,55 @@ bool run_tests_on_container(TestConfig *config) {
 int main(int argc, char **argv) {
   TestConfig config;
   config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
   bool success = true;
-  long time_taken;
-
-  {
-    Timer timer(&time_taken);
-    if (config.test_type == "real") {
-      success = run_tests_on_container<FixedVector>(&config);
-    } else if (config.test_type == "fake") {
-      success = run_tests_on_container<NaiveFixedVector>(&config);
-    } else {
-      cerr << "unknown test type `" << config.test_type << "`" << endl;
-    }
+  if (config.test_type == "real") {
+    success = run_tests_on_container<FixedVector>(&config);
+  } else if (config.test_type == "fake") {
+    success = run_tests_on_container<NaiveFixedVector>(&config);
+  } else if (config.test_type == "fake-futex") {
+    success = run_tests_on_container<
+      LockedFixedVector<FutexMutex>::Type>(&config);
+  } else if (config.test_type == "fake-ticket") {
+    success = run_tests_on_container<
+      LockedFixedVector<TicketLock>::Type>(&config);
+  } else if (config.test_type == "fake-mcs") {
+    success = run_tests_on_container<
+      LockedFixedVector<McsLock>::Type>(&config);
+  } else if (config.test_type == "fake-clh") {
+    success = run_tests_on_container<
+      LockedFixedVector<ClhLock>::Type>(&config);
+  } else if (config.test_type == "elimination") {
+    success = run_tests_on_container<EliminationFixedVector>(&config);
+  } else if (config.test_type == "sharded") {
+    success = run_tests_on_container<ShardedStack>(&config);
+  } else if (config.test_type == "real-fetch-add") {
+    success = run_tests_on_container<FetchAddFixedVector>(&config);
+  } else if (config.test_type == "real-counted") {
+    success = run_tests_on_container<CountedFixedVector>(&config);
+  } else if (config.test_type == "real-huge-pages") {
+    success = run_tests_on_container<HugePageFixedVector>(&config);
+  } else if (config.test_type == "real-padded") {
+    success = run_tests_on_container<PaddedFixedVector>(&config);
+  } else if (config.test_type == "real-scattered") {
+    success = run_tests_on_container<ScatteredFixedVector>(&config);
+  } else if (config.test_type == "real-adaptive") {
+    success = run_tests_on_container<
+      BackoffFixedVector<AdaptiveBackoff>::Type>(&config);
+  } else if (config.test_type == "real-spin") {
+    success = run_tests_on_container<
+      BackoffFixedVector<SpinBackoff>::Type>(&config);
+  } else if (config.test_type == "real-exponential") {
+    success = run_tests_on_container<
+      BackoffFixedVector<ExponentialBackoff>::Type>(&config);
+  } else if (config.test_type == "real-yield") {
+    success = run_tests_on_container<
+      BackoffFixedVector<YieldBackoff>::Type>(&config);
+  } else {
+    cerr << "unknown test type `" << config.test_type << "`" << endl;
   }
 
-  cout << time_taken / 1000.0d << endl;
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
   if (!success) return 1;
   return 0;
 }
@@ -0,0 +1,353 @@
+#include "tests.hpp"
+#include "growable-vector.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+
+#include "locks.hpp"
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+typedef GrowableVector<long> Vector;
+
+const int kElementCount = 4 * 1024 * 1024;
+const int kSampleValue = 4242;
+
+class GrowableVectorTest : public ThreadedTest {
+ public:
+  explicit GrowableVectorTest(const string &subname) :
+    ThreadedTest("growable-vector-" + subname) {
+  }
+
+ protected:
+  virtual void synch_init() {
+    vector_ = new Vector;
+  }
+
+  virtual void synch_destroy() {
+    delete vector_;
+  }
+
+  int definite_pop() {
+    while (true) {
+      long *attempt = vector_->pop_back(NULL);
+      if (!Vector::is_out_of_range(attempt)) {
+        return to_integer(attempt);
+      }
+    }
+  }
+
+  void definite_push(int value) {
+    long *pointer_value = to_pointer(value);
+    while (vector_->push_back(pointer_value) == static_cast<size_t>(-1))
+      ;
+  }
+
+  /// Buckets double in size, so we should never have allocated more
+  /// than twice the slots we needed.
+  bool check_capacity(size_t max_length) {
+    check_i(vector_->capacity(), <=,
+            2 * max_length + Vector::kFirstBucketSize, return false);
+    return true;
+  }
+
+  Vector *vector_;
+};
+
+
+class PushOnlyTest : public GrowableVectorTest {
+ public:
+  PushOnlyTest() : GrowableVectorTest("push-only") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int iterations = kElementCount / thread_count;
+
+    for (int i = 0; i < iterations; i++) {
+      vector_->push_back(to_pointer(kSampleValue));
+    }
+
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int per_thread_pushes = kElementCount  / thread_count;
+    size_t expected_length = per_thread_pushes * thread_count;
+
+    check_i(vector_->length(), ==, expected_length, return false);
+    if (!check_capacity(expected_length)) return false;
+
+    for (size_t i = 0; i < expected_length; i++) {
+      check_i(vector_->get(i), ==, to_pointer(kSampleValue), return false);
+    }
+
+    return true;
+  }
+};
+
+
+class PushPopTest : public GrowableVectorTest {
+ public:
+  PushPopTest() : GrowableVectorTest("push-pop") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int per_thread_slots = kElementCount  / thread_count;
+    int iterations = per_thread_slots / kContiguity;
+
+    for (int i = 0; i < iterations; i++) {
+      for (int j = 0; j <  kContiguity; j++) {
+        definite_push(kSampleValue);
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        int popped_value = definite_pop();
+        check_i(popped_value, ==, kSampleValue, return false);
+      }
+    }
+
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    check_i(vector_->length(), ==, 0, return false);
+
+    // At most kContiguity elements per thread are ever in the vector.
+    return check_capacity(kContiguity * ThreadedTest::get_thread_count());
+  }
+
+  static const int kContiguity = 8;
+};
+
+
+class PushPopGetTest : public GrowableVectorTest {
+ public:
+  PushPopGetTest() : GrowableVectorTest("push-pop-get") { }
+
+ protected:
+  virtual bool threaded_test() {
+    bool choice = rand() % 2 == 0;
+    bool to_pop = rand() % 10 == 0;
+
+    int local_histogram[kLimit];
+    fill(local_histogram, local_histogram + kLimit, 0);
+
+    if (choice) {
+      bool result = check_mutate(local_histogram, to_pop) && check_get();
+      update_global_histogram(local_histogram);
+      return result;
+    } else {
+      bool result = check_get() && check_mutate(local_histogram, to_pop);
+      update_global_histogram(local_histogram);
+      return result;
+    }
+  }
+
+  bool check_mutate(int *histogram, bool to_pop) {
+    for (int i = 0; i < kLimit; i++) {
+      vector_->push_back(to_pointer(i));
+      vector_->push_back(to_pointer(i));
+      if (to_pop) {
+        int value = definite_pop();
+        histogram[value]++;
+        check_i(value, <, kLimit, return false);
+        check_i(value, >=, 0, return false);
+      }
+    }
+    return true;
+  }
+
+  bool check_get() {
+    int index = 0;
+    while (true) {
+      long *value = vector_->get(index);
+      if (Vector::is_out_of_range(value)) {
+        return true;
+      }
+      int integer_value = to_integer(value);
+      check_i(integer_value, <, kLimit, return false);
+      check_i(integer_value, >=, 0, return false);
+      index++;
+    }
+    return true;
+  }
+
+  void update_global_histogram(int *local_hist) {
+    MutexLocker<> lock(&histogram_mutex_);
+    for (int i = 0; i < kLimit; i++) {
+      histogram_[i] += local_hist[i];
+    }
+  }
+
+  virtual void synch_init() {
+    GrowableVectorTest::synch_init();
+    fill(histogram_, histogram_ + kLimit, 0);
+  }
+
+  virtual bool synch_verify() {
+    int thread_count = ThreadedTest::get_thread_count();
+    size_t length = vector_->length();
+
+    for (size_t i = 0; i < length; i++) {
+      int value = to_integer(vector_->get(i));
+      check_i(value, <, kLimit, return false);
+      check_i(value, >=, 0, return false);
+      histogram_[value]++;
+    }
+
+    for (int i = 0; i < kLimit; i++) {
+      check_i(histogram_[i], ==, 2 * thread_count, return false);
+    }
+    return true;
+  }
+
+  static const int kLimit = 32;
+  int histogram_[kLimit];
+  Mutex histogram_mutex_;
+};
+
+
+/// Same as the FixedVector stale-get test: one thread pushes and pops
+/// increasing values at index 0, the others get index 0 and check
+/// that whatever they get is newer than the last value popped before
+/// they looked.
+class StaleGetTest : public GrowableVectorTest {
+ public:
+  StaleGetTest() : GrowableVectorTest("stale-get") { }
+
+ protected:
+  virtual void synch_init() {
+    GrowableVectorTest::synch_init();
+    next_thread_id_.raw_store(0);
+    last_popped_.raw_store(0);
+    done_.raw_store(0);
+  }
+
+  virtual bool threaded_test() {
+    if (next_thread_id_.fetch_add(1) == 0) {
+      bool result = write();
+      done_.store(1, kRelease);
+      return result;
+    }
+    return read();
+  }
+
+  bool write() {
+    for (int i = 1; i <= kRounds; i++) {
+      definite_push(i);
+      check_i(definite_pop(), ==, i, return false);
+      last_popped_.store(i, kRelease);
+    }
+    return true;
+  }
+
+  bool read() {
+    while (done_.acquire_load() == 0) {
+      Word popped = last_popped_.acquire_load();
+      long *value = vector_->get(0);
+      if (Vector::is_out_of_range(value)) continue;
+      check_i(static_cast<Word>(to_integer(value)), >, popped,
+              return false);
+    }
+    return true;
+  }
+
+ private:
+  static const int kRounds = 512 * 1024;
+
+  Atomic<Word> next_thread_id_;
+  Atomic<Word> last_popped_;
+  Atomic<Word> done_;
+};
+
+struct TestConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  bool quiet;
+  bool push_only;
+  bool push_pop;
+  bool push_pop_get;
+  bool stale_get;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["quiet"].type = CommandLine::BOOL;
+    arg_info["quiet"].boolean = false;
+
+    arg_info["push-only"].type = CommandLine::BOOL;
+    arg_info["push-only"].boolean = true;
+
+    arg_info["push-pop"].type = CommandLine::BOOL;
+    arg_info["push-pop"].boolean = true;
+
+    arg_info["push-pop-get"].type = CommandLine::BOOL;
+    arg_info["push-pop-get"].boolean = true;
+
+    arg_info["stale-get"].type = CommandLine::BOOL;
+    arg_info["stale-get"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        CpuTopology::Get().default_thread_count();
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    quiet = arg_info["quiet"].boolean;
+    push_only = arg_info["push-only"].boolean;
+    push_pop = arg_info["push-pop"].boolean;
+    push_pop_get = arg_info["push-pop-get"].boolean;
+    stale_get = arg_info["stale-get"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+  }
+};
+
+bool run_with_thread_count(TestConfig *config, int thread_count) {
+  bool quiet = config->quiet;
+  bool result = true;
+
+  if (config->push_only) {
+    result &= PushOnlyTest().execute(quiet, thread_count);
+  }
+  if (config->push_pop) {
+    result &= PushPopTest().execute(quiet, thread_count);
+  }
+  if (config->push_pop_get) {
+    result &= PushPopGetTest().execute(quiet, thread_count);
+  }
+  if (config->stale_get) {
+    result &= StaleGetTest().execute(quiet, thread_count);
+  }
+
+  return result;
+}
+
+}
+
+int main(int argc, char **argv) {
+  TestConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  bool success = true;
+  for (int i = config.thread_count_lower;
+       i <= config.thread_count_upper && success;
+       i++) {
+    success = run_with_thread_count(&config, i);
+  }
+
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
+  if (!success) return 1;
+  return 0;
+}
@@ -0,0 +1,374 @@
+#include "tests.hpp"
+#include "persistent-fixed-vector.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const size_t kVectorSize = 4 * 1024 * 1024;
+
+typedef PersistentFixedVector<> Vector;
+
+/// Values the tests push look like 7k + 3, so that reading a garbage
+/// value is likely to be noticed.
+inline Word make_value(Word k) { return 7 * k + 3; }
+inline bool is_valid_value(Word value) { return value % 7 == 3; }
+
+
+class PersistentVectorTest : public ThreadedTest {
+ public:
+  explicit PersistentVectorTest(const string &subname) :
+    ThreadedTest("persistent-fixed-vector-" + subname),
+    vector_(NULL) {
+  }
+
+ protected:
+  /// Every test gets a file of its own, which is gone once it's done.
+  virtual void synch_init() {
+    char path[] = "/tmp/eelish-persistent-vector-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd != -1) close(fd);
+    path_ = path;
+    vector_ = Vector::Open(path_, kVectorSize);
+  }
+
+  virtual void synch_destroy() {
+    delete vector_;
+    unlink(path_.c_str());
+  }
+
+  /// Closes the vector and opens its file again, as a restart would.
+  bool reopen() {
+    delete vector_;
+    vector_ = Vector::Open(path_, kVectorSize);
+    return vector_ != NULL;
+  }
+
+  Word definite_pop() {
+    Word value;
+    while (!vector_->pop_back(&value, NULL))
+      ;
+    return value;
+  }
+
+  void definite_push(Word value) {
+    while (vector_->push_back(value) == static_cast<size_t>(-1))
+      ;
+  }
+
+  string path_;
+  Vector *vector_;
+};
+
+
+/// Every thread pushes kContiguity values and pops as many, over and
+/// over.  The values popped must add up to the values pushed.
+class PushPopTest : public PersistentVectorTest {
+ public:
+  PushPopTest() : PersistentVectorTest("push-pop") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = get_thread_count();
+    int iterations = kOperationCount / thread_count / kContiguity;
+    Word pushed = 0;
+    Word popped = 0;
+
+    for (int i = 0; i < iterations; i++) {
+      for (int j = 0; j < kContiguity; j++) {
+        Word value = make_value(i * kContiguity + j);
+        definite_push(value);
+        pushed += value;
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        Word value = definite_pop();
+        check_i(is_valid_value(value), ==, true, return false);
+        popped += value;
+      }
+    }
+
+    difference_.fetch_add(pushed - popped);
+    return true;
+  }
+
+  virtual void synch_init() {
+    PersistentVectorTest::synch_init();
+    difference_.raw_store(0);
+  }
+
+  virtual bool synch_verify() {
+    check_i(vector_->length(), ==, 0, return false);
+    check_i(difference_.raw_load(), ==, 0, return false);
+    return true;
+  }
+
+  static const int kOperationCount = 4 * 1024 * 1024;
+  static const int kContiguity = 8;
+  Atomic<Word> difference_;
+};
+
+
+/// Every thread pushes its share of kPushCount values.  The vector is
+/// then closed and reopened, and must hold exactly those values, with
+/// no recovery needed.
+class ReopenTest : public PersistentVectorTest {
+ public:
+  ReopenTest() : PersistentVectorTest("reopen") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int iterations = kPushCount / get_thread_count();
+    for (int i = 0; i < iterations; i++) definite_push(make_value(i));
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    int thread_count = get_thread_count();
+    size_t expected_length = (kPushCount / thread_count) * thread_count;
+
+    check_i(reopen(), ==, true, return false);
+    check_i(vector_->recovered(), ==, false, return false);
+    check_i(vector_->length(), ==, expected_length, return false);
+
+    map<Word, int> seen;
+    for (size_t i = 0; i < expected_length; i++) {
+      Word value;
+      check_i(vector_->get(i, &value), ==, true, return false);
+      seen[value]++;
+    }
+    for (int i = 0; i < kPushCount / thread_count; i++) {
+      check_i(seen[make_value(i)], ==, thread_count, return false);
+    }
+    return true;
+  }
+
+  static const int kPushCount = 1024 * 1024;
+};
+
+
+/// While the vector is open, Open must fail on its file, in this
+/// process and in another one.  Had the second Open succeeded, it
+/// would have taken the file for a crashed one and recovered it.
+class ExclusiveOpenTest : public PersistentVectorTest {
+ public:
+  ExclusiveOpenTest() : PersistentVectorTest("exclusive-open") { }
+
+ protected:
+  virtual bool threaded_test() {
+    for (int i = 0; i < kPushCount; i++) definite_push(make_value(i));
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    size_t length = vector_->length();
+    Vector *second = Vector::Open(path_, kVectorSize);
+    check_i(second == NULL, ==, true, delete second; return false);
+
+    pid_t child = fork();
+    if (child == 0) _exit(Vector::Open(path_, kVectorSize) == NULL ? 0 : 1);
+    int status;
+    check_i(waitpid(child, &status, 0), ==, child, return false);
+    check_i(WIFEXITED(status) && WEXITSTATUS(status) == 0, ==, true,
+            return false);
+
+    check_i(reopen(), ==, true, return false);
+    check_i(vector_->recovered(), ==, false, return false);
+    check_i(vector_->length(), ==, length, return false);
+    return true;
+  }
+
+  static const int kPushCount = 1024;
+};
+
+
+/// A child process pushes and pops on kChildThreads threads till it is
+/// killed, with pushes and pops in flight.  Reopening the vector must
+/// recover it into a state where every value below the length can be
+/// read, and then the test's threads pop it empty.
+class CrashRecoveryTest : public PersistentVectorTest {
+ public:
+  CrashRecoveryTest() : PersistentVectorTest("crash-recovery") { }
+
+ protected:
+  virtual void synch_init() {
+    PersistentVectorTest::synch_init();
+    recovered_consistently_ = false;
+
+    // The child has to be the only one with the file open when it
+    // dies, or our close would hide its crash.
+    delete vector_;
+    vector_ = NULL;
+
+    int ready[2];
+    if (pipe(ready) != 0) return;
+    pid_t child = fork();
+    if (child == 0) RunChild(path_, ready[1]);
+
+    // Wait till the child has pushed a fair amount and kill it
+    // mid-flight.
+    char byte;
+    if (read(ready[0], &byte, 1) != 1) return;
+    kill(child, SIGKILL);
+    waitpid(child, NULL, 0);
+    close(ready[0]);
+    close(ready[1]);
+
+    vector_ = Vector::Open(path_, kVectorSize);
+    if (vector_ == NULL || !vector_->recovered()) return;
+
+    for (size_t i = 0; i < vector_->length(); i++) {
+      Word value;
+      if (!vector_->get(i, &value) || !is_valid_value(value)) return;
+    }
+    recovered_consistently_ = true;
+  }
+
+  virtual bool threaded_test() {
+    if (vector_ == NULL) return false;
+    Word value;
+    while (vector_->pop_back(&value, NULL)) {
+      check_i(is_valid_value(value), ==, true, return false);
+    }
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    check_i(recovered_consistently_, ==, true, return false);
+    check_i(vector_->length(), ==, 0, return false);
+    return true;
+  }
+
+ private:
+  /// Writes a byte to `ready` once the vector is kMinimumLength long,
+  /// and carries on till it is killed.
+  static void RunChild(const string &path, int ready) {
+    Vector *vector = Vector::Open(path, kVectorSize);
+    if (vector == NULL) _exit(1);
+
+    pthread_t threads[kChildThreads];
+    for (int i = 0; i < kChildThreads; i++) {
+      pthread_create(&threads[i], NULL, ChildThread, vector);
+    }
+    while (vector->length() < kMinimumLength) Platform::Sleep(1000);
+    char byte = 0;
+    if (write(ready, &byte, 1) != 1) _exit(1);
+    pthread_join(threads[0], NULL);
+    _exit(0);
+  }
+
+  /// Two pushes for every pop, so that the vector keeps growing.
+  static void *ChildThread(void *data) {
+    Vector *vector = reinterpret_cast<Vector *>(data);
+    for (Word i = 0; ; i++) {
+      if (vector->push_back(make_value(i)) == static_cast<size_t>(-1) ||
+          i % 2 == 0) {
+        Word value;
+        vector->pop_back(&value, NULL);
+      }
+    }
+    return NULL;
+  }
+
+  static const int kChildThreads = 4;
+  static const size_t kMinimumLength = 64 * 1024;
+  bool recovered_consistently_;
+};
+
+
+struct TestConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  bool quiet;
+  bool push_pop;
+  bool reopen;
+  bool exclusive_open;
+  bool crash_recovery;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["quiet"].type = CommandLine::BOOL;
+    arg_info["quiet"].boolean = false;
+
+    arg_info["push-pop"].type = CommandLine::BOOL;
+    arg_info["push-pop"].boolean = true;
+
+    arg_info["reopen"].type = CommandLine::BOOL;
+    arg_info["reopen"].boolean = true;
+
+    arg_info["exclusive-open"].type = CommandLine::BOOL;
+    arg_info["exclusive-open"].boolean = true;
+
+    arg_info["crash-recovery"].type = CommandLine::BOOL;
+    arg_info["crash-recovery"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        CpuTopology::Get().default_thread_count();
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    quiet = arg_info["quiet"].boolean;
+    push_pop = arg_info["push-pop"].boolean;
+    reopen = arg_info["reopen"].boolean;
+    exclusive_open = arg_info["exclusive-open"].boolean;
+    crash_recovery = arg_info["crash-recovery"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+  }
+};
+
+bool run_with_thread_count(TestConfig *config, int thread_count) {
+  bool quiet = config->quiet;
+  bool result = true;
+
+  if (config->push_pop) {
+    result &= PushPopTest().execute(quiet, thread_count);
+  }
+  if (config->reopen) {
+    result &= ReopenTest().execute(quiet, thread_count);
+  }
+  if (config->exclusive_open) {
+    result &= ExclusiveOpenTest().execute(quiet, thread_count);
+  }
+  if (config->crash_recovery) {
+    result &= CrashRecoveryTest().execute(quiet, thread_count);
+  }
+
+  return result;
+}
+
+}
+
+int main(int argc, char **argv) {
+  TestConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  bool success = true;
+  for (int i = config.thread_count_lower;
+       i <= config.thread_count_upper;
+       i++) {
+    if (!run_with_thread_count(&config, i)) {
+      success = false;
+      break;
+    }
+  }
+
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
+  if (!success) return 1;
+  return 0;
+}
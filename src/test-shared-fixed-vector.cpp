@@ -0,0 +1,302 @@
+#include "tests.hpp"
+#include "shared-fixed-vector.hpp"
+
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+/// What the processes trade.  `check` is a function of the other two
+/// fields, so that an item read before whoever pushed it was done
+/// writing it is likely to be noticed.
+struct Item {
+  Word index;
+  Word stamp;
+  Word check;
+};
+
+inline Word make_check(Word index, Word stamp) {
+  return (index * 0x9e3779b97f4a7c15ULL) ^ stamp;
+}
+
+inline void stamp_item(Item *item, Word stamp) {
+  item->stamp = stamp;
+  item->check = make_check(item->index, stamp);
+}
+
+inline bool is_valid_item(Item *item) {
+  return item->check == make_check(item->index, item->stamp);
+}
+
+typedef SharedFixedVector<Item> Vector;
+
+
+class SharedVectorTest : public ThreadedTest {
+ public:
+  explicit SharedVectorTest(const string &subname) :
+    ThreadedTest("shared-fixed-vector-" + subname),
+    vector_(NULL) {
+  }
+
+ protected:
+  /// Every test gets a segment of its own, which is gone once it's
+  /// done.
+  void create(size_t capacity, size_t arena_size) {
+    char name[64];
+    snprintf(name, sizeof(name), "/eelish-shared-vector-%d",
+             static_cast<int>(getpid()));
+    name_ = name;
+    Vector::Unlink(name_);
+    vector_ = Vector::Create(name_, capacity, arena_size);
+    if (vector_ == NULL) return;
+    for (size_t i = 0; i < arena_size; i++) {
+      vector_->arena()[i].index = i;
+      stamp_item(&vector_->arena()[i], 0);
+    }
+  }
+
+  virtual void synch_destroy() {
+    delete vector_;
+    Vector::Unlink(name_);
+  }
+
+  /// Checks that the vector holds every item in the arena exactly once,
+  /// and that every item is intact.
+  bool verify_items() {
+    check_i(vector_ != NULL, ==, true, return false);
+    size_t arena_size = vector_->arena_size();
+    check_i(vector_->length(), ==, arena_size, return false);
+
+    vector<int> seen(arena_size, 0);
+    for (size_t i = 0; i < arena_size; i++) {
+      Item *item;
+      check_i(vector_->get(i, &item), ==, true, return false);
+      Word offset = item - vector_->arena();
+      check_i(offset, <, arena_size, return false);
+      check_i(item->index, ==, offset, return false);
+      check_i(is_valid_item(item), ==, true, return false);
+      seen[offset]++;
+    }
+    for (size_t i = 0; i < arena_size; i++) {
+      check_i(seen[i], ==, 1, return false);
+    }
+    return true;
+  }
+
+  string name_;
+  Vector *vector_;
+};
+
+
+/// Every thread attaches to the segment on its own, which maps it at
+/// an address of its own, and pushes its share of the arena through
+/// that mapping.  Reading the vector through the creator's mapping
+/// must then find every item.
+class AttachTest : public SharedVectorTest {
+ public:
+  AttachTest() : SharedVectorTest("attach") { }
+
+ protected:
+  virtual void synch_init() {
+    create(kArenaSize, kArenaSize);
+    next_item_.raw_store(0);
+  }
+
+  virtual bool threaded_test() {
+    if (vector_ == NULL) return false;
+    Vector *attached = Vector::Attach(name_);
+    check_i(attached != NULL, ==, true, return false);
+    check_i(attached->capacity(), ==, kArenaSize, return false);
+
+    while (true) {
+      Word index = next_item_.fetch_add(1);
+      if (index >= kArenaSize) break;
+      Item *item = attached->arena() + index;
+      check_i(attached->push_back(item), !=, static_cast<size_t>(-1),
+              return false);
+    }
+    delete attached;
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    check_i(Vector::Create(name_, kArenaSize, kArenaSize) == NULL, ==, true,
+            return false);
+    check_i(SharedFixedVector<Word>::Attach(name_) == NULL, ==, true,
+            return false);
+    return verify_items();
+  }
+
+  static const size_t kArenaSize = 64 * 1024;
+  Atomic<Word> next_item_;
+};
+
+
+/// The arena starts out pushed.  kChildProcesses child processes and
+/// the test's threads then pop items, check them, stamp them afresh
+/// and push them back, kRounds times each.  Once everyone is done the
+/// vector must hold every item exactly once, intact.
+class TradeTest : public SharedVectorTest {
+ public:
+  TradeTest() : SharedVectorTest("trade") { }
+
+ protected:
+  virtual void synch_init() {
+    create(kArenaSize, kArenaSize);
+    children_.clear();
+    started_.raw_store(0);
+    if (vector_ == NULL) return;
+    for (size_t i = 0; i < kArenaSize; i++) {
+      vector_->push_back(vector_->arena() + i);
+    }
+
+    // The children wait for the test's threads, so that they trade
+    // with each other and not one after the other.
+    if (pipe(start_) != 0) return;
+    for (int i = 0; i < kChildProcesses; i++) {
+      pid_t child = fork();
+      if (child == 0) RunChild(name_, start_[0], i + 1);
+      if (child != -1) children_.push_back(child);
+    }
+  }
+
+  virtual bool threaded_test() {
+    if (vector_ == NULL) return false;
+    if (started_.boolean_cas(0, 1)) {
+      char bytes[kChildProcesses] = { 0 };
+      check_i(write(start_[1], bytes, kChildProcesses), ==, kChildProcesses,
+              return false);
+    }
+    return Trade(vector_, reinterpret_cast<Word>(&started_));
+  }
+
+  virtual bool synch_verify() {
+    close(start_[0]);
+    close(start_[1]);
+    check_i(children_.size(), ==, kChildProcesses, return false);
+    for (size_t i = 0; i < children_.size(); i++) {
+      int status;
+      check_i(waitpid(children_[i], &status, 0), ==, children_[i],
+              return false);
+      check_i(WIFEXITED(status) && WEXITSTATUS(status) == 0, ==, true,
+              return false);
+    }
+    return verify_items();
+  }
+
+ private:
+  static void RunChild(const string &name, int start, int id) {
+    Vector *vector = Vector::Attach(name);
+    if (vector == NULL) _exit(1);
+    char byte;
+    if (read(start, &byte, 1) != 1) _exit(1);
+    bool success = Trade(vector, id);
+    delete vector;
+    _exit(success ? 0 : 1);
+  }
+
+  static bool Trade(Vector *vector, Word seed) {
+    XorShiftRandom random(seed);
+    for (int i = 0; i < kRounds; i++) {
+      Item *item;
+      while (!vector->pop_back(&item, NULL))
+        ;
+      Word offset = item - vector->arena();
+      if (offset >= kArenaSize || item->index != offset ||
+          !is_valid_item(item)) {
+        return false;
+      }
+      stamp_item(item, random.next());
+      if (vector->push_back(item) == static_cast<size_t>(-1)) return false;
+    }
+    return true;
+  }
+
+  static const int kChildProcesses = 2;
+  static const int kRounds = 512 * 1024;
+  static const size_t kArenaSize = 1024;
+  vector<pid_t> children_;
+  int start_[2];
+  Atomic<Word> started_;
+};
+
+
+struct TestConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  bool quiet;
+  bool attach;
+  bool trade;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["quiet"].type = CommandLine::BOOL;
+    arg_info["quiet"].boolean = false;
+
+    arg_info["attach"].type = CommandLine::BOOL;
+    arg_info["attach"].boolean = true;
+
+    arg_info["trade"].type = CommandLine::BOOL;
+    arg_info["trade"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        CpuTopology::Get().default_thread_count();
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    quiet = arg_info["quiet"].boolean;
+    attach = arg_info["attach"].boolean;
+    trade = arg_info["trade"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+  }
+};
+
+bool run_with_thread_count(TestConfig *config, int thread_count) {
+  bool quiet = config->quiet;
+  bool result = true;
+
+  if (config->attach) {
+    result &= AttachTest().execute(quiet, thread_count);
+  }
+  if (config->trade) {
+    result &= TradeTest().execute(quiet, thread_count);
+  }
+
+  return result;
+}
+
+}
+
+int main(int argc, char **argv) {
+  TestConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  bool success = true;
+  for (int i = config.thread_count_lower;
+       i <= config.thread_count_upper;
+       i++) {
+    if (!run_with_thread_count(&config, i)) {
+      success = false;
+      break;
+    }
+  }
+
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
+  if (!success) return 1;
+  return 0;
+}
@@ -0,0 +1,460 @@
+#include "tests.hpp"
+#include "skip-list-map.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <map>
+
+#include "locks.hpp"
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const int kKeyCount = 64 * 1024;
+const int kOperationCount = 1024 * 1024;
+const int kScanLength = 64;
+
+long *value_for(long key) { return to_pointer(kKeyCount + key); }
+
+// We will compare the performance of SkipListMap with a std::map
+// behind a lock.
+
+template<typename K, typename V, typename Compare = less<K> >
+class NaiveOrderedMap {
+  typedef map<K, V *, Compare> MapType;
+
+ public:
+  /// Remembers the key it is at and looks up the next one under the
+  /// lock, since a std::map iterator can't survive concurrent erases.
+  class Iterator {
+   public:
+    inline Iterator() : map_(NULL), is_end_(true), value_(NULL) { }
+
+    inline bool is_end() const { return is_end_; }
+    inline const K &key() const { return key_; }
+    inline V *value() const { return value_; }
+
+    void next() {
+      MutexLocker<> lock(&map_->mutex_);
+      set(map_->map_.upper_bound(key_));
+    }
+
+   private:
+    explicit Iterator(NaiveOrderedMap *map) :
+        map_(map), is_end_(true), value_(NULL) { }
+
+    void set(typename MapType::iterator i) {
+      is_end_ = i == map_->map_.end();
+      if (!is_end_) {
+        key_ = i->first;
+        value_ = i->second;
+      }
+    }
+
+    NaiveOrderedMap *map_;
+    bool is_end_;
+    K key_;
+    V *value_;
+    friend class NaiveOrderedMap;
+  };
+
+  bool insert(const K &key, V *value) {
+    MutexLocker<> lock(&mutex_);
+    return map_.insert(make_pair(key, value)).second;
+  }
+
+  V *erase(const K &key) {
+    MutexLocker<> lock(&mutex_);
+    typename MapType::iterator i = map_.find(key);
+    if (i == map_.end()) return reinterpret_cast<V *>(kNotFound);
+    V *value = i->second;
+    map_.erase(i);
+    return value;
+  }
+
+  V *find(const K &key) {
+    MutexLocker<> lock(&mutex_);
+    typename MapType::iterator i = map_.find(key);
+    if (i == map_.end()) return reinterpret_cast<V *>(kNotFound);
+    return i->second;
+  }
+
+  Iterator lower_bound(const K &key) {
+    MutexLocker<> lock(&mutex_);
+    Iterator iterator(this);
+    iterator.set(map_.lower_bound(key));
+    return iterator;
+  }
+
+  Iterator begin() {
+    MutexLocker<> lock(&mutex_);
+    Iterator iterator(this);
+    iterator.set(map_.begin());
+    return iterator;
+  }
+
+  inline static bool is_not_found(V *value) {
+    return reinterpret_cast<Word>(value) == kNotFound;
+  }
+
+ private:
+  MapType map_;
+  Mutex mutex_;
+
+  static const Word kNotFound = ~static_cast<Word>(0);
+};
+
+
+template<template<typename K, typename V, typename C> class Map>
+struct MapNamePrefix;
+
+template<>
+struct MapNamePrefix<SkipListMap> {
+  static string prefix() { return "skip-list-map-"; }
+};
+
+template<>
+struct MapNamePrefix<NaiveOrderedMap> {
+  static string prefix() { return "naive-ordered-map-"; }
+};
+
+
+template<template<typename K, typename V, typename C> class Map>
+class OrderedMapTest : public ThreadedTest {
+ public:
+  explicit OrderedMapTest(const string &subname) :
+    ThreadedTest(MapNamePrefix<Map>::prefix() + subname) {
+  }
+
+ protected:
+  typedef Map<long, long, less<long> > MapType;
+
+  virtual void synch_init() {
+    map_ = new MapType;
+    next_thread_id_.raw_store(0);
+  }
+
+  virtual void synch_destroy() {
+    delete map_;
+  }
+
+  /// Gives each thread a distinct id in [0, thread count).
+  int thread_id() {
+    return static_cast<int>(next_thread_id_.fetch_add(1));
+  }
+
+  /// Any value we find for a key must be the one we map it to.
+  bool check_value(long key, long *value) {
+    if (MapType::is_not_found(value)) return true;
+    check_i(to_integer(value), ==, to_integer(value_for(key)),
+            return false);
+    return true;
+  }
+
+  /// Walks at most `length` elements starting at `iterator`, checking
+  /// that keys strictly increase and that values match their keys.
+  bool check_scan(typename MapType::Iterator iterator, long lower,
+                  int length, int *out_seen) {
+    long previous = lower - 1;
+    int seen = 0;
+    for (; !iterator.is_end() && seen < length; iterator.next(), seen++) {
+      check_i(iterator.key(), >, previous, return false);
+      if (!check_value(iterator.key(), iterator.value())) return false;
+      previous = iterator.key();
+    }
+    *out_seen = seen;
+    return true;
+  }
+
+  MapType *map_;
+  Atomic<Word> next_thread_id_;
+};
+
+
+/// Threads insert interleaved, disjoint sets of keys and read them
+/// back.  At the end the map must hold all of them, in order.
+template<template<typename K, typename V, typename C> class Map>
+class InsertFindTest : public OrderedMapTest<Map> {
+ public:
+  InsertFindTest() : OrderedMapTest<Map>("insert-find") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int id = OrderedMapTest<Map>::thread_id();
+    int key_count = (kKeyCount / thread_count) * thread_count;
+
+    for (long key = id; key < key_count; key += thread_count) {
+      check_i(OrderedMapTest<Map>::map_->insert(key, value_for(key)), ==,
+              true, return false);
+    }
+
+    for (long key = id; key < key_count; key += thread_count) {
+      long *value = OrderedMapTest<Map>::map_->find(key);
+      check_i(to_integer(value), ==, to_integer(value_for(key)),
+              return false);
+    }
+
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int key_count = (kKeyCount / thread_count) * thread_count;
+
+    long expected = 0;
+    typename OrderedMapTest<Map>::MapType::Iterator i;
+    for (i = OrderedMapTest<Map>::map_->begin(); !i.is_end(); i.next()) {
+      check_i(i.key(), ==, expected, return false);
+      check_i(to_integer(i.value()), ==, to_integer(value_for(expected)),
+              return false);
+      expected++;
+    }
+
+    check_i(expected, ==, key_count, return false);
+    return true;
+  }
+};
+
+
+/// All threads race to insert and erase the same keys.  Every
+/// successful insert but the ones whose keys are still in the map at
+/// the end must be matched by exactly one successful erase.
+template<template<typename K, typename V, typename C> class Map>
+class InsertEraseTest : public OrderedMapTest<Map> {
+ public:
+  InsertEraseTest() : OrderedMapTest<Map>("insert-erase") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int start = OrderedMapTest<Map>::thread_id() * kStride;
+    Word inserts = 0;
+    Word erases = 0;
+
+    for (int i = 0; i < kKeyCount; i++) {
+      long key = (start + i) % kKeyCount;
+      if (OrderedMapTest<Map>::map_->insert(key, value_for(key))) {
+        inserts++;
+      }
+
+      long erase_key = (key + kKeyCount / 2) % kKeyCount;
+      long *value = OrderedMapTest<Map>::map_->erase(erase_key);
+      if (!OrderedMapTest<Map>::MapType::is_not_found(value)) {
+        if (!OrderedMapTest<Map>::check_value(erase_key, value)) {
+          return false;
+        }
+        erases++;
+      }
+    }
+
+    successful_inserts_.fetch_add(inserts);
+    successful_erases_.fetch_add(erases);
+    return true;
+  }
+
+  virtual void synch_init() {
+    OrderedMapTest<Map>::synch_init();
+    successful_inserts_.raw_store(0);
+    successful_erases_.raw_store(0);
+  }
+
+  virtual bool synch_verify() {
+    Word present = 0;
+    for (long key = 0; key < kKeyCount; key++) {
+      long *value = OrderedMapTest<Map>::map_->find(key);
+      if (!OrderedMapTest<Map>::check_value(key, value)) return false;
+      if (!OrderedMapTest<Map>::MapType::is_not_found(value)) present++;
+    }
+
+    // The iterator has to agree with find.
+    int seen;
+    if (!OrderedMapTest<Map>::check_scan(OrderedMapTest<Map>::map_->begin(),
+                                         0, kKeyCount, &seen)) {
+      return false;
+    }
+
+    check_i(static_cast<Word>(seen), ==, present, return false);
+    check_i(successful_inserts_.raw_load() - successful_erases_.raw_load(),
+            ==, present, return false);
+    return true;
+  }
+
+  static const int kStride = 997;
+  Atomic<Word> successful_inserts_;
+  Atomic<Word> successful_erases_;
+};
+
+
+/// Runs a random mix of operations over a map that starts out half
+/// full.  Range scans walk up to kScanLength elements from a
+/// lower_bound and check that they see strictly increasing keys with
+/// matching values while other threads insert and erase around them.
+template<template<typename K, typename V, typename C> class Map>
+class WorkloadTest : public OrderedMapTest<Map> {
+ public:
+  WorkloadTest(const string &name, int find_percent, int scan_percent,
+               int insert_percent) :
+      OrderedMapTest<Map>(name),
+      find_percent_(find_percent),
+      scan_percent_(scan_percent),
+      insert_percent_(insert_percent) { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int iterations = kOperationCount / thread_count;
+    XorShiftRandom random(reinterpret_cast<Word>(&iterations));
+
+    for (int i = 0; i < iterations; i++) {
+      Word choice = random.next();
+      long key = static_cast<long>((choice >> 32) % kKeyCount);
+      int operation = static_cast<int>((choice >> 8) % 100);
+
+      if (operation < find_percent_) {
+        long *value = OrderedMapTest<Map>::map_->find(key);
+        if (!OrderedMapTest<Map>::check_value(key, value)) return false;
+      } else if (operation < find_percent_ + scan_percent_) {
+        int seen;
+        if (!OrderedMapTest<Map>::check_scan(
+                OrderedMapTest<Map>::map_->lower_bound(key), key,
+                kScanLength, &seen)) {
+          return false;
+        }
+      } else if (operation < find_percent_ + scan_percent_ +
+                 insert_percent_) {
+        OrderedMapTest<Map>::map_->insert(key, value_for(key));
+      } else {
+        long *value = OrderedMapTest<Map>::map_->erase(key);
+        if (!OrderedMapTest<Map>::check_value(key, value)) return false;
+      }
+    }
+
+    return true;
+  }
+
+  virtual void synch_init() {
+    OrderedMapTest<Map>::synch_init();
+    for (long key = 0; key < kKeyCount; key += 2) {
+      OrderedMapTest<Map>::map_->insert(key, value_for(key));
+    }
+  }
+
+  virtual bool synch_verify() {
+    int seen;
+    return OrderedMapTest<Map>::check_scan(OrderedMapTest<Map>::map_->begin(),
+                                           0, kKeyCount, &seen);
+  }
+
+  int find_percent_;
+  int scan_percent_;
+  int insert_percent_;
+};
+
+
+struct TestConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  bool quiet;
+  bool insert_find;
+  bool insert_erase;
+  bool range_scan;
+  bool mixed;
+  string test_type;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["quiet"].type = CommandLine::BOOL;
+    arg_info["quiet"].boolean = false;
+
+    arg_info["insert-find"].type = CommandLine::BOOL;
+    arg_info["insert-find"].boolean = true;
+
+    arg_info["insert-erase"].type = CommandLine::BOOL;
+    arg_info["insert-erase"].boolean = true;
+
+    arg_info["range-scan"].type = CommandLine::BOOL;
+    arg_info["range-scan"].boolean = true;
+
+    arg_info["mixed"].type = CommandLine::BOOL;
+    arg_info["mixed"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        CpuTopology::Get().default_thread_count();
+
+    arg_info["test-type"].type = CommandLine::STRING;
+    arg_info["test-type"].string = "real";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    quiet = arg_info["quiet"].boolean;
+    insert_find = arg_info["insert-find"].boolean;
+    insert_erase = arg_info["insert-erase"].boolean;
+    range_scan = arg_info["range-scan"].boolean;
+    mixed = arg_info["mixed"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+    test_type = arg_info["test-type"].string;
+  }
+};
+
+template<template<typename K, typename V, typename C> class Map>
+bool run_with_thread_count(TestConfig *config, int thread_count) {
+  bool quiet = config->quiet;
+  bool result = true;
+
+  if (config->insert_find) {
+    result &= InsertFindTest<Map>().execute(quiet, thread_count);
+  }
+  if (config->insert_erase) {
+    result &= InsertEraseTest<Map>().execute(quiet, thread_count);
+  }
+  if (config->range_scan) {
+    result &= WorkloadTest<Map>("range-scan", 0, 50, 25).execute(
+        quiet, thread_count);
+  }
+  if (config->mixed) {
+    result &= WorkloadTest<Map>("mixed", 70, 10, 10).execute(quiet,
+                                                             thread_count);
+  }
+
+  return result;
+}
+
+
+template<template<typename K, typename V, typename C> class Map>
+bool run_tests_on_container(TestConfig *config) {
+  for (int i = config->thread_count_lower;
+       i <= config->thread_count_upper;
+       i++) {
+    if (!run_with_thread_count<Map>(config, i)) return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+  TestConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  bool success = true;
+  if (config.test_type == "real") {
+    success = run_tests_on_container<SkipListMap>(&config);
+  } else if (config.test_type == "fake") {
+    success = run_tests_on_container<NaiveOrderedMap>(&config);
+  } else {
+    cerr << "unknown test type `" << config.test_type << "`" << endl;
+  }
+
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
+  if (!success) return 1;
+  return 0;
+}
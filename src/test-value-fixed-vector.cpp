@@ -0,0 +1,419 @@
+#include "tests.hpp"
+#include "epoch.hpp"
+#include "fixed-vector.hpp"
+#include "value-fixed-vector.hpp"
+
+#include <climits>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const int kVectorSize = 4 * 1024 * 1024;
+
+// ValueFixedVector is compared against the two ways of putting a long
+// into a FixedVector: allocating it on the heap (and reclaiming it
+// with epochs, so get stays safe) and the to_pointer trick, which
+// allocates nothing but only works for small enough values.  The
+// adapters below give the three the same interface.
+
+class ValueAdapter {
+ public:
+  bool push(long value) {
+    return vector_.push_back(value) != static_cast<size_t>(-1);
+  }
+
+  bool pop(long *out_value) { return vector_.pop_back(out_value, NULL); }
+  bool get(size_t index, long *out_value) {
+    return vector_.get(index, out_value);
+  }
+
+  size_t length() const { return vector_.length(); }
+
+  static bool accepts(long) { return true; }
+  static string prefix() { return "value-fixed-vector-"; }
+
+ private:
+  ValueFixedVector<long, kVectorSize> vector_;
+};
+
+class HeapPointerAdapter {
+ public:
+  typedef FixedVector<long, kVectorSize> VectorType;
+
+  bool push(long value) {
+    long *pointer = new long(value);
+    if (vector_.push_back(pointer) != static_cast<size_t>(-1)) return true;
+    delete pointer;
+    return false;
+  }
+
+  bool pop(long *out_value) {
+    EpochGuard guard;
+    long *pointer = vector_.retire_pop_back(NULL, guard);
+    if (VectorType::is_out_of_range(pointer)) return false;
+    *out_value = *pointer;
+    return true;
+  }
+
+  bool get(size_t index, long *out_value) {
+    EpochGuard guard;
+    long *pointer = vector_.get(index, guard);
+    if (VectorType::is_out_of_range(pointer) ||
+        VectorType::is_inconsistent(pointer)) {
+      return false;
+    }
+    *out_value = *pointer;
+    return true;
+  }
+
+  size_t length() const { return vector_.length(); }
+
+  ~HeapPointerAdapter() {
+    long value;
+    while (pop(&value))
+      ;
+    Epoch::CollectAll();
+  }
+
+  static bool accepts(long) { return true; }
+  static string prefix() { return "heap-pointer-fixed-vector-"; }
+
+ private:
+  VectorType vector_;
+};
+
+class EncodedPointerAdapter {
+ public:
+  typedef FixedVector<long, kVectorSize> VectorType;
+
+  bool push(long value) {
+    long *pointer = reinterpret_cast<long *>(value << 2);
+    return vector_.push_back(pointer) != static_cast<size_t>(-1);
+  }
+
+  bool pop(long *out_value) {
+    long *pointer = vector_.pop_back(NULL);
+    if (VectorType::is_out_of_range(pointer)) return false;
+    *out_value = reinterpret_cast<long>(pointer) >> 2;
+    return true;
+  }
+
+  bool get(size_t index, long *out_value) {
+    long *pointer = vector_.get(index);
+    if (VectorType::is_out_of_range(pointer) ||
+        VectorType::is_inconsistent(pointer)) {
+      return false;
+    }
+    *out_value = reinterpret_cast<long>(pointer) >> 2;
+    return true;
+  }
+
+  size_t length() const { return vector_.length(); }
+
+  /// The top two bits are lost, and the values that turn into the
+  /// sentinels can't be stored.
+  static bool accepts(long value) {
+    return value >= 0 && value < (LONG_MAX >> 2);
+  }
+
+  static string prefix() { return "encoded-pointer-fixed-vector-"; }
+
+ private:
+  VectorType vector_;
+};
+
+
+/// Values the tests push look like 7k + 3, so that reading a garbage
+/// value is likely to be noticed.
+inline long make_value(long k) { return 7 * k + 3; }
+inline bool is_valid_value(long value) { return value % 7 == 3; }
+
+
+template<typename Adapter>
+class ValueVectorTest : public ThreadedTest {
+ public:
+  explicit ValueVectorTest(const string &subname) :
+    ThreadedTest(Adapter::prefix() + subname) {
+  }
+
+ protected:
+  virtual void synch_init() {
+    vector_ = new Adapter;
+  }
+
+  virtual void synch_destroy() {
+    delete vector_;
+  }
+
+  long definite_pop() {
+    long value;
+    while (!vector_->pop(&value))
+      ;
+    return value;
+  }
+
+  void definite_push(long value) {
+    while (!vector_->push(value))
+      ;
+  }
+
+  Adapter *vector_;
+};
+
+
+/// Pushes values that collide with FixedVector's sentinels and
+/// pointer tricks, on top of ordinary ones, and checks they all come
+/// back.  Adapters that can't hold a value push 3 in its place.
+template<typename Adapter>
+class EdgeValuesTest : public ValueVectorTest<Adapter> {
+ public:
+  EdgeValuesTest() : ValueVectorTest<Adapter>("edge-values") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int iterations = kVectorSize / thread_count;
+
+    for (int i = 0; i < iterations; i++) {
+      long value = edge_value(i);
+      ValueVectorTest<Adapter>::vector_->push(value);
+    }
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    int thread_count = ThreadedTest::get_thread_count();
+    size_t expected_length = (kVectorSize / thread_count) * thread_count;
+    check_i(ValueVectorTest<Adapter>::vector_->length(), ==,
+            expected_length, return false);
+
+    // Every thread pushed the same sequence, so every value must show
+    // up thread_count times as often as it does in the sequence.
+    map<long, long> seen;
+    for (size_t i = 0; i < expected_length; i++) {
+      long value;
+      check_i(ValueVectorTest<Adapter>::vector_->get(i, &value), ==, true,
+              return false);
+      seen[value]++;
+    }
+
+    map<long, long> expected;
+    for (int i = 0; i < kVectorSize / thread_count; i++) {
+      expected[edge_value(i)] += thread_count;
+    }
+
+    check_i(seen.size(), ==, expected.size(), return false);
+    for (map<long, long>::iterator i = expected.begin(); i != expected.end();
+         ++i) {
+      check_i(seen[i->first], ==, i->second, return false);
+    }
+    return true;
+  }
+
+  static long edge_value(int i) {
+    static const long kEdges[] = {
+      0, 1, -1, -2, -4, 2, 3, LONG_MIN, LONG_MAX, LONG_MAX >> 2
+    };
+    static const int kEdgeCount = sizeof(kEdges) / sizeof(kEdges[0]);
+    long value = kEdges[i % kEdgeCount];
+    return Adapter::accepts(value) ? value : 3;
+  }
+};
+
+
+/// Every thread pushes kContiguity values and pops as many, over and
+/// over.  The values popped must add up to the values pushed.
+template<typename Adapter>
+class PushPopTest : public ValueVectorTest<Adapter> {
+ public:
+  PushPopTest() : ValueVectorTest<Adapter>("push-pop") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int iterations = kOperationCount / thread_count / kContiguity;
+    long pushed = 0;
+    long popped = 0;
+
+    for (int i = 0; i < iterations; i++) {
+      for (int j = 0; j < kContiguity; j++) {
+        long value = make_value(i * kContiguity + j);
+        ValueVectorTest<Adapter>::definite_push(value);
+        pushed += value;
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        long value = ValueVectorTest<Adapter>::definite_pop();
+        check_i(is_valid_value(value), ==, true, return false);
+        popped += value;
+      }
+    }
+
+    difference_.fetch_add(pushed - popped);
+    return true;
+  }
+
+  virtual void synch_init() {
+    ValueVectorTest<Adapter>::synch_init();
+    difference_.raw_store(0);
+  }
+
+  virtual bool synch_verify() {
+    check_i(ValueVectorTest<Adapter>::vector_->length(), ==, 0,
+            return false);
+    check_i(difference_.raw_load(), ==, 0, return false);
+    return true;
+  }
+
+  static const int kOperationCount = 4 * 1024 * 1024;
+  static const int kContiguity = 8;
+  Atomic<Word> difference_;
+};
+
+
+/// Like PushPopTest, with reads of random indices in between.
+template<typename Adapter>
+class PushPopGetTest : public ValueVectorTest<Adapter> {
+ public:
+  PushPopGetTest() : ValueVectorTest<Adapter>("push-pop-get") { }
+
+ protected:
+  virtual bool threaded_test() {
+    int thread_count = ThreadedTest::get_thread_count();
+    int iterations = kOperationCount / thread_count / kContiguity;
+    XorShiftRandom random(reinterpret_cast<Word>(&iterations));
+
+    for (int i = 0; i < iterations; i++) {
+      for (int j = 0; j < kContiguity; j++) {
+        ValueVectorTest<Adapter>::definite_push(make_value(i));
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        size_t length = ValueVectorTest<Adapter>::vector_->length();
+        long value;
+        if (ValueVectorTest<Adapter>::vector_->get(random.next() % length,
+                                                   &value)) {
+          check_i(is_valid_value(value), ==, true, return false);
+        }
+      }
+      for (int j = 0; j < kContiguity; j++) {
+        long value = ValueVectorTest<Adapter>::definite_pop();
+        check_i(is_valid_value(value), ==, true, return false);
+      }
+    }
+
+    return true;
+  }
+
+  virtual bool synch_verify() {
+    check_i(ValueVectorTest<Adapter>::vector_->length(), ==, 0,
+            return false);
+    return true;
+  }
+
+  static const int kOperationCount = 2 * 1024 * 1024;
+  static const int kContiguity = 8;
+};
+
+
+struct TestConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  bool quiet;
+  bool edge_values;
+  bool push_pop;
+  bool push_pop_get;
+  string test_type;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["quiet"].type = CommandLine::BOOL;
+    arg_info["quiet"].boolean = false;
+
+    arg_info["edge-values"].type = CommandLine::BOOL;
+    arg_info["edge-values"].boolean = true;
+
+    arg_info["push-pop"].type = CommandLine::BOOL;
+    arg_info["push-pop"].boolean = true;
+
+    arg_info["push-pop-get"].type = CommandLine::BOOL;
+    arg_info["push-pop-get"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        CpuTopology::Get().default_thread_count();
+
+    arg_info["test-type"].type = CommandLine::STRING;
+    arg_info["test-type"].string = "value";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    quiet = arg_info["quiet"].boolean;
+    edge_values = arg_info["edge-values"].boolean;
+    push_pop = arg_info["push-pop"].boolean;
+    push_pop_get = arg_info["push-pop-get"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+    test_type = arg_info["test-type"].string;
+  }
+};
+
+template<typename Adapter>
+bool run_with_thread_count(TestConfig *config, int thread_count) {
+  bool quiet = config->quiet;
+  bool result = true;
+
+  if (config->edge_values) {
+    result &= EdgeValuesTest<Adapter>().execute(quiet, thread_count);
+  }
+  if (config->push_pop) {
+    result &= PushPopTest<Adapter>().execute(quiet, thread_count);
+  }
+  if (config->push_pop_get) {
+    result &= PushPopGetTest<Adapter>().execute(quiet, thread_count);
+  }
+
+  return result;
+}
+
+
+template<typename Adapter>
+bool run_tests_on_container(TestConfig *config) {
+  for (int i = config->thread_count_lower;
+       i <= config->thread_count_upper;
+       i++) {
+    if (!run_with_thread_count<Adapter>(config, i)) return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+  TestConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  bool success = true;
+  if (config.test_type == "value") {
+    success = run_tests_on_container<ValueAdapter>(&config);
+  } else if (config.test_type == "heap-pointer") {
+    success = run_tests_on_container<HeapPointerAdapter>(&config);
+  } else if (config.test_type == "encoded-pointer") {
+    success = run_tests_on_container<EncodedPointerAdapter>(&config);
+  } else {
+    cerr << "unknown test type `" << config.test_type << "`" << endl;
+  }
+
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
+  if (!success) return 1;
+  return 0;
+}
@@ -0,0 +1,388 @@
+#include "tests.hpp"
+#include "work-stealing-deque.hpp"
+
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <map>
+
+#include "locks.hpp"
+#include "topology.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const int kElementCount = 1024 * 1024;
+const int kSmallCapacity = 16;
+
+// We will compare the performance of WorkStealingDeque with a
+// std::deque behind a lock.
+
+template<typename T>
+class NaiveDeque {
+ public:
+  explicit NaiveDeque(size_t) { }
+
+  void push(T *value) {
+    MutexLocker<> lock(&mutex_);
+    deque_.push_back(value);
+  }
+
+  T *pop() {
+    MutexLocker<> lock(&mutex_);
+    if (deque_.empty()) return reinterpret_cast<T *>(kEmpty);
+    T *value = deque_.back();
+    deque_.pop_back();
+    return value;
+  }
+
+  T *steal() {
+    MutexLocker<> lock(&mutex_);
+    if (deque_.empty()) return reinterpret_cast<T *>(kEmpty);
+    T *value = deque_.front();
+    deque_.pop_front();
+    return value;
+  }
+
+  inline static bool is_empty(T *value) {
+    return reinterpret_cast<Word>(value) == kEmpty;
+  }
+
+  inline static bool is_aborted(T *) { return false; }
+
+ private:
+  std::deque<T *> deque_;
+  Mutex mutex_;
+
+  static const Word kEmpty = ~static_cast<Word>(0);
+};
+
+
+template<template<typename T> class Deque>
+struct DequeNamePrefix;
+
+template<>
+struct DequeNamePrefix<WorkStealingDeque> {
+  static string prefix() { return "work-stealing-deque-"; }
+};
+
+template<>
+struct DequeNamePrefix<NaiveDeque> {
+  static string prefix() { return "naive-deque-"; }
+};
+
+
+/// Thread 0 owns the deque, every other thread is a thief.
+template<template<typename T> class Deque>
+class DequeTest : public ThreadedTest {
+ public:
+  DequeTest(const string &subname, size_t initial_capacity) :
+      ThreadedTest(DequeNamePrefix<Deque>::prefix() + subname),
+      initial_capacity_(initial_capacity) {
+  }
+
+ protected:
+  typedef Deque<long> DequeType;
+
+  virtual void synch_init() {
+    deque_ = new DequeType(initial_capacity_);
+    next_thread_id_.raw_store(0);
+  }
+
+  virtual void synch_destroy() {
+    delete deque_;
+  }
+
+  int thread_id() {
+    return static_cast<int>(next_thread_id_.fetch_add(1));
+  }
+
+  DequeType *deque_;
+  size_t initial_capacity_;
+  Atomic<Word> next_thread_id_;
+};
+
+
+/// The owner pushes increasing values, popping some of them back
+/// right away, while the thieves steal.  Every value must be taken
+/// exactly once, and since values increase from the top of the deque
+/// to its bottom every thief must see them in increasing order.  The
+/// deque starts out small so that it grows while being stolen from.
+template<template<typename T> class Deque>
+class PushPopStealTest : public DequeTest<Deque> {
+ public:
+  PushPopStealTest() : DequeTest<Deque>("push-pop-steal", kSmallCapacity) { }
+
+ protected:
+  virtual bool threaded_test() {
+    if (DequeTest<Deque>::thread_id() == 0) {
+      bool result = run_owner();
+      done_.release_store(1);
+      return result;
+    }
+    return run_thief();
+  }
+
+  bool run_owner() {
+    for (int i = 0; i < kElementCount; i += kPushes) {
+      for (int j = i; j < i + kPushes; j++) {
+        DequeTest<Deque>::deque_->push(to_pointer(j));
+      }
+
+      // Pops get the values we pushed last, unless a thief got there
+      // first.
+      int previous = kElementCount;
+      for (int j = 0; j < kPops; j++) {
+        long *value = DequeTest<Deque>::deque_->pop();
+        if (Deque<long>::is_empty(value)) break;
+        check_i(to_integer(value), <, previous, return false);
+        previous = to_integer(value);
+        if (!take(value)) return false;
+      }
+    }
+
+    while (true) {
+      long *value = DequeTest<Deque>::deque_->pop();
+      if (Deque<long>::is_empty(value)) return true;
+      if (!take(value)) return false;
+    }
+  }
+
+  bool run_thief() {
+    int previous = -1;
+    while (true) {
+      bool done = done_.acquire_load() != 0;
+      long *value = DequeTest<Deque>::deque_->steal();
+
+      if (Deque<long>::is_empty(value)) {
+        if (done) return true;
+        Platform::Yield();
+        continue;
+      }
+      if (Deque<long>::is_aborted(value)) continue;
+
+      check_i(to_integer(value), >, previous, return false);
+      previous = to_integer(value);
+      if (!take(value)) return false;
+    }
+  }
+
+  bool take(long *value) {
+    int index = to_integer(value);
+    check_i(index, >=, 0, return false);
+    check_i(index, <, kElementCount, return false);
+    taken_[index].fetch_add(1);
+    return true;
+  }
+
+  virtual void synch_init() {
+    DequeTest<Deque>::synch_init();
+    done_.raw_store(0);
+    taken_ = new Atomic<Word>[kElementCount];
+    for (int i = 0; i < kElementCount; i++) taken_[i].raw_store(0);
+  }
+
+  virtual void synch_destroy() {
+    delete[] taken_;
+    DequeTest<Deque>::synch_destroy();
+  }
+
+  virtual bool synch_verify() {
+    for (int i = 0; i < kElementCount; i++) {
+      check_i(taken_[i].raw_load(), ==, 1, return false);
+    }
+    return true;
+  }
+
+  static const int kPushes = 8;
+  static const int kPops = 4;
+  Atomic<Word> done_;
+  Atomic<Word> *taken_;
+};
+
+
+/// Simulates fork-join parallelism: a task of depth `d` forks two
+/// tasks of depth `d - 1`, and tasks of depth 0 do a little work.
+/// The owner starts with a single task of depth kForkDepth and runs
+/// tasks off the bottom of its deque, pushing the children it forks.
+/// Thieves steal tasks off the top (the biggest ones) and run them to
+/// completion on their own.  Everybody stops once all the leaves have
+/// run.
+template<template<typename T> class Deque>
+class ForkJoinTest : public DequeTest<Deque> {
+ public:
+  ForkJoinTest() :
+      DequeTest<Deque>("fork-join", WorkStealingDeque<long>::kDefaultCapacity) {
+  }
+
+ protected:
+  virtual bool threaded_test() {
+    if (DequeTest<Deque>::thread_id() == 0) {
+      run_owner();
+    } else {
+      run_thief();
+    }
+    return true;
+  }
+
+  void run_owner() {
+    DequeTest<Deque>::deque_->push(to_pointer(kForkDepth));
+    Word leaves = 0;
+
+    while (!finished()) {
+      long *task = DequeTest<Deque>::deque_->pop();
+      if (Deque<long>::is_empty(task)) {
+        // Thieves are busy with the rest of the work.
+        completed_leaves_.fetch_add(leaves);
+        leaves = 0;
+        Platform::Yield();
+        continue;
+      }
+
+      int depth = to_integer(task);
+      if (depth == 0) {
+        do_leaf_work();
+        leaves++;
+      } else {
+        DequeTest<Deque>::deque_->push(to_pointer(depth - 1));
+        DequeTest<Deque>::deque_->push(to_pointer(depth - 1));
+      }
+    }
+  }
+
+  void run_thief() {
+    while (!finished()) {
+      long *task = DequeTest<Deque>::deque_->steal();
+      if (Deque<long>::is_empty(task) || Deque<long>::is_aborted(task)) {
+        Platform::Yield();
+        continue;
+      }
+      completed_leaves_.fetch_add(run_task(to_integer(task)));
+    }
+  }
+
+  Word run_task(int depth) {
+    if (depth == 0) {
+      do_leaf_work();
+      return 1;
+    }
+    return run_task(depth - 1) + run_task(depth - 1);
+  }
+
+  void do_leaf_work() {
+    uint64_t state = kLeafSeed;
+    for (int i = 0; i < kLeafWork; i++) XorShiftRandom::Step(&state);
+    sink_.nobarrier_store(state);
+  }
+
+  bool finished() {
+    return completed_leaves_.nobarrier_load() == kLeafCount;
+  }
+
+  virtual void synch_init() {
+    DequeTest<Deque>::synch_init();
+    completed_leaves_.raw_store(0);
+  }
+
+  virtual bool synch_verify() {
+    check_i(completed_leaves_.raw_load(), ==, kLeafCount, return false);
+    return true;
+  }
+
+  static const int kForkDepth = 18;
+  static const Word kLeafCount = static_cast<Word>(1) << kForkDepth;
+  static const int kLeafWork = 64;
+  static const uint64_t kLeafSeed = 4242;
+  Atomic<Word> completed_leaves_;
+  Atomic<Word> sink_;
+};
+
+
+struct TestConfig {
+  int thread_count_lower;
+  int thread_count_upper;
+  bool quiet;
+  bool push_pop_steal;
+  bool fork_join;
+  string test_type;
+
+  void read_config(int argc, char **argv) {
+    map<string, CommandLine::Arg> arg_info;
+    arg_info["quiet"].type = CommandLine::BOOL;
+    arg_info["quiet"].boolean = false;
+
+    arg_info["push-pop-steal"].type = CommandLine::BOOL;
+    arg_info["push-pop-steal"].boolean = true;
+
+    arg_info["fork-join"].type = CommandLine::BOOL;
+    arg_info["fork-join"].boolean = true;
+
+    arg_info["thread-count-lower"].type = CommandLine::INTEGER;
+    arg_info["thread-count-lower"].integer = 1;
+
+    arg_info["thread-count-upper"].type = CommandLine::INTEGER;
+    arg_info["thread-count-upper"].integer =
+        CpuTopology::Get().default_thread_count();
+
+    arg_info["test-type"].type = CommandLine::STRING;
+    arg_info["test-type"].string = "real";
+
+    CommandLine::Parse(&arg_info, argc, argv);
+
+    quiet = arg_info["quiet"].boolean;
+    push_pop_steal = arg_info["push-pop-steal"].boolean;
+    fork_join = arg_info["fork-join"].boolean;
+
+    thread_count_lower = arg_info["thread-count-lower"].integer;
+    thread_count_upper = arg_info["thread-count-upper"].integer;
+    test_type = arg_info["test-type"].string;
+  }
+};
+
+template<template<typename T> class Deque>
+bool run_with_thread_count(TestConfig *config, int thread_count) {
+  bool quiet = config->quiet;
+  bool result = true;
+
+  if (config->push_pop_steal) {
+    result &= PushPopStealTest<Deque>().execute(quiet, thread_count);
+  }
+  if (config->fork_join) {
+    result &= ForkJoinTest<Deque>().execute(quiet, thread_count);
+  }
+
+  return result;
+}
+
+
+template<template<typename T> class Deque>
+bool run_tests_on_container(TestConfig *config) {
+  for (int i = config->thread_count_lower;
+       i <= config->thread_count_upper;
+       i++) {
+    if (!run_with_thread_count<Deque>(config, i)) return false;
+  }
+  return true;
+}
+
+}
+
+int main(int argc, char **argv) {
+  TestConfig config;
+  config.read_config(argc, argv);
+  if (!ThreadPlacement::Configure(argc, argv)) return 1;
+  bool success = true;
+  if (config.test_type == "real") {
+    success = run_tests_on_container<WorkStealingDeque>(&config);
+  } else if (config.test_type == "fake") {
+    success = run_tests_on_container<NaiveDeque>(&config);
+  } else {
+    cerr << "unknown test type `" << config.test_type << "`" << endl;
+  }
+
+  cout << ThreadedTest::TotalParallelTimeInUSec() / 1000.0d << endl;
+  if (!success) return 1;
+  return 0;
+}
@@ -4,57 +4,218 @@
 #include <pthread.h>
 #include <stdint.h>
 
+#include "parking-lot.hpp"
+#include "topology.hpp"
+
 using namespace std;
 using namespace eelish;
 
+namespace {
+
+/// How long a waiting thread spins before it goes to sleep in the
+/// ParkingLot.  A barrier or a job hand-off is usually over within a few
+/// microseconds when every thread has a CPU of its own.
+const int kSpinIterations = 4 * 1024;
+
+/// Blocks till `*word` is something other than `value`: spins for a
+/// while, then sleeps in the ParkingLot.  Whoever changes `*word` must
+/// wake it up afterwards.
+void wait_while_equal(Atomic<Word> *word, Word value) {
+  for (int i = 0; i < kSpinIterations; i++) {
+    if (word->acquire_load() != value) return;
+    cpu_relax();
+  }
+  while (word->acquire_load() == value) {
+    ParkingLot::Wait(word, value);
+  }
+}
+
+/// Threads that stay around between tests.  A worker sleeps till the
+/// master hands it a test by bumping its generation, runs it and goes
+/// back to sleep; the master sleeps till the last worker of a run is
+/// done.  Workers are only ever added, one per thread the largest test
+/// so far has asked for.
+class WorkerPool {
+ public:
+  /// Never freed: the workers are still asleep in it when the process
+  /// exits.
+  static WorkerPool *Get() {
+    static WorkerPool *pool = new WorkerPool;
+    return pool;
+  }
+
+  /// Hands `test` to the first `thread_count` workers, the i'th pinned
+  /// to `cpus[i]` if `cpus` isn't empty, and returns right away.
+  void start(ThreadedTest *test, const vector<int> &cpus, int thread_count);
+
+  /// Blocks till the workers given the last test are done with it, and
+  /// returns true if it passed on all of them.
+  bool finish(int thread_count);
+
+ private:
+  struct Worker {
+    WorkerPool *pool;
+    pthread_t thread;
+    Atomic<Word> generation;
+    ThreadedTest *test;
+    bool result;
+
+    /// The CPU the worker is pinned to, or -1.
+    int cpu;
+  };
+
+  WorkerPool() {
+    remaining_.raw_store(0);
+    pthread_getaffinity_np(pthread_self(), sizeof(all_cpus_), &all_cpus_);
+  }
+
+  static void *WorkerFunction(void *data);
+  void pin(Worker *worker, int cpu);
+
+  vector<Worker *> workers_;
+  Atomic<Word> remaining_;
+
+  /// The affinity the process started with, to unpin a worker.
+  cpu_set_t all_cpus_;
+};
+
+void *WorkerPool::WorkerFunction(void *data) {
+  Worker *worker = reinterpret_cast<Worker *>(data);
+  Word generation = 0;
+  while (true) {
+    wait_while_equal(&worker->generation, generation);
+    generation = worker->generation.acquire_load();
+
+    worker->result = worker->test->run_thread();
+
+    // The release makes the result visible to the master once it sees
+    // the count drop.
+    if (worker->pool->remaining_.fetch_add(-1, kRelease) == 1) {
+      ParkingLot::WakeOne(&worker->pool->remaining_);
+    }
+  }
+  return NULL;
+}
+
+void WorkerPool::pin(Worker *worker, int cpu) {
+  if (worker->cpu == cpu) return;
+  if (cpu == -1) {
+    pthread_setaffinity_np(worker->thread, sizeof(all_cpus_), &all_cpus_);
+  } else {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    pthread_setaffinity_np(worker->thread, sizeof(cpu_set), &cpu_set);
+  }
+  worker->cpu = cpu;
+}
+
+void WorkerPool::start(ThreadedTest *test, const vector<int> &cpus,
+                       int thread_count) {
+  while (static_cast<int>(workers_.size()) < thread_count) {
+    Worker *worker = new Worker;
+    worker->pool = this;
+    worker->generation.raw_store(0);
+    worker->test = NULL;
+    worker->result = false;
+    worker->cpu = -1;
+    pthread_create(&worker->thread, NULL, WorkerFunction, worker);
+    workers_.push_back(worker);
+  }
+
+  remaining_.raw_store(thread_count);
+  for (int i = 0; i < thread_count; i++) {
+    Worker *worker = workers_[i];
+    pin(worker, cpus.empty() ? -1 : cpus[i]);
+    worker->test = test;
+    worker->generation.fetch_add(1, kRelease);
+    ParkingLot::WakeOne(&worker->generation);
+  }
+}
+
+bool WorkerPool::finish(int thread_count) {
+  while (true) {
+    Word remaining = remaining_.acquire_load();
+    if (remaining == 0) break;
+    wait_while_equal(&remaining_, remaining);
+  }
+
+  bool successful = true;
+  for (int i = 0; i < thread_count; i++) {
+    successful &= workers_[i]->result;
+  }
+  return successful;
+}
+
+}
+
+/// The start barrier.  Workers count themselves in `arrived` and wait
+/// for `released` to turn 1.
 struct ThreadedTest::PlatformData {
-  pthread_mutex_t condition_mutex;
-  pthread_cond_t condition;
+  Atomic<Word> arrived;
+  Atomic<Word> released;
 };
 
 void ThreadedTest::initialize_platform() {
   platform_data_ = new PlatformData();
-  pthread_mutex_init(&platform_data_->condition_mutex, NULL);
-  pthread_cond_init(&platform_data_->condition, NULL);
 }
 
 void ThreadedTest::destroy_platform() {
-  pthread_mutex_destroy(&platform_data_->condition_mutex);
-  pthread_cond_destroy(&platform_data_->condition);
   delete platform_data_;
 }
 
-static void *thread_function(void *data) {
-  ThreadedTest *test = reinterpret_cast<ThreadedTest *>(data);
-  bool result = test->threaded_test();
-  return reinterpret_cast<void *>(static_cast<uintptr_t>(result));
+void ThreadedTest::wait_for_start() {
+  platform_data_->arrived.fetch_add(1);
+  wait_while_equal(&platform_data_->released, 0);
+}
+
+long ThreadedTest::release_start(int thread_count) {
+  // Workers may not have a CPU to run on till we give ours up, so we
+  // yield rather than spin.
+  while (platform_data_->arrived.acquire_load() !=
+         static_cast<Word>(thread_count)) {
+    Platform::Yield();
+  }
+
+  long start_time = Platform::CurrentTimeInUSec();
+  platform_data_->released.release_store(1);
+  ParkingLot::WakeAll(&platform_data_->released);
+  return start_time;
+}
+
+bool ThreadedTest::run_thread() {
+  wait_for_start();
+  bool result = threaded_test();
+
+  Word now = static_cast<Word>(Platform::CurrentTimeInUSec());
+  Word end_time;
+  do {
+    end_time = end_time_.nobarrier_load();
+    if (end_time >= now) break;
+  } while (!end_time_.boolean_cas(end_time, now));
+  return result;
 }
-bool ThreadedTest::execute(bool quiet, int thread_count) {
-  // TODO: Have thread_count default to 1.5 times the number of cores.
-  // At the very least, have a function that returns the number of
-  // cores so that the actual tests can choose a sane value for
-  // thread_count.
 
+bool ThreadedTest::execute(bool quiet, int thread_count) {
   quiet_ = quiet;
 
-  output("executing %s with %d threads\n", test_name_.c_str(), thread_count);
+  output("executing %s with %d threads, pinning %s\n", test_name_.c_str(),
+         thread_count, ThreadPlacement::describe(thread_count).c_str());
 
   thread_count_ = thread_count;
+  platform_data_->arrived.raw_store(0);
+  platform_data_->released.raw_store(0);
+  end_time_.raw_store(0);
 
-  bool successful = true;
   synch_init();
 
-  pthread_t *thread_ids = new pthread_t[thread_count];
-  for (int i = 0; i < thread_count; i++) {
-    pthread_create(&thread_ids[i], NULL, thread_function, this);
-  }
+  WorkerPool *pool = WorkerPool::Get();
+  pool->start(this, ThreadPlacement::cpus(thread_count), thread_count);
+  long start_time = release_start(thread_count);
+  bool successful = pool->finish(thread_count);
 
-  for (int i = 0; i < thread_count; i++) {
-    void *test_successful;
-    pthread_join(thread_ids[i], &test_successful);
-    successful &=
-        static_cast<bool>(reinterpret_cast<uintptr_t>(test_successful));
-  }
+  long parallel_time = static_cast<long>(end_time_.raw_load()) - start_time;
+  total_parallel_time_ += parallel_time;
 
   if (successful) {
     successful = synch_verify();
@@ -63,7 +224,8 @@ bool ThreadedTest::execute(bool quiet, int thread_count) {
   synch_destroy();
 
   if (successful) {
-    output("%s passed!\n", test_name_.c_str());
+    output("%s passed in %.3f ms!\n", test_name_.c_str(),
+           parallel_time / 1000.0);
   } else {
     always_output("%s failed!\n", test_name_.c_str());
   }
@@ -5,6 +5,8 @@
 #include <cstdio>
 #include <cstring>
 
+#include "locks.hpp"
+
 using namespace eelish;
 using namespace std;
 
@@ -24,6 +26,61 @@ void ThreadedTest::always_output(const char *format, ...) {
   va_end(args);
 }
 
+long ThreadedTest::total_parallel_time_ = 0;
+
+void OperationLatencies::merge(const OperationLatencies &other) {
+  for (int i = 0; i < kMaxOperations; i++) {
+    histograms_[i].merge(other.histograms_[i]);
+  }
+}
+
+void ThreadedTest::add_thread_latencies(const OperationLatencies &latencies) {
+  MutexLocker<> lock(&latencies_mutex_);
+  thread_latencies_.push_back(latencies);
+}
+
+void ThreadedTest::report_latencies(const char *const *operation_names) {
+  OperationLatencies merged(0);
+  for (size_t i = 0; i < thread_latencies_.size(); i++) {
+    merged.merge(thread_latencies_[i]);
+  }
+  thread_latencies_.clear();
+
+  // Sampling is asked for explicitly, so this is printed even when
+  // the test is quiet.
+  for (int i = 0;
+       i < OperationLatencies::kMaxOperations && operation_names[i] != NULL;
+       i++) {
+    const LogHistogram &histogram = merged.histogram(i);
+    if (histogram.count() == 0) continue;
+    always_output("%s %s latency (ns): p50 %.0f p99 %.0f p99.9 %.0f "
+                  "max %.0f, %llu samples\n", test_name_.c_str(),
+                  operation_names[i],
+                  CycleClock::ToNanoseconds(histogram.percentile(50)),
+                  CycleClock::ToNanoseconds(histogram.percentile(99)),
+                  CycleClock::ToNanoseconds(histogram.percentile(99.9)),
+                  CycleClock::ToNanoseconds(histogram.max()),
+                  static_cast<unsigned long long>(histogram.count()));
+  }
+}
+
+void ThreadedTest::report_contention(const ContentionStats &stats) {
+  Word attempts = stats[kLengthCasAttempt];
+  Word failures = stats[kLengthCasFailure];
+  double failure_percentage = attempts == 0 ? 0 : 100.0 * failures / attempts;
+
+  // Counting is asked for explicitly, so this is printed even when
+  // the test is quiet.
+  always_output("%s contention with %d threads: %lu length CASes, "
+                "%lu failed (%.2f%%), %lu prime failures, %lu backoffs, "
+                "%lu undone primes\n", test_name_.c_str(), thread_count_,
+                static_cast<unsigned long>(attempts),
+                static_cast<unsigned long>(failures), failure_percentage,
+                static_cast<unsigned long>(stats[kPrimeFailure]),
+                static_cast<unsigned long>(stats[kBackoff]),
+                static_cast<unsigned long>(stats[kUndonePrime]));
+}
+
 void CommandLine::Parse(map<string, CommandLine::Arg> *meta,
                         int argc, char **argv) {
   for (int i = 1; i < argc; i++) {
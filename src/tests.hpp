@@ -1,19 +1,98 @@
 #ifndef __EELISH_TESTS__HPP
 #define __EELISH_TESTS__HPP
 
+#include <algorithm>
 #include <map>
 #include <string>
+#include <vector>
 
+#include "contention-counters.hpp"
+#include "cycle-clock.hpp"
+#include "histogram.hpp"
 #include "platform.hpp"
 
 namespace eelish {
 
+/// Latencies of the individual operations a test does, to see the
+/// tail latency of a push or a pop and not just the total time.
+///
+/// Timing every call would distort what we are measuring, so only
+/// every `sample_period`th call of each operation is timed; a period
+/// of 0 turns sampling off.  Operations keep separate counts, so that
+/// a period in step with the test's pattern of calls doesn't end up
+/// sampling only one kind of call.  Every thread fills in an
+/// OperationLatencies of its own and hands it to
+/// ThreadedTest::add_thread_latencies when done.  Operations are small
+/// integers below kMaxOperations, one histogram (of CycleClock ticks)
+/// each.
+class OperationLatencies {
+ public:
+  static const int kMaxOperations = 4;
+
+  explicit OperationLatencies(int sample_period) :
+      sample_period_(sample_period) {
+    std::fill(countdowns_, countdowns_ + kMaxOperations, sample_period);
+  }
+
+  /// Returns true if the call to `operation` about to be made should
+  /// be timed.
+  inline bool should_sample(int operation) {
+    if (sample_period_ == 0 || --countdowns_[operation] != 0) return false;
+    countdowns_[operation] = sample_period_;
+    return true;
+  }
+
+  inline void record(int operation, uint64_t ticks) {
+    histograms_[operation].record(ticks);
+  }
+
+  void merge(const OperationLatencies &other);
+
+  const LogHistogram &histogram(int operation) const {
+    return histograms_[operation];
+  }
+
+ private:
+  int sample_period_;
+  int countdowns_[kMaxOperations];
+  LogHistogram histograms_[kMaxOperations];
+};
+
+/// Runs `statement`, and times it as `operation` into `latencies` if
+/// it is sampled.  `statement` must not return or jump out.
+#define time_sampled(latencies, operation, statement) do {             \
+    if (unlikely((latencies).should_sample(operation))) {               \
+      uint64_t time_sampled_begin = eelish::CycleClock::Now();          \
+      statement;                                                        \
+      (latencies).record((operation),                                   \
+                         eelish::CycleClock::Now() - time_sampled_begin); \
+    } else {                                                            \
+      statement;                                                        \
+    }                                                                   \
+  } while(0)
+
+/// Runs a test body on `thread_count` threads at once.
+///
+/// The threads come from a pool that lives as long as the process, so
+/// a test doesn't pay for creating and joining threads, and they are
+/// let go together from a start barrier once all of them have been
+/// handed the test.  Only the stretch from that moment till the last
+/// thread is done with threaded_test is timed; synch_init,
+/// synch_verify and synch_destroy are not.
 class ThreadedTest {
  public:
   bool execute(bool quiet, int thread_count);
 
   virtual bool threaded_test() = 0;
 
+  /// Waits at the start barrier, runs threaded_test and notes the
+  /// time it was done, for the worker threads.
+  bool run_thread();
+
+  /// The time spent in the parallel sections of all tests executed so
+  /// far.
+  static long TotalParallelTimeInUSec() { return total_parallel_time_; }
+
  protected:
   explicit ThreadedTest(const std::string &name) :
       test_name_(name),
@@ -28,6 +107,18 @@ class ThreadedTest {
 
   int get_thread_count() const { return thread_count_; }
 
+  /// For tests that sample latencies: every thread hands in its
+  /// OperationLatencies once it is done, and synch_verify calls
+  /// report_latencies to merge them and print p50, p99, p99.9 and max
+  /// for every operation that has samples.  `operation_names` is
+  /// indexed by operation and ends with a NULL.
+  void add_thread_latencies(const OperationLatencies &latencies);
+  void report_latencies(const char *const *operation_names);
+
+  /// Prints what a container's ContentionCounters counted during the
+  /// test.
+  void report_contention(const ContentionStats &stats);
+
   /// Printf style output function.  Prints things only if the tests
   /// isn't quiet.
   void output(const char *format, ...);
@@ -40,10 +131,24 @@ class ThreadedTest {
   int thread_count_;
   bool quiet_;
 
+  /// When the last thread was done with threaded_test.
+  Atomic<Word> end_time_;
+  static long total_parallel_time_;
+
+  Mutex latencies_mutex_;
+  std::vector<OperationLatencies> thread_latencies_;
+
   struct PlatformData;
   PlatformData *platform_data_;
   void initialize_platform();
   void destroy_platform();
+
+  /// The start barrier: wait_for_start blocks a worker till
+  /// release_start is called, which the master only does once
+  /// `thread_count` workers are waiting.  Returns the time the
+  /// workers were let go.
+  void wait_for_start();
+  long release_start(int thread_count);
 };
 
 class CommandLine {
@@ -85,6 +190,19 @@ class Timer {
   long begin_time_;
 };
 
+/// Instead of malloc'ing all the time, tests simply cast integers to
+/// pointers.  The containers assume things about how a pointer looks,
+/// so we need to shuffle some bits around.
+inline long *to_pointer(int value) {
+  intptr_t large_value = static_cast<intptr_t>(value);
+  return reinterpret_cast<long *>(large_value << 2);
+}
+
+inline int to_integer(long *pointer) {
+  intptr_t integral_value = reinterpret_cast<intptr_t>(pointer);
+  return static_cast<int>(integral_value >> 2);
+}
+
 
 /// Checks if two integral expressions are satisfy a binary condition.
 /// `lhs` and `rhs` must be pure.  We reuse tests as benchmarks and
@@ -0,0 +1,314 @@
+#include "topology.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <map>
+#include <sched.h>
+#include <unistd.h>
+
+#include "tests.hpp"
+
+using namespace eelish;
+using namespace std;
+
+namespace {
+
+const char *const kCpuDirectory = "/sys/devices/system/cpu";
+
+/// Reads the first line of `path`; false if it can't be read.
+bool read_line(const string &path, string *out_line) {
+  FILE *file = fopen(path.c_str(), "r");
+  if (file == NULL) return false;
+
+  char buffer[4096];
+  bool result = fgets(buffer, sizeof(buffer), file) != NULL;
+  fclose(file);
+  if (!result) return false;
+
+  *out_line = buffer;
+  while (!out_line->empty() && (*out_line)[out_line->size() - 1] == '\n') {
+    out_line->erase(out_line->size() - 1);
+  }
+  return true;
+}
+
+bool read_integer(const string &path, int *out_value) {
+  string line;
+  if (!read_line(path, &line) || line.empty()) return false;
+  *out_value = atoi(line.c_str());
+  return true;
+}
+
+/// Parses a sysfs CPU list, like "0-3,8,10-11".
+vector<int> parse_cpu_list(const string &list) {
+  vector<int> cpus;
+  const char *cursor = list.c_str();
+  while (*cursor != '\0') {
+    char *end;
+    long first = strtol(cursor, &end, 10);
+    if (end == cursor) break;
+    long last = first;
+    if (*end == '-') {
+      cursor = end + 1;
+      last = strtol(cursor, &end, 10);
+    }
+    for (long i = first; i <= last; i++) cpus.push_back(static_cast<int>(i));
+    cursor = *end == ',' ? end + 1 : end;
+  }
+  return cpus;
+}
+
+/// The NUMA node `cpu` belongs to: its directory has a `node<N>` link.
+int node_of(int cpu) {
+  char path[128];
+  snprintf(path, sizeof(path), "%s/cpu%d", kCpuDirectory, cpu);
+  DIR *directory = opendir(path);
+  if (directory == NULL) return 0;
+
+  int node = 0;
+  struct dirent *entry;
+  while ((entry = readdir(directory)) != NULL) {
+    int value;
+    if (sscanf(entry->d_name, "node%d", &value) == 1) {
+      node = value;
+      break;
+    }
+  }
+  closedir(directory);
+  return node;
+}
+
+bool allowed(const cpu_set_t &affinity, int cpu) {
+  return cpu < CPU_SETSIZE && CPU_ISSET(cpu, &affinity);
+}
+
+/// Orders CPUs so that neighbours share as much as possible.
+struct CompactOrder {
+  bool operator()(const Cpu &a, const Cpu &b) const {
+    if (a.node != b.node) return a.node < b.node;
+    if (a.package != b.package) return a.package < b.package;
+    if (a.core != b.core) return a.core < b.core;
+    return a.sibling < b.sibling;
+  }
+};
+
+/// Orders CPUs so that neighbours share as little as possible:
+/// round robin over the packages, first over the first hardware
+/// thread of every core and then over the second.  `rank` is the
+/// rank of each CPU's core within its package.
+struct ScatterOrder {
+  explicit ScatterOrder(const map<int, int> *rank) : rank_(rank) { }
+
+  bool operator()(const Cpu &a, const Cpu &b) const {
+    if (a.sibling != b.sibling) return a.sibling < b.sibling;
+    int a_rank = rank_->find(a.core)->second;
+    int b_rank = rank_->find(b.core)->second;
+    if (a_rank != b_rank) return a_rank < b_rank;
+    if (a.node != b.node) return a.node < b.node;
+    return a.package < b.package;
+  }
+
+  const map<int, int> *rank_;
+};
+
+}
+
+CpuTopology::CpuTopology() :
+    core_count_(0),
+    package_count_(0),
+    node_count_(0) {
+  if (!read_sysfs()) read_fallback();
+}
+
+const CpuTopology &CpuTopology::Get() {
+  static CpuTopology topology;
+  return topology;
+}
+
+bool CpuTopology::read_sysfs() {
+  string online;
+  if (!read_line(string(kCpuDirectory) + "/online", &online)) return false;
+
+  // Only the CPUs we may run on count; a taskset or a cgroup can rule
+  // some out.
+  cpu_set_t affinity;
+  CPU_ZERO(&affinity);
+  bool have_affinity =
+      sched_getaffinity(0, sizeof(affinity), &affinity) == 0;
+
+  vector<int> ids = parse_cpu_list(online);
+  map<pair<int, int>, int> cores;
+  map<int, int> packages, nodes;
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (have_affinity && !allowed(affinity, ids[i])) continue;
+
+    char path[128];
+    Cpu cpu;
+    cpu.id = ids[i];
+
+    snprintf(path, sizeof(path), "%s/cpu%d/topology/physical_package_id",
+             kCpuDirectory, cpu.id);
+    if (!read_integer(path, &cpu.package) || cpu.package < 0) cpu.package = 0;
+
+    int core_id;
+    snprintf(path, sizeof(path), "%s/cpu%d/topology/core_id", kCpuDirectory,
+             cpu.id);
+    if (!read_integer(path, &core_id)) core_id = cpu.id;
+
+    // Cores are numbered afresh in every package.
+    pair<int, int> key(cpu.package, core_id);
+    if (cores.find(key) == cores.end()) {
+      int next = static_cast<int>(cores.size());
+      cores[key] = next;
+    }
+    cpu.core = cores[key];
+
+    cpu.node = node_of(cpu.id);
+    packages[cpu.package]++;
+    nodes[cpu.node]++;
+    cpus_.push_back(cpu);
+  }
+  if (cpus_.empty()) return false;
+
+  // CPUs come in ascending order, so a CPU's sibling index is the
+  // number of CPUs on its core seen before it.
+  map<int, int> seen;
+  for (size_t i = 0; i < cpus_.size(); i++) {
+    cpus_[i].sibling = seen[cpus_[i].core]++;
+  }
+
+  core_count_ = static_cast<int>(cores.size());
+  package_count_ = static_cast<int>(packages.size());
+  node_count_ = static_cast<int>(nodes.size());
+  return true;
+}
+
+void CpuTopology::read_fallback() {
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  if (count < 1) count = 1;
+
+  cpus_.clear();
+  for (int i = 0; i < count; i++) {
+    Cpu cpu;
+    cpu.id = i;
+    cpu.core = i;
+    cpu.package = 0;
+    cpu.node = 0;
+    cpu.sibling = 0;
+    cpus_.push_back(cpu);
+  }
+  core_count_ = static_cast<int>(count);
+  package_count_ = 1;
+  node_count_ = 1;
+}
+
+int CpuTopology::default_thread_count() const {
+  return max(4, cpu_count() * 3 / 2);
+}
+
+vector<int> CpuTopology::placement(PinningPolicy policy,
+                                   int thread_count) const {
+  vector<Cpu> order;
+  switch (policy) {
+    case kNoPinning:
+      return vector<int>();
+
+    case kCompactPinning:
+      order = cpus_;
+      sort(order.begin(), order.end(), CompactOrder());
+      break;
+
+    case kScatterPinning: {
+      map<int, int> rank;
+      order = cpus_;
+      sort(order.begin(), order.end(), CompactOrder());
+      map<int, int> cores_in_package;
+      for (size_t i = 0; i < order.size(); i++) {
+        if (rank.find(order[i].core) == rank.end()) {
+          rank[order[i].core] = cores_in_package[order[i].package]++;
+        }
+      }
+      sort(order.begin(), order.end(), ScatterOrder(&rank));
+      break;
+    }
+
+    case kPhysicalCorePinning:
+      for (size_t i = 0; i < cpus_.size(); i++) {
+        if (cpus_[i].sibling == 0) order.push_back(cpus_[i]);
+      }
+      sort(order.begin(), order.end(), CompactOrder());
+      break;
+  }
+
+  vector<int> placement;
+  for (int i = 0; i < thread_count; i++) {
+    placement.push_back(order[i % order.size()].id);
+  }
+  return placement;
+}
+
+string CpuTopology::describe() const {
+  char buffer[128];
+  snprintf(buffer, sizeof(buffer), "%d cpus, %d cores, %d packages, %d nodes",
+           cpu_count(), core_count_, package_count_, node_count_);
+  return buffer;
+}
+
+bool CpuTopology::ParsePolicy(const string &name, PinningPolicy *out_policy) {
+  if (name == "none") {
+    *out_policy = kNoPinning;
+  } else if (name == "compact") {
+    *out_policy = kCompactPinning;
+  } else if (name == "scatter") {
+    *out_policy = kScatterPinning;
+  } else if (name == "physical-core") {
+    *out_policy = kPhysicalCorePinning;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *CpuTopology::PolicyName(PinningPolicy policy) {
+  switch (policy) {
+    case kNoPinning: return "none";
+    case kCompactPinning: return "compact";
+    case kScatterPinning: return "scatter";
+    case kPhysicalCorePinning: return "physical-core";
+  }
+  return "unknown";
+}
+
+PinningPolicy ThreadPlacement::policy_ = kNoPinning;
+
+bool ThreadPlacement::Configure(int argc, char **argv) {
+  map<string, CommandLine::Arg> arg_info;
+  arg_info["pinning"].type = CommandLine::STRING;
+  arg_info["pinning"].string = "none";
+
+  CommandLine::Parse(&arg_info, argc, argv);
+
+  if (!CpuTopology::ParsePolicy(arg_info["pinning"].string, &policy_)) {
+    fprintf(stderr, "unknown pinning policy `%s`\n",
+            arg_info["pinning"].string);
+    return false;
+  }
+  return true;
+}
+
+vector<int> ThreadPlacement::cpus(int thread_count) {
+  return CpuTopology::Get().placement(policy_, thread_count);
+}
+
+string ThreadPlacement::describe(int thread_count) {
+  string description = CpuTopology::PolicyName(policy_);
+  vector<int> placement = cpus(thread_count);
+  for (size_t i = 0; i < placement.size(); i++) {
+    char cpu[16];
+    snprintf(cpu, sizeof(cpu), "%s%d", i == 0 ? ": " : " ", placement[i]);
+    description += cpu;
+  }
+  return description;
+}
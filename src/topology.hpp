@@ -0,0 +1,103 @@
+#ifndef __EELISH_TOPOLOGY__HPP
+#define __EELISH_TOPOLOGY__HPP
+
+#include <string>
+#include <vector>
+
+namespace eelish {
+
+/// How ThreadedTest and ThreadedBenchmark place their threads on CPUs.
+enum PinningPolicy {
+  /// Leave placement to the scheduler.
+  kNoPinning,
+
+  /// Fill one core's hardware threads, then the next core's, then the
+  /// next socket's: threads share as much cache as they can.
+  kCompactPinning,
+
+  /// Spread threads over sockets first and cores second, and only put
+  /// two on the same core once every core has one.
+  kScatterPinning,
+
+  /// One thread per physical core, skipping SMT siblings altogether;
+  /// more threads than cores wrap around.
+  kPhysicalCorePinning
+};
+
+/// A logical CPU and where it sits.  `core` is unique across the
+/// machine (unlike the core_id sysfs reports, which only is unique
+/// within a socket); `sibling` is the CPU's index among its core's
+/// hardware threads.
+struct Cpu {
+  int id;
+  int core;
+  int package;
+  int node;
+  int sibling;
+};
+
+/// The CPUs this process may run on, read from
+/// /sys/devices/system/cpu and /sys/devices/system/node.  Without
+/// sysfs every online CPU is taken to be a core of its own.
+class CpuTopology {
+ public:
+  /// Discovered the first time it is asked for.
+  static const CpuTopology &Get();
+
+  const std::vector<Cpu> &cpus() const { return cpus_; }
+  int cpu_count() const { return static_cast<int>(cpus_.size()); }
+  int core_count() const { return core_count_; }
+  int package_count() const { return package_count_; }
+  int node_count() const { return node_count_; }
+
+  /// A thread count that keeps every CPU busy with some to spare:
+  /// one and a half times the CPU count, and never less than 4.
+  int default_thread_count() const;
+
+  /// The CPU each of `thread_count` threads runs on under `policy`;
+  /// empty for kNoPinning.
+  std::vector<int> placement(PinningPolicy policy, int thread_count) const;
+
+  /// "8 cpus, 4 cores, 1 package, 1 node", for logs.
+  std::string describe() const;
+
+  /// "none", "compact", "scatter" and "physical-core".
+  static bool ParsePolicy(const std::string &name, PinningPolicy *out_policy);
+  static const char *PolicyName(PinningPolicy policy);
+
+ private:
+  CpuTopology();
+
+  bool read_sysfs();
+  void read_fallback();
+
+  std::vector<Cpu> cpus_;
+  int core_count_;
+  int package_count_;
+  int node_count_;
+};
+
+/// The pinning policy in effect for the whole process.  Every test
+/// and benchmark binary calls Configure from main, which reads
+/// `--pinning <policy>` off the command line.
+class ThreadPlacement {
+ public:
+  /// Returns false, after complaining on stderr, for an unknown
+  /// policy.
+  static bool Configure(int argc, char **argv);
+
+  static PinningPolicy policy() { return policy_; }
+
+  /// CpuTopology::placement for the policy in effect.
+  static std::vector<int> cpus(int thread_count);
+
+  /// "compact: 0 1 2 3" or "none", to record alongside results.
+  static std::string describe(int thread_count);
+
+ private:
+  static PinningPolicy policy_;
+};
+
+}
+
+#endif
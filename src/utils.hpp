@@ -1,6 +1,8 @@
 #ifndef __EELISH_UTILS__HPP
 #define __EELISH_UTILS__HPP
 
+#include <stdint.h>
+
 namespace eelish {
 
 template<bool Condition> struct STATIC_ASSERT_FAILED;
@@ -11,7 +13,34 @@ template<> struct STATIC_ASSERT_FAILED<true> { };
          sizeof(STATIC_ASSERT_FAILED < (bool) (condition) >) };
 
 #define unlikely(condition) __builtin_expect((condition), 0)
-#define likely(condition) __builtin_expect((condition), 0)
+#define likely(condition) __builtin_expect((condition), 1)
+
+const int kCacheLineSize = 64;
+
+/// A small xorshift pseudo-random number generator.  Good enough for
+/// jittering delays and picking slots, and it needs no shared state.
+/// The seed is scrambled first, so seeds which differ only in a few
+/// high bits (like stack addresses of different threads) still give
+/// different sequences.
+class XorShiftRandom {
+ public:
+  explicit inline XorShiftRandom(uint64_t seed) :
+      state_((seed * 0x9E3779B97F4A7C15ULL) | 1) { }
+
+  inline uint64_t next() { return Step(&state_); }
+
+  /// Advances a raw xorshift state, for callers that need to keep it
+  /// somewhere a class can't live (a __thread variable, say).
+  static inline uint64_t Step(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+  }
+
+ private:
+  uint64_t state_;
+};
 
 }
 
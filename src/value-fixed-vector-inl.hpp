@@ -0,0 +1,128 @@
+#ifndef __EELISH_VALUE_FIXED_VECTOR__HPP
+#error "value-fixed-vector-inl.hpp can only be included from within \
+        value-fixed-vector.hpp"
+#endif
+
+namespace eelish {
+
+template<typename T, std::size_t Size, typename Backoff>
+ValueFixedVector<T, Size, Backoff>::ValueFixedVector() {
+  assert_static(sizeof(T) <= sizeof(Word));
+
+  length_.raw_store(0);
+  DoubleWord unwritten = { 0, kUnwritten };
+  for (std::size_t i = 0; i < Size; i++) {
+    buffer_[i].raw_store(unwritten);
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+void ValueFixedVector<T, Size, Backoff>::store_slot(Atomic<DoubleWord> *slot,
+                                                    Word value,
+                                                    SlotState state) {
+  // A guess for the current contents; if it is wrong the CAS tells us
+  // what they really are and the second attempt succeeds.
+  DoubleWord current = { slot->acquire_load_low(),
+                         slot->acquire_load_high() };
+  while (true) {
+    DoubleWord next = { value, next_tag(current.high, state) };
+    DoubleWord seen = slot->value_cas(current, next);
+    if (seen == current) return;
+    current = seen;
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+std::size_t ValueFixedVector<T, Size, Backoff>::push_back(const T &value) {
+  Word index;
+  do {
+    index = length_.nobarrier_load();
+    if (index >= Size) return -1;
+  } while (!length_.boolean_cas(index, index + 1));
+
+  // The slot is ours now.  It is either unwritten or still holds a
+  // value popped earlier; nobody else touches it till we're done.
+  memory_fence();
+  store_slot(&buffer_[index], encode(value), kFull);
+
+  if (Backoff::kParks) backoff_site_.wake_waiters();
+  return static_cast<std::size_t>(index);
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+bool ValueFixedVector<T, Size, Backoff>::pop_back(T *out_value,
+                                                  std::size_t *out_index) {
+  Backoff backoff;
+  while (true) {
+    Word length;
+    switch (attempt_pop(out_value, &length)) {
+      case kDone:
+        if (length == 0) return false;
+        if (out_index != NULL) *out_index = length - 1;
+        return true;
+      case kBlocked:
+        backoff.backoff(&backoff_site_, PopBlocked(this, length));
+        break;
+      case kRaced:
+        break;
+    }
+  }
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+typename ValueFixedVector<T, Size, Backoff>::Attempt
+ValueFixedVector<T, Size, Backoff>::attempt_pop(T *out_value,
+                                                Word *out_length) {
+  Word length = length_.nobarrier_load();
+  *out_length = length;
+  if (length == 0) return kDone;
+
+  Atomic<DoubleWord> *slot = &buffer_[length - 1];
+  Word tag = slot->acquire_load_high();
+  if (unlikely(state_of(tag) != kFull)) return kBlocked;
+
+  // Prime the slot.  The CAS fails if the slot changed since we read
+  // the tag, which includes the value having changed.
+  DoubleWord full = { slot->acquire_load_low(), tag };
+  DoubleWord primed = { full.low, next_tag(tag, kPrimed) };
+  if (!slot->boolean_cas(full, primed)) return kRaced;
+
+  memory_fence();
+
+  if (unlikely(!length_.boolean_cas(length, length - 1))) {
+    // Something's changed, undo priming and retry.
+    store_slot(slot, full.low, kFull);
+    if (Backoff::kParks) backoff_site_.fence_and_wake_waiters();
+    return kRaced;
+  }
+
+  if (Backoff::kParks) backoff_site_.wake_waiters();
+  *out_value = decode(full.low);
+  return kDone;
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+bool ValueFixedVector<T, Size, Backoff>::get(std::size_t index,
+                                             T *out_value) {
+  if (index >= length_.nobarrier_load()) return false;
+
+  Atomic<DoubleWord> *slot = &buffer_[index];
+  Word tag = slot->acquire_load_high();
+  if (state_of(tag) != kFull) return false;
+
+  // Writers change value and tag together, and every change bumps
+  // the version; so if the tag is the same after reading the value,
+  // the value goes with it.
+  Word value = slot->acquire_load_low();
+  if (slot->acquire_load_high() != tag) return false;
+
+  *out_value = decode(value);
+  return true;
+}
+
+template<typename T, std::size_t Size, typename Backoff>
+std::size_t ValueFixedVector<T, Size, Backoff>::length() const {
+  return length_.nobarrier_load();
+}
+
+}
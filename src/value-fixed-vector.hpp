@@ -0,0 +1,125 @@
+#ifndef __EELISH_VALUE_FIXED_VECTOR__HPP
+#define __EELISH_VALUE_FIXED_VECTOR__HPP
+
+#include <cstring>
+
+#include "atomics.hpp"
+#include "backoff.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// A FixedVector that holds values instead of pointers.
+///
+/// `T` can be any trivially copyable type of at most a word -- a
+/// long, a double, a small struct -- and every bit pattern is a valid
+/// value, so there is no need to allocate small payloads on the heap
+/// or worry about them colliding with sentinels.
+///
+/// Every slot is a DoubleWord: the value in the low word and a tag in
+/// the high one.  The tag holds the state of the slot in its low two
+/// bits and a version number, bumped on every change, in the rest:
+///
+///   kUnwritten   no value was ever pushed here
+///   kFull        the slot holds a value
+///   kPrimed      a pop_back has claimed the value (or popped it and
+///                left; the value stays behind till the next push)
+///
+/// Value and tag change together, with a double-width CAS.  The
+/// algorithm is otherwise FixedVector's: a push claims its index by
+/// bumping length_ and then writes the slot, a pop primes the slot at
+/// the tail and then lowers length_, and a pop can't go past a slot
+/// that isn't kFull.  See fixed-vector.hpp for the guarantees.
+///
+/// The version is what lets get() do without a double-width load: it
+/// reads the tag, the value and the tag again, and the value is good
+/// if the tag didn't change in between.
+template<typename T, std::size_t Size, typename Backoff = SleepBackoff>
+class ValueFixedVector {
+ public:
+  ValueFixedVector();
+
+  /// Returns the index at which the value is inserted, or -1 if the
+  /// vector is full.
+  std::size_t push_back(const T &value);
+
+  /// Returns false if the vector is empty.  `out_index` may be NULL.
+  bool pop_back(T *out_value, std::size_t *out_index);
+
+  /// Returns false if there is no value at `index`, or if the value
+  /// there is still being pushed or being popped.
+  bool get(std::size_t index, T *out_value);
+
+  std::size_t length() const;
+
+ private:
+  enum SlotState {
+    kUnwritten = 0,
+    kFull = 1,
+    kPrimed = 2
+  };
+
+  static inline Word state_of(Word tag) { return tag & kStateMask; }
+
+  /// The tag the slot goes to from `tag` when its state changes to
+  /// `state`.
+  static inline Word next_tag(Word tag, SlotState state) {
+    return ((tag & ~kStateMask) + kVersionIncrement) | state;
+  }
+
+  static inline Word encode(const T &value) {
+    Word word = 0;
+    memcpy(&word, &value, sizeof(T));
+    return word;
+  }
+
+  static inline T decode(Word word) {
+    T value;
+    memcpy(&value, &word, sizeof(T));
+    return value;
+  }
+
+  /// Installs `value` with state `state` in `slot`, whatever the slot
+  /// holds now.  Only for slots no one else can change under us.
+  static inline void store_slot(Atomic<DoubleWord> *slot, Word value,
+                                SlotState state);
+
+  /// Holds as long as the vector's length is `length` and the slot at
+  /// `length - 1` isn't kFull.
+  class PopBlocked {
+   public:
+    inline PopBlocked(ValueFixedVector *vector, Word length) :
+        vector_(vector), length_(length) { }
+
+    inline bool operator()() const {
+      if (vector_->length_.nobarrier_load() != length_) return false;
+      Word tag = vector_->buffer_[length_ - 1].acquire_load_high();
+      return state_of(tag) != kFull;
+    }
+
+   private:
+    ValueFixedVector *vector_;
+    Word length_;
+  };
+
+  enum Attempt {
+    kDone,
+    kBlocked,
+    kRaced
+  };
+
+  inline Attempt attempt_pop(T *out_value, Word *out_length);
+
+  Atomic<Word> length_;
+  Atomic<DoubleWord> buffer_[Size];
+  BackoffSite backoff_site_;
+
+  static const Word kStateMask = 3;
+  static const Word kVersionIncrement = 4;
+};
+
+}
+
+#include "value-fixed-vector-inl.hpp"
+
+#endif
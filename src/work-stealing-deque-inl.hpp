@@ -0,0 +1,139 @@
+#ifndef __EELISH_WORK_STEALING_DEQUE__HPP
+#error "work-stealing-deque-inl.hpp can only be included from within \
+        work-stealing-deque.hpp"
+#endif
+
+#include <new>
+
+namespace eelish {
+
+template<typename T>
+WorkStealingDeque<T>::WorkStealingDeque(std::size_t initial_capacity) {
+  std::size_t log_size = 0;
+  while ((static_cast<std::size_t>(1) << log_size) < initial_capacity) {
+    log_size++;
+  }
+
+  top_.word.raw_store(0);
+  bottom_.word.raw_store(0);
+  array_.raw_store(allocate_array(log_size, NULL));
+}
+
+template<typename T>
+WorkStealingDeque<T>::~WorkStealingDeque() {
+  CircularArray *array = array_.raw_load();
+  while (array != NULL) {
+    CircularArray *previous = array->previous;
+    operator delete(array);
+    array = previous;
+  }
+}
+
+template<typename T>
+typename WorkStealingDeque<T>::CircularArray *
+WorkStealingDeque<T>::allocate_array(std::size_t log_size,
+                                     CircularArray *previous) {
+  std::size_t size = static_cast<std::size_t>(1) << log_size;
+  void *memory = operator new(sizeof(CircularArray) +
+                              (size - 1) * sizeof(Atomic<T *>));
+  CircularArray *array = static_cast<CircularArray *>(memory);
+  array->log_size = log_size;
+  array->previous = previous;
+  return array;
+}
+
+template<typename T>
+typename WorkStealingDeque<T>::CircularArray *
+WorkStealingDeque<T>::grow(CircularArray *array, Word top, Word bottom) {
+  CircularArray *bigger = allocate_array(array->log_size + 1, array);
+  for (Word i = top; i != bottom; i++) {
+    bigger->at(i)->nobarrier_store(array->at(i)->nobarrier_load());
+  }
+
+  // Thieves that see the new buffer must see what we copied into it.
+  array_.release_store(bigger);
+  return bigger;
+}
+
+template<typename T>
+void WorkStealingDeque<T>::push(T *value) {
+  Word bottom = bottom_.word.nobarrier_load();
+  Word top = top_.word.acquire_load();
+  CircularArray *array = array_.nobarrier_load();
+
+  if (bottom - top >= array->size()) array = grow(array, top, bottom);
+
+  array->at(bottom)->nobarrier_store(value);
+
+  // A thief that sees the new bottom_ must see the value too.
+  bottom_.word.release_store(bottom + 1);
+}
+
+template<typename T>
+T *WorkStealingDeque<T>::pop() {
+  Word bottom = bottom_.word.nobarrier_load() - 1;
+  CircularArray *array = array_.nobarrier_load();
+  bottom_.word.nobarrier_store(bottom);
+
+  // Thieves have to see that we've claimed the bottom slot before we
+  // look at top_, otherwise we and a thief could both take it.  This
+  // is the one store-load ordering x86 doesn't give us for free.
+  full_memory_fence();
+
+  Word top = top_.word.nobarrier_load();
+  intptr_t remaining = static_cast<intptr_t>(bottom - top);
+
+  if (remaining < 0) {
+    // The deque was empty, put bottom_ back.
+    bottom_.word.nobarrier_store(bottom + 1);
+    return reinterpret_cast<T *>(kEmpty);
+  }
+
+  T *value = array->at(bottom)->nobarrier_load();
+  if (remaining > 0) return value;
+
+  // This is the last element; a thief may be going for it too, and
+  // whoever moves top_ past it gets it.
+  if (!top_.word.boolean_cas(top, top + 1)) {
+    value = reinterpret_cast<T *>(kEmpty);
+  }
+  bottom_.word.nobarrier_store(bottom + 1);
+  return value;
+}
+
+template<typename T>
+T *WorkStealingDeque<T>::steal() {
+  // x86 keeps these two loads in order, see the comment in
+  // work-stealing-deque.hpp.
+  Word top = top_.word.acquire_load();
+  Word bottom = bottom_.word.acquire_load();
+
+  if (static_cast<intptr_t>(bottom - top) <= 0) {
+    return reinterpret_cast<T *>(kEmpty);
+  }
+
+  // The slot at `top` can't be overwritten while top_ is still `top`
+  // (the owner grows the buffer instead), so if the CAS succeeds the
+  // value we read is the right one.
+  CircularArray *array = array_.acquire_load();
+  T *value = array->at(top)->nobarrier_load();
+  if (!top_.word.boolean_cas(top, top + 1)) {
+    return reinterpret_cast<T *>(kAborted);
+  }
+  return value;
+}
+
+template<typename T>
+std::size_t WorkStealingDeque<T>::size() const {
+  Word bottom = bottom_.word.nobarrier_load();
+  Word top = top_.word.nobarrier_load();
+  intptr_t size = static_cast<intptr_t>(bottom - top);
+  return size < 0 ? 0 : static_cast<std::size_t>(size);
+}
+
+template<typename T>
+std::size_t WorkStealingDeque<T>::capacity() const {
+  return array_.nobarrier_load()->size();
+}
+
+}
@@ -0,0 +1,125 @@
+#ifndef __EELISH_WORK_STEALING_DEQUE__HPP
+#define __EELISH_WORK_STEALING_DEQUE__HPP
+
+#include <cstring>
+
+#include "atomics.hpp"
+#include "utils.hpp"
+
+namespace eelish {
+
+/// A Chase-Lev work-stealing deque of `T *`.
+///
+/// One thread, the owner, pushes and pops at the bottom of the deque
+/// like it would with a stack.  Any number of other threads, thieves,
+/// steal from the top, so they get the oldest element first.  This is
+/// what a task scheduler wants: the owner keeps working on the task it
+/// spawned last (whose data is hot in its cache) and thieves pick up
+/// the oldest, and usually biggest, pieces of work.
+///
+/// The elements live in a circular buffer indexed by two ever
+/// increasing counters, top_ and bottom_; the deque holds the
+/// elements at [top_, bottom_).  push and pop only write bottom_ and
+/// steal only CASes top_, so the owner needs a CAS only when it pops
+/// the last element and might be racing a thief for it.  pop pays for
+/// a full fence instead, between publishing its new bottom_ and
+/// reading top_.
+///
+/// When the buffer fills up the owner copies it into one twice as
+/// large.  Thieves may still be reading the old buffer, so old
+/// buffers are only freed with the deque.  Since they double in size
+/// that at most doubles the memory used.
+///
+/// The memory orderings follow Lê, Pop, Cohen and Zappa Nardelli,
+/// "Correct and Efficient Work-Stealing for Weak Memory Models"
+/// (PPoPP 2013), weakened where x86's ordering makes the fence
+/// redundant: a thief reads top_ and then bottom_, and x86 never
+/// reorders two loads, so steal gets away with two acquire loads
+/// where the paper needs a full fence in between.
+///
+/// Values must not collide with kEmpty and kAborted.
+template<typename T>
+class WorkStealingDeque {
+ public:
+  /// `initial_capacity` is rounded up to a power of two.
+  explicit WorkStealingDeque(std::size_t initial_capacity =
+                             kDefaultCapacity);
+  ~WorkStealingDeque();
+
+  /// Pushes `value` at the bottom.  Only the owner may call this.
+  void push(T *value);
+
+  /// Pops the value at the bottom, or returns kEmpty (check using
+  /// is_empty).  Only the owner may call this.
+  T *pop();
+
+  /// Takes the value at the top.  Returns kEmpty if there was nothing
+  /// to steal and kAborted (check using is_aborted) if it lost a race
+  /// with another thief or the owner, in which case there may well be
+  /// something left to steal.
+  T *steal();
+
+  /// The number of elements in the deque, only a hint while other
+  /// threads are at work.
+  std::size_t size() const;
+
+  /// The size of the current buffer.
+  std::size_t capacity() const;
+
+  inline static bool is_empty(T *value) {
+    return reinterpret_cast<Word>(value) == kEmpty;
+  }
+
+  inline static bool is_aborted(T *value) {
+    return reinterpret_cast<Word>(value) == kAborted;
+  }
+
+  static const std::size_t kDefaultCapacity = 64;
+
+ private:
+  /// A buffer of 2^log_size slots, allocated with as many slots as
+  /// it has.
+  struct CircularArray {
+    std::size_t log_size;
+
+    /// The buffer this one replaced, freed along with the deque.
+    CircularArray *previous;
+
+    Atomic<T *> slots[1];
+
+    inline std::size_t size() const {
+      return static_cast<std::size_t>(1) << log_size;
+    }
+
+    inline Atomic<T *> *at(Word index) {
+      return &slots[index & (size() - 1)];
+    }
+  };
+
+  static CircularArray *allocate_array(std::size_t log_size,
+                                       CircularArray *previous);
+
+  /// Copies [top, bottom) from the current buffer into a new one
+  /// twice as large and installs it.
+  CircularArray *grow(CircularArray *array, Word top, Word bottom);
+
+  /// The owner and the thieves hammer on different counters, keep
+  /// them on different cache lines.
+  struct PaddedWord {
+    Atomic<Word> word;
+    char padding[kCacheLineSize - sizeof(Atomic<Word>)];
+  } __attribute__((aligned(kCacheLineSize)));
+
+  PaddedWord top_;
+  PaddedWord bottom_;
+  Atomic<CircularArray *> array_;
+
+  static const Word kEmpty = ~static_cast<Word>(0);
+  static const Word kAborted = ~static_cast<Word>(1);
+};
+
+}
+
+#include "work-stealing-deque-inl.hpp"
+
+#endif